@@ -0,0 +1,91 @@
+/**
+ * Twinkle FGS-Sim: Centroid recovery simulation
+ *
+ * @file ADC.cpp
+ * @brief Lookup table of the detector response and ADC
+ * @author Claudio Arena
+ * @version 1.0.0 2026-10-18
+ * @description The ideal converter has its code transitions at k - 1/2. Differential nonlinearity draws the width of each
+ * code around 1, and the transitions are rescaled so the top code starts where it would on the ideal converter. Each
+ * input level goes through the nonlinearity, and the code is the number of transitions below it.
+ */
+
+#include <cmath>
+#include <iostream>
+#include <random>
+
+#include "ADC.hpp"
+
+/**
+ * Builds the lookup table of a converter.
+ *
+ * @param _bits Bits of the output codes, from 1 to 16
+ * @param fullScale Input in ADUs mapped to the top code
+ * @param nonlinearity Coefficients of the gain nonlinearity, from the quadratic term
+ * @param dnl Rms deviation of the code widths, in codes
+ * @param seed Seed of the code widths
+ */
+ADC::ADC(uint16_t _bits, uint32_t fullScale, std::vector<double> nonlinearity, double dnl, uint32_t seed) : nbits(_bits)
+{
+    if (nbits == 0 || nbits > 16)
+    {
+        throw "Error! ADC bits must be between 1 and 16";
+    }
+    if (fullScale == 0)
+    {
+        throw "Error! ADC full scale must be positive";
+    }
+
+    const uint32_t codes = maxCode();
+    std::vector<double> transitions(codes);
+    std::mt19937 generator(seed);
+    std::normal_distribution<double> width(1.0, dnl);
+    double transition = 0.5;
+    for (uint32_t k = 0; k < codes; k++)
+    {
+        transitions[k] = transition;
+        transition += (dnl > 0) ? std::max(width(generator), 0.0) : 1.0;
+    }
+    const double scale = (codes > 1) ? (codes - 1.0) / (transitions.back() - 0.5) : 1.0;
+    for (double &t : transitions)
+    {
+        t = 0.5 + (t - 0.5) * scale;
+    }
+
+    table.resize(fullScale + 1);
+    for (uint32_t input = 0; input <= fullScale; input++)
+    {
+        const double u = (double)input / fullScale;
+        double response = 1, power = u;
+        for (double c : nonlinearity)
+        {
+            response += c * power;
+            power *= u;
+        }
+        const double level = u * response * codes;
+        table[input] = std::upper_bound(transitions.begin(), transitions.end(), level) - transitions.begin();
+    }
+}
+
+ADC::ADC(uint16_t _bits, std::vector<uint16_t> _table) : nbits(_bits), table(_table)
+{
+    if (nbits == 0 || nbits > 16)
+    {
+        throw "Error! ADC bits must be between 1 and 16";
+    }
+    if (table.empty())
+    {
+        throw "Error! ADC table is empty";
+    }
+    for (uint16_t &c : table)
+    {
+        c = std::min<uint32_t>(c, maxCode());
+    }
+}
+
+ADC::~ADC()
+{
+#ifdef DEBUG_MEMORY
+    std::cout << "Destroyed ADC " << std::endl;
+#endif
+}
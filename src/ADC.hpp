@@ -0,0 +1,54 @@
+/**
+ * Twinkle FGS-Sim: Centroid recovery simulation
+ *
+ * @file ADC.hpp
+ * @brief Header file for ADC class
+ * @author Claudio Arena
+ * @version 1.0.0 2026-10-18
+ */
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include "typedefs.h"
+
+/**
+ * Detector response and analogue to digital conversion, as a lookup table from the linear signal in ADUs to output
+ * codes. The table folds in the gain nonlinearity, the differential nonlinearity of the converter and the clipping at
+ * full scale, so converting a pixel is a single clamped gather whatever the transfer function.
+ * Full scale input maps to the top code, so fewer bits also mean a coarser ADU.
+ *
+ * @brief Class converting frames to ADC codes
+ */
+class ADC
+{
+public:
+  // Polynomial nonlinearity: response = u (1 + c[0] u + c[1] u^2 + ...), u = input / fullScale. dnl is the rms
+  // deviation of the code widths, in codes.
+  ADC(uint16_t _bits, uint32_t fullScale, std::vector<double> nonlinearity = {}, double dnl = 0, uint32_t seed = 1);
+  // Measured transfer function: code of each input level, from 0 to full scale
+  ADC(uint16_t _bits, std::vector<uint16_t> _table);
+  ~ADC();
+
+  uint16_t bits() const { return nbits; }
+  uint32_t maxCode() const { return (1u << nbits) - 1; }
+  uint32_t fullScale() const { return table.size() - 1; }
+  uint16_t code(uint32_t input) const { return table[std::min<uint32_t>(input, table.size() - 1)]; }
+
+  // Converts n pixels. Output may alias the input, and may be 8, 16 or 32 bits wide.
+  template <typename T>
+  void convert(const uint32_t *input, T *output, std::size_t n) const
+  {
+    const uint16_t *__restrict lut = table.data();
+    const uint32_t last = table.size() - 1;
+    for (std::size_t i = 0; i < n; i++)
+    {
+      output[i] = (T)lut[std::min(input[i], last)];
+    }
+  }
+
+private:
+  uint16_t nbits;
+  std::vector<uint16_t> table; // code of each input level
+};
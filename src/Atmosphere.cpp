@@ -0,0 +1,279 @@
+/**
+ * Twinkle FGS-Sim: Centroid recovery simulation
+ *
+ * @file Atmosphere.cpp
+ * @brief Seeing and scintillation for ground telescopes
+ * @author Claudio Arena
+ * @version 1.0.0 2026-10-18
+ * @description The phase screen follows the von Karman spectrum 0.023 r0^(-5/3) (f^2 + 1/L0^2)^(-11/6). It is periodic, so a screen of
+ * size N * dx wraps after N * dx / wind seconds. Short exposure PSFs are the average of |FFT(pupil * exp(i phase))|^2 over a few
+ * time steps within the exposure, with the screen translated by wind * time. Scintillation variance is from Young (1967):
+ * 1e-5 D^(-4/3) X^3 exp(-2 h / 8000) / t.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+#include "Atmosphere.hpp"
+#include "FFT.hpp"
+#include "astroUtilities.hpp"
+
+/**
+ * Constructs a phase screen.
+ *
+ * @param _size Screen size in samples, per side. Rounded up to a power of two
+ * @param _pixelScale Screen sample size, in metres
+ * @param r0 Fried parameter at 500 nm along the line of sight, in metres
+ * @param L0 Outer scale, in metres
+ * @param seed Seed for the random phases
+ */
+PhaseScreen::PhaseScreen(uint32_t _size, double _pixelScale, double r0, double L0, uint32_t seed)
+    : n(fft::nextPowerOfTwo(_size)), dx(_pixelScale), phase((std::size_t)n * n)
+{
+    std::mt19937 generator(seed);
+    std::normal_distribution<double> normal(0.0, 1.0);
+    std::vector<fft::complex> spectrum((std::size_t)n * n);
+
+    const double df = 1.0 / (n * dx);
+    const double A = 0.023 * pow(r0, -5.0 / 3.0);
+    for (uint32_t ky = 0; ky < n; ky++)
+    {
+        double fy = ((ky < n / 2) ? (double)ky : (double)ky - n) * df;
+        for (uint32_t kx = 0; kx < n; kx++)
+        {
+            double fx = ((kx < n / 2) ? (double)kx : (double)kx - n) * df;
+            double psd = (kx == 0 && ky == 0) ? 0 : A * pow(fx * fx + fy * fy + 1.0 / (L0 * L0), -11.0 / 6.0);
+            double amplitude = sqrt(psd) * df;
+            spectrum[(std::size_t)ky * n + kx] = fft::complex(normal(generator) * amplitude, normal(generator) * amplitude);
+        }
+    }
+
+    fft::transform2d(spectrum, n, n);
+    for (std::size_t i = 0; i < phase.size(); i++)
+    {
+        phase[i] = spectrum[i].real();
+    }
+}
+
+PhaseScreen::~PhaseScreen()
+{
+#ifdef DEBUG_MEMORY
+    std::cout << "Destroyed PhaseScreen " << std::endl;
+#endif
+}
+
+/**
+ * Phase at a position on the screen, with bilinear interpolation. The screen is periodic.
+ *
+ * @param x Position in x, in metres
+ * @param y Position in y, in metres
+ * @return Phase in radians at 500 nm
+ */
+double PhaseScreen::operator()(double x, double y) const
+{
+    double u = fmod(x / dx, (double)n);
+    double v = fmod(y / dx, (double)n);
+    if (u < 0)
+        u += n;
+    if (v < 0)
+        v += n;
+
+    uint32_t x0 = (uint32_t)u % n;
+    uint32_t y0 = (uint32_t)v % n;
+    uint32_t x1 = (x0 + 1) % n;
+    uint32_t y1 = (y0 + 1) % n;
+    double fx = u - floor(u);
+    double fy = v - floor(v);
+
+    double top = phase[(std::size_t)y0 * n + x0] * (1 - fx) + phase[(std::size_t)y0 * n + x1] * fx;
+    double bottom = phase[(std::size_t)y1 * n + x0] * (1 - fx) + phase[(std::size_t)y1 * n + x1] * fx;
+    return top * (1 - fy) + bottom * fy;
+}
+
+/**
+ * Constructs an Atmosphere object. The phase screen is generated here, once.
+ *
+ * @param _tel Telescope. Diameter, secondary diameter, plate scale and simels are used
+ * @param _r0 Fried parameter at 500 nm at zenith, in metres
+ * @param _L0 Outer scale, in metres
+ * @param _windX Wind speed in frame x direction, in m/s
+ * @param _windY Wind speed in frame y direction, in m/s
+ * @param _altitude Altitude of the target above the horizon, in degrees
+ * @param _siteAltitude Altitude of the observatory, in metres
+ * @param screenSize Phase screen size, in samples per side
+ * @param seed Seed for the random generators. 0 to seed from the clock
+ */
+Atmosphere::Atmosphere(Telescope _tel, double _r0, double _L0, double _windX, double _windY, double _altitude, double _siteAltitude, uint32_t screenSize, uint32_t seed)
+    : tel(_tel), r0_500(_r0), L0(_L0), windX(_windX), windY(_windY), altitude(_altitude), siteAltitude(_siteAltitude)
+{
+    if (seed == 0)
+    {
+        seed = std::chrono::system_clock::now().time_since_epoch().count();
+    }
+    generator.seed(seed);
+
+    // Sample the pupil finely enough for both the aperture and the turbulence
+    double D = tel.DIAMETER / 1000.0;
+    double dx = std::min(r0(500.0) / 3.0, D / 16.0);
+    screen = std::make_unique<PhaseScreen>(screenSize, dx, r0(500.0), L0, generator());
+}
+
+Atmosphere::~Atmosphere()
+{
+#ifdef DEBUG_MEMORY
+    std::cout << "Destroyed Atmosphere " << std::endl;
+#endif
+}
+
+/**
+ * Fried parameter along the line of sight
+ *
+ * @param wavelength Wavelength, in nm
+ * @return r0, in metres
+ */
+double Atmosphere::r0(double wavelength) const
+{
+    double X = astroUtilities::airmass(altitude);
+    return r0_500 * pow(wavelength / 500.0, 6.0 / 5.0) * pow(X, -3.0 / 5.0);
+}
+
+/**
+ * Long exposure seeing FWHM, ignoring the outer scale
+ *
+ * @param wavelength Wavelength, in nm
+ * @return FWHM, in arcsec
+ */
+double Atmosphere::seeingFWHM(double wavelength) const
+{
+    return 0.98 * (wavelength * 1E-9) / r0(wavelength) * (180 / M_PI) * 3600;
+}
+
+/**
+ * Scintillation index (variance of relative flux) for an exposure
+ *
+ * @param expT Exposure time, in seconds
+ * @return Variance of the relative flux
+ */
+double Atmosphere::scintillationIndex(double expT) const
+{
+    double D = tel.DIAMETER / 1000.0;
+    double X = astroUtilities::airmass(altitude);
+    return 1E-5 * pow(D, -4.0 / 3.0) * pow(X, 3) * exp(-2 * siteAltitude / 8000.0) / expT;
+}
+
+/**
+ * Random relative flux for one exposure, log-normal with unit mean. Multiply the source flux by this.
+ *
+ * @param expT Exposure time, in seconds
+ * @return Relative flux
+ */
+double Atmosphere::scintillationFactor(double expT)
+{
+    double s2 = log(1 + scintillationIndex(expT));
+    std::normal_distribution<double> logFlux(-s2 / 2, sqrt(s2));
+    return exp(logFlux(generator));
+}
+
+/**
+ * PSF of an exposure starting at the given time. The screen is moved by the wind between PSF time steps.
+ *
+ * @param time Start of the exposure, in seconds
+ * @param expT Exposure time, in seconds
+ * @param wavelength Wavelength, in nm
+ * @param oversampling Stamp samples per simel, per side
+ * @return Normalised PSF stamp, to be used with Frame::addSource
+ */
+std::shared_ptr<const PSFStamp> Atmosphere::shortExposurePSF(double time, double expT, double wavelength, uint16_t oversampling)
+{
+    const double D = tel.DIAMETER / 1000.0;
+    const double Dsec = tel.SECONDARY_DIAMETER / 1000.0;
+    const double dx = screen->pixelScale();
+    const double lambda = wavelength * 1E-9;
+    const double phaseScale = 500.0 / wavelength;
+    const double sampleRad = (astroUtilities::plateScale(tel) / tel.SIMELS / oversampling) / 3600 * (M_PI / 180);
+
+    const uint32_t nPupil = (uint32_t)std::ceil(D / dx);
+    const uint32_t P = fft::nextPowerOfTwo(std::max<uint32_t>(2 * nPupil, (uint32_t)std::ceil(lambda / (dx * sampleRad))));
+    const double fftRad = lambda / (P * dx);
+
+    std::vector<double> intensity((std::size_t)P * P, 0.0);
+    std::vector<fft::complex> field((std::size_t)P * P);
+    uint16_t steps = timeSteps(expT);
+
+    for (uint16_t k = 0; k < steps; k++)
+    {
+        double t = time + (k + 0.5) * expT / steps;
+        double offsetX = windX * t;
+        double offsetY = windY * t;
+
+        std::fill(field.begin(), field.end(), fft::complex(0, 0));
+        for (uint32_t j = 0; j < nPupil; j++)
+        {
+            double y = (j - (nPupil - 1) / 2.0) * dx;
+            for (uint32_t i = 0; i < nPupil; i++)
+            {
+                double x = (i - (nPupil - 1) / 2.0) * dx;
+                double r = sqrt(x * x + y * y);
+                if (r <= D / 2 && r >= Dsec / 2)
+                {
+                    field[(std::size_t)j * P + i] = std::polar(1.0, (*screen)(x + offsetX, y + offsetY) * phaseScale);
+                }
+            }
+        }
+
+        fft::transform2d(field, P, P);
+        for (uint32_t v = 0; v < P; v++)
+        {
+            for (uint32_t u = 0; u < P; u++)
+            {
+                // Shift zero frequency to the centre
+                std::size_t shifted = (std::size_t)((v + P / 2) % P) * P + ((u + P / 2) % P);
+                intensity[shifted] += std::norm(field[(std::size_t)v * P + u]);
+            }
+        }
+    }
+
+    // Resample on the stamp grid
+    uint16_t half = (uint16_t)std::floor((P / 2.0 - 2) * fftRad / sampleRad);
+    std::shared_ptr<PSFStamp> stamp = std::make_shared<PSFStamp>();
+    stamp->oversampling = oversampling;
+    stamp->centerX = half;
+    stamp->centerY = half;
+    stamp->data.resize(2 * half + 1, 2 * half + 1);
+
+    double total = 0;
+    for (uint16_t sy = 0; sy < stamp->data.height(); sy++)
+    {
+        double v = (sy - half) * sampleRad / fftRad + P / 2.0;
+        uint32_t v0 = (uint32_t)v;
+        double fv = v - v0;
+        for (uint16_t sx = 0; sx < stamp->data.width(); sx++)
+        {
+            double u = (sx - half) * sampleRad / fftRad + P / 2.0;
+            uint32_t u0 = (uint32_t)u;
+            double fu = u - u0;
+            double top = intensity[(std::size_t)v0 * P + u0] * (1 - fu) + intensity[(std::size_t)v0 * P + u0 + 1] * fu;
+            double bottom = intensity[(std::size_t)(v0 + 1) * P + u0] * (1 - fu) + intensity[(std::size_t)(v0 + 1) * P + u0 + 1] * fu;
+            stamp->data(sx, sy) = top * (1 - fv) + bottom * fv;
+            total += stamp->data(sx, sy);
+        }
+    }
+
+    for (uint32_t i = 0; i < stamp->data.size(); i++)
+    {
+        stamp->data[i] /= total;
+    }
+    stamp->data.extraPixel() = 0;
+
+    return stamp;
+}
+
+// Enough PSF time steps for the screen to move by a quarter of the aperture between steps, up to 32.
+uint16_t Atmosphere::timeSteps(double expT) const
+{
+    double D = tel.DIAMETER / 1000.0;
+    double travel = sqrt(windX * windX + windY * windY) * expT;
+    return (uint16_t)std::min(std::max(std::ceil(travel / (D / 4)), 1.0), 32.0);
+}
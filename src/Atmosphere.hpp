@@ -0,0 +1,68 @@
+/**
+ * Twinkle FGS-Sim: Centroid recovery simulation
+ *
+ * @file Atmosphere.hpp
+ * @brief Header file for PhaseScreen and Atmosphere classes
+ * @author Claudio Arena
+ * @version 1.0.0 2026-10-18
+ */
+#pragma once
+
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "typedefs.h"
+#include "telescopes.h"
+#include "PolychromaticPSF.hpp"
+
+/**
+ * Periodic von Karman phase screen, generated once by FFT synthesis.
+ * Phases are in radians at 500 nm.
+ *
+ * @brief Class holding a turbulent phase screen
+ */
+class PhaseScreen
+{
+public:
+  PhaseScreen(uint32_t _size, double _pixelScale, double r0, double L0, uint32_t seed);
+  ~PhaseScreen();
+
+  double operator()(double x, double y) const;
+  uint32_t size() const { return n; }
+  double pixelScale() const { return dx; }
+
+private:
+  uint32_t n;
+  double dx; // metres per screen sample
+  std::vector<double> phase;
+};
+
+/**
+ * Atmospheric turbulence for ground telescopes. A single phase screen is swept across the pupil by the wind (frozen flow),
+ * so a long sequence of frames only costs one small FFT per PSF time step.
+ * Also gives scintillation flux modulation, following Young's approximation.
+ *
+ * @brief Class to simulate seeing and scintillation
+ */
+class Atmosphere
+{
+public:
+  Atmosphere(Telescope _tel, double _r0 = 0.1, double _L0 = 25.0, double _windX = 10.0, double _windY = 0.0, double _altitude = 90.0,
+             double _siteAltitude = 0.0, uint32_t screenSize = 256, uint32_t seed = 0);
+  ~Atmosphere();
+
+  std::shared_ptr<const PSFStamp> shortExposurePSF(double time, double expT, double wavelength = V_filter.centerBand, uint16_t oversampling = 4);
+  double scintillationIndex(double expT) const;
+  double scintillationFactor(double expT);
+  double seeingFWHM(double wavelength = V_filter.centerBand) const;
+  double r0(double wavelength = 500.0) const;
+
+private:
+  Telescope tel;
+  double r0_500, L0, windX, windY, altitude, siteAltitude;
+  std::unique_ptr<PhaseScreen> screen;
+  std::mt19937 generator;
+
+  uint16_t timeSteps(double expT) const;
+};
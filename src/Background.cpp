@@ -0,0 +1,190 @@
+/**
+ * Twinkle FGS-Sim: Centroid recovery simulation
+ *
+ * @file Background.cpp
+ * @brief Cached sky and thermal background maps
+ * @author Claudio Arena
+ * @version 1.0.0 2026-10-18
+ * @description Zodiacal light brightness is given at the ecliptic poles, and is doubled on the ecliptic with a cos^2 dependence on
+ * ecliptic latitude. This is a coarse model, good enough to study the effect of background level on centroids.
+ * Stray light maps are read from the same csv format written by Frame::saveToFile, in ADU/s.
+ */
+
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include "Background.hpp"
+#include "astroUtilities.hpp"
+
+/**
+ * Constructs a Background object.
+ *
+ * @param _zodiacalMags Zodiacal light surface brightness at the ecliptic poles, in mag/arcsec^2, one per telescope filter
+ */
+Background::Background(std::vector<double> _zodiacalMags) : zodiacalMags(_zodiacalMags)
+{
+}
+
+Background::~Background()
+{
+#ifdef DEBUG_MEMORY
+    std::cout << "Destroyed Background " << std::endl;
+#endif
+}
+
+void Background::setZodiacal(bool enable, std::vector<double> mags)
+{
+    std::lock_guard<std::mutex> guard(map_mutex);
+    zodiacal = enable;
+    if (mags.size() > 0)
+    {
+        zodiacalMags = mags;
+    }
+    invalidate();
+}
+
+void Background::setThermal(bool enable)
+{
+    std::lock_guard<std::mutex> guard(map_mutex);
+    thermal = enable;
+    invalidate();
+}
+
+/**
+ * Adds a linear gradient to the uniform background.
+ *
+ * @param _gradientX Fractional change of the background from the left to the right edge of the frame
+ * @param _gradientY Fractional change of the background from the top to the bottom edge of the frame
+ */
+void Background::setGradient(double _gradientX, double _gradientY)
+{
+    std::lock_guard<std::mutex> guard(map_mutex);
+    gradientX = _gradientX;
+    gradientY = _gradientY;
+    invalidate();
+}
+
+/**
+ * Sets a stray light map, in ADU/s per pixel. Must have the frame size.
+ */
+void Background::setStrayLight(Grid<double> _strayLight)
+{
+    std::lock_guard<std::mutex> guard(map_mutex);
+    strayLight = _strayLight;
+    invalidate();
+}
+
+/**
+ * Loads a stray light map, in ADU/s per pixel, from a csv file. First line is width;height, then one line per row.
+ */
+void Background::loadStrayLight(std::string filename)
+{
+    std::ifstream file(filename.c_str());
+    if (file.fail())
+    {
+        throw "Error! Could not open stray light file";
+    }
+
+    std::string line;
+    getline(file, line);
+    uint32_t w = 0, h = 0;
+    char separator;
+    std::stringstream header(line);
+    header >> w >> separator >> h;
+
+    Grid<double> map(w, h);
+    for (uint32_t y = 0; y < h && getline(file, line); y++)
+    {
+        std::stringstream linestream(line);
+        std::string value;
+        for (uint32_t x = 0; x < w && getline(linestream, value, ','); x++)
+        {
+            map(x, y) = std::stod(value);
+        }
+    }
+
+    setStrayLight(map);
+}
+
+/**
+ * Uniform background rate, without gradient and stray light.
+ *
+ * @param tel Telescope
+ * @param pointing Pointing of the telescope, used for the zodiacal light level
+ * @return Background, in ADU/s per pixel
+ */
+double Background::rate(const Telescope &tel, sky_coordinates pointing) const
+{
+    double total = 0;
+    if (zodiacal)
+    {
+        if (zodiacalMags.size() != tel.FGS_filter.size())
+        {
+            throw "Error! Number of zodiacal light magnitudes must match number of telescope filters";
+        }
+        double beta = astroUtilities::eclipticLatitude(pointing) * (M_PI / 180);
+        total += astroUtilities::zodiacalSignal(tel, zodiacalMags) * (1 + pow(cos(beta), 2));
+    }
+    if (thermal)
+    {
+        total += astroUtilities::mirrorThermalSignal(tel);
+    }
+    return total;
+}
+
+/**
+ * Background map for one exposure. The map is rebuilt only if the telescope, exposure time, pointing or settings changed.
+ *
+ * @param tel Telescope
+ * @param expT Exposure time, in seconds
+ * @param pointing Pointing of the telescope
+ * @return Expected background ADUs for each pixel
+ */
+std::shared_ptr<const Grid<double>> Background::map(const Telescope &tel, double expT, sky_coordinates pointing)
+{
+    std::lock_guard<std::mutex> guard(map_mutex);
+
+    const std::string telescope = astroUtilities::telescopeKey(tel);
+    if (cachedMap && cachedTelescope == telescope && cachedExpT == expT && cachedPointing.ra == pointing.ra && cachedPointing.dec == pointing.dec &&
+        cachedMap->width() == tel.FRAME_W && cachedMap->height() == tel.FRAME_H)
+    {
+        return cachedMap;
+    }
+
+    if (strayLight.width() > 0 && (strayLight.width() != tel.FRAME_W || strayLight.height() != tel.FRAME_H))
+    {
+        throw "Error! Stray light map size doesn't match the frame size";
+    }
+
+    std::shared_ptr<Grid<double>> bg = std::make_shared<Grid<double>>(tel.FRAME_W, tel.FRAME_H);
+    double level = rate(tel, pointing) * expT;
+    pixel_coordinates center = astroUtilities::frameCenter(tel.FRAME_W, tel.FRAME_H);
+
+    for (uint32_t y = 0; y < tel.FRAME_H; y++)
+    {
+        double yTerm = gradientY * (y - center.y) / tel.FRAME_H;
+        for (uint32_t x = 0; x < tel.FRAME_W; x++)
+        {
+            double xTerm = gradientX * (x - center.x) / tel.FRAME_W;
+            double value = level * (1 + xTerm + yTerm);
+            if (strayLight.width() > 0)
+            {
+                value += strayLight(x, y) * expT;
+            }
+            (*bg)(x, y) = std::max(value, 0.0);
+        }
+    }
+
+    cachedMap = bg;
+    cachedTelescope = telescope;
+    cachedExpT = expT;
+    cachedPointing = pointing;
+    return cachedMap;
+}
+
+void Background::invalidate()
+{
+    cachedMap.reset();
+}
@@ -0,0 +1,56 @@
+/**
+ * Twinkle FGS-Sim: Centroid recovery simulation
+ *
+ * @file Background.hpp
+ * @brief Header file for Background class
+ * @author Claudio Arena
+ * @version 1.0.0 2026-10-18
+ */
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "typedefs.h"
+#include "Grid.hpp"
+#include "telescopes.h"
+
+/**
+ * Per-pixel sky and thermal background. Zodiacal light, mirror thermal emission, an optional linear gradient and an
+ * optional stray light map are combined in a map of expected ADUs per pixel for one exposure.
+ * The map is computed once per (telescope, exposure time, pointing) and reused until one of them changes.
+ *
+ * @brief Class to build cached background maps
+ */
+class Background
+{
+public:
+  Background(std::vector<double> _zodiacalMags = {22.37, 21.89, 21.44});
+  ~Background();
+
+  void setZodiacal(bool enable, std::vector<double> mags = {});
+  void setThermal(bool enable);
+  void setGradient(double _gradientX, double _gradientY);
+  void setStrayLight(Grid<double> _strayLight);
+  void loadStrayLight(std::string filename);
+
+  std::shared_ptr<const Grid<double>> map(const Telescope &tel, double expT, sky_coordinates pointing);
+  double rate(const Telescope &tel, sky_coordinates pointing) const;
+
+private:
+  std::vector<double> zodiacalMags; // mag/arcsec^2 at the ecliptic poles, one per telescope filter
+  bool zodiacal = true, thermal = true;
+  double gradientX = 0, gradientY = 0; // fractional change of the background across the frame
+  Grid<double> strayLight;             // ADU/s per pixel
+
+  // Cached map and the parameters it was built for
+  std::shared_ptr<const Grid<double>> cachedMap;
+  std::string cachedTelescope; // astroUtilities::telescopeKey of the cached map
+  double cachedExpT = -1;
+  sky_coordinates cachedPointing = {0, 0};
+  std::mutex map_mutex;
+
+  void invalidate();
+};
@@ -0,0 +1,188 @@
+/**
+ * Twinkle FGS-Sim: Centroid recovery simulation
+ *
+ * @file CTI.cpp
+ * @brief Trap capture and release during the parallel readout
+ * @author Claudio Arena
+ * @version 1.0.0 2026-10-18
+ * @description Volume driven capture: a packet of q electrons reaches the traps in a fraction (q / full well)^beta of
+ * the pixel volume, and fills them instantly. Filled traps release a fraction 1 - exp(-1 / tau) of their charge per
+ * transfer into the packet that is in the pixel, before it is captured from.
+ * In the fast model the packet of row y meets y pixels worth of traps, density * y, whose occupancy is the one left by
+ * the packets read before it in the same column. The exact model keeps the occupancy of every pixel, and costs
+ * height^2 / 2 interactions per column.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "CTI.hpp"
+
+/**
+ * Constructs a CTI object.
+ *
+ * @param _species Trap species
+ * @param _fullWell Full well capacity, in electrons
+ * @param _beta Exponent of the charge volume with the number of electrons
+ * @param _exact Follow each transfer instead of the fast column model
+ */
+CTI::CTI(std::vector<trap_species> _species, double _fullWell, double _beta, bool _exact)
+    : species(_species), fullWell(_fullWell), beta(_beta), exact(_exact)
+{
+    for (const trap_species &trap : species)
+    {
+        if (trap.density < 0 || trap.releaseTime <= 0)
+        {
+            throw "Error! Trap species need a positive density and release time";
+        }
+        releaseFraction.push_back(1 - exp(-1 / trap.releaseTime));
+    }
+}
+
+CTI::~CTI()
+{
+#ifdef DEBUG_MEMORY
+    std::cout << "Destroyed CTI " << std::endl;
+#endif
+}
+
+void CTI::reset(uint32_t width)
+{
+    filled.assign(species.size() * width, 0.0);
+    volume.assign(width, 0.0);
+}
+
+/**
+ * One transfer of a row of packets over a row of pixels. The traps release into the packets first, then each packet
+ * fills its volume of the pixel and the traps in it catch their share. The volume depends on the packet alone, so it
+ * is computed once per column for all the species.
+ *
+ * @param q Packets, in electrons
+ * @param trapped Filled traps of the first species, the others following at speciesStride
+ * @param speciesStride Distance between the traps of two species
+ * @param pixels Pixels worth of traps met by the packets
+ * @param width Number of columns
+ */
+void CTI::meetTraps(double *q, double *trapped, std::size_t speciesStride, double pixels, uint32_t width)
+{
+    if (volume.size() < width)
+    {
+        volume.resize(width);
+    }
+    double *__restrict packets = q;
+    double *__restrict filledVolume = volume.data();
+    for (std::size_t s = 0; s < species.size(); s++)
+    {
+        double *__restrict traps = trapped + s * speciesStride;
+        const double release = releaseFraction[s];
+        for (uint32_t x = 0; x < width; x++)
+        {
+            const double released = traps[x] * release;
+            packets[x] += released;
+            traps[x] -= released;
+        }
+    }
+    for (uint32_t x = 0; x < width; x++)
+    {
+        filledVolume[x] = (packets[x] > 0) ? std::min(pow(packets[x] / fullWell, beta), 1.0) : 0.0;
+    }
+    for (std::size_t s = 0; s < species.size(); s++)
+    {
+        double *__restrict traps = trapped + s * speciesStride;
+        const double density = species[s].density * pixels;
+        for (uint32_t x = 0; x < width; x++)
+        {
+            const double captured = std::min(std::max(density * filledVolume[x] - traps[x], 0.0), packets[x]);
+            traps[x] += captured;
+            packets[x] -= captured;
+        }
+    }
+}
+
+/**
+ * Reads out one row with the fast model. Rows must come in readout order, from 0, after a reset.
+ *
+ * @param y Row, i.e. number of pixels the charge goes through
+ * @param charge Charge of each column, modified in place
+ * @param width Number of columns
+ * @param electronsPerUnit Electrons per unit of charge, e.g. the gain for ADUs
+ */
+void CTI::transferRow(uint32_t y, double *charge, uint32_t width, double electronsPerUnit)
+{
+    if (filled.size() != species.size() * width)
+    {
+        reset(width);
+    }
+
+    const double toUnits = 1.0 / electronsPerUnit;
+    for (uint32_t x = 0; x < width; x++)
+    {
+        charge[x] *= electronsPerUnit;
+    }
+    meetTraps(charge, filled.data(), width, y, width);
+    for (uint32_t x = 0; x < width; x++)
+    {
+        charge[x] *= toUnits;
+    }
+}
+
+/**
+ * Applies CTI to a frame, with the model chosen at construction. Charge left in the traps at the end is lost.
+ *
+ * @param frame Frame, modified in place
+ * @param electronsPerUnit Electrons per unit of charge, e.g. the gain for ADUs
+ */
+void CTI::apply(Grid<uint32_t> &frame, double electronsPerUnit)
+{
+    if (exact)
+    {
+        applyExact(frame, electronsPerUnit);
+        return;
+    }
+
+    const uint32_t w = frame.width();
+    std::vector<double> row(w);
+    reset(w);
+    for (uint32_t y = 0; y < frame.height(); y++)
+    {
+        for (uint32_t x = 0; x < w; x++)
+        {
+            row[x] = frame[(std::size_t)y * w + x];
+        }
+        transferRow(y, row.data(), w, electronsPerUnit);
+        for (uint32_t x = 0; x < w; x++)
+        {
+            frame[(std::size_t)y * w + x] = (uint32_t)std::round(row[x]);
+        }
+    }
+}
+
+void CTI::applyExact(Grid<uint32_t> &frame, double electronsPerUnit)
+{
+    const uint32_t w = frame.width();
+    const uint32_t h = frame.height();
+
+    // Packets in electrons, indexed by their original row. Occupancy of the traps of each pixel.
+    std::vector<double> packets((std::size_t)w * h);
+    for (std::size_t i = 0; i < (std::size_t)w * h; i++)
+    {
+        packets[i] = frame[i] * electronsPerUnit;
+    }
+    std::vector<double> occupancy(species.size() * w * (std::size_t)h, 0.0);
+
+    // At each transfer, the packet of row r moves to pixel r - k and meets its traps
+    for (uint32_t k = 1; k < h; k++)
+    {
+        for (uint32_t r = k; r < h; r++)
+        {
+            const uint32_t p = r - k;
+            meetTraps(&packets[(std::size_t)r * w], &occupancy[(std::size_t)p * w], (std::size_t)h * w, 1, w);
+        }
+    }
+
+    for (std::size_t i = 0; i < (std::size_t)w * h; i++)
+    {
+        frame[i] = (uint32_t)std::round(packets[i] / electronsPerUnit);
+    }
+}
@@ -0,0 +1,58 @@
+/**
+ * Twinkle FGS-Sim: Centroid recovery simulation
+ *
+ * @file CTI.hpp
+ * @brief Header file for CTI class
+ * @author Claudio Arena
+ * @version 1.0.0 2026-10-18
+ */
+#pragma once
+
+#include <vector>
+
+#include "typedefs.h"
+#include "Grid.hpp"
+
+// A population of charge traps
+struct trap_species
+{
+  double density;     // traps per pixel
+  double releaseTime; // e-folding release time, in transfers
+};
+
+/**
+ * Charge transfer inefficiency of the parallel readout. Frames are read towards row 0, so the packet of row y goes
+ * through y pixels. Traps catch part of each packet, depending on the volume the charge fills in the pixel, and release
+ * it exponentially into the packets behind, leaving trails towards larger y.
+ * The fast model keeps the trap state of each column along the readout, so rows are processed in readout order with all
+ * columns at once. The exact model follows every trap of every pixel through every transfer.
+ *
+ * @brief Class modelling charge transfer inefficiency
+ */
+class CTI
+{
+public:
+  CTI(std::vector<trap_species> _species, double _fullWell = 1E5, double _beta = 0.58, bool _exact = false);
+  ~CTI();
+
+  bool isExact() const { return exact; }
+
+  // Fast model, one row at a time in readout order. Charge is in units of electronsPerUnit electrons.
+  void reset(uint32_t width);
+  void transferRow(uint32_t y, double *charge, uint32_t width, double electronsPerUnit = 1.0);
+
+  // Whole frame, with the chosen model
+  void apply(Grid<uint32_t> &frame, double electronsPerUnit = 1.0);
+
+private:
+  std::vector<trap_species> species;
+  double fullWell, beta;
+  bool exact;
+  std::vector<double> releaseFraction; // fraction of the trapped charge released per transfer, per species
+  std::vector<double> filled;          // fast model state: filled traps along each column, species major
+  std::vector<double> volume;          // fraction of the pixel volume filled by the packet of each column
+
+  void meetTraps(double *q, double *trapped, std::size_t speciesStride, double pixels, uint32_t width);
+
+  void applyExact(Grid<uint32_t> &frame, double electronsPerUnit);
+};
@@ -0,0 +1,379 @@
+/**
+ * Twinkle FGS-Sim: Centroid recovery simulation
+ *
+ * @file Catalog.cpp
+ * @brief Memory mapped star catalog with sky tiled queries
+ * @author Claudio Arena
+ * @version 1.0.0 2026-10-18
+ * @description File layout: header, first tile of each ring (nRings + 1), padded to 8 bytes, first star of each tile (nTiles + 1),
+ * ra column, dec column, then one float magnitude column per band. Values are stored in the byte order of the machine writing the file.
+ * Ring r covers declinations -90 + r h to -90 + (r + 1) h, and is cut in max(1, round(360 cos(dec_mid) / h)) tiles of equal RA width.
+ * Queries list the tiles overlapping the region directly from the ring geometry, then test each star of those tiles exactly.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Catalog.hpp"
+
+namespace
+{
+const char CATALOG_MAGIC[8] = {'F', 'G', 'S', 'C', 'A', 'T', '0', '1'};
+const uint32_t CATALOG_VERSION = 1;
+
+std::size_t align8(std::size_t bytes)
+{
+    return (bytes + 7) & ~(std::size_t)7;
+}
+
+// Offsets of the sections of a catalog file
+struct catalog_layout
+{
+    std::size_t rings, tiles, ra, dec, mags, end;
+
+    catalog_layout(uint32_t nRings, uint32_t nTiles, uint64_t nStars, uint32_t nBands)
+    {
+        rings = sizeof(Catalog::file_header);
+        tiles = align8(rings + (nRings + 1) * sizeof(uint32_t));
+        ra = tiles + (nTiles + 1) * sizeof(uint64_t);
+        dec = ra + nStars * sizeof(double);
+        mags = dec + nStars * sizeof(double);
+        end = mags + nStars * nBands * sizeof(float);
+    }
+};
+
+double normaliseRA(double ra)
+{
+    ra = fmod(ra, 360.0);
+    return (ra < 0) ? ra + 360.0 : ra;
+}
+} // namespace
+
+/**
+ * Maps a catalog file. Nothing is read until queried.
+ *
+ * @param filename Catalog file, as written by convertCSV
+ */
+Catalog::Catalog(std::string filename)
+{
+    fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        throw "Error! Could not open catalog file";
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (std::size_t)info.st_size < sizeof(file_header))
+    {
+        close(fd);
+        throw "Error! Catalog file is too small";
+    }
+    mappingSize = info.st_size;
+
+    mapping = mmap(nullptr, mappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping == MAP_FAILED)
+    {
+        close(fd);
+        throw "Error! Could not map catalog file";
+    }
+    madvise(mapping, mappingSize, MADV_RANDOM);
+
+    const char *base = (const char *)mapping;
+    header = (const file_header *)base;
+    catalog_layout layout(header->nRings, header->nTiles, header->nStars, header->nBands);
+    if (memcmp(header->magic, CATALOG_MAGIC, sizeof(CATALOG_MAGIC)) != 0 || header->version != CATALOG_VERSION || layout.end != mappingSize)
+    {
+        munmap(mapping, mappingSize);
+        close(fd);
+        throw "Error! Not a valid catalog file";
+    }
+
+    ringFirstTile = (const uint32_t *)(base + layout.rings);
+    tileStart = (const uint64_t *)(base + layout.tiles);
+    raColumn = (const double *)(base + layout.ra);
+    decColumn = (const double *)(base + layout.dec);
+    magColumns = (const float *)(base + layout.mags);
+}
+
+Catalog::~Catalog()
+{
+    munmap(mapping, mappingSize);
+    close(fd);
+#ifdef DEBUG_MEMORY
+    std::cout << "Destroyed Catalog " << std::endl;
+#endif
+}
+
+/**
+ * Converts a csv catalog. Lines that don't start with a number, e.g. a header, are skipped.
+ *
+ * @param csvFilename Input csv, with ra, dec in degrees and one magnitude per band on each line
+ * @param catalogFilename Output catalog file
+ * @param tileSize Height of the sky rings, in degrees. Tiles are about tileSize x tileSize
+ * @return Number of stars written
+ */
+uint64_t Catalog::convertCSV(std::string csvFilename, std::string catalogFilename, double tileSize)
+{
+    std::ifstream csv(csvFilename.c_str());
+    if (csv.fail())
+    {
+        throw "Error! Could not open catalog csv file";
+    }
+
+    std::vector<double> ra, dec;
+    std::vector<float> mags;
+    uint32_t nBands = 0;
+    std::string line;
+    while (getline(csv, line))
+    {
+        std::vector<double> values;
+        std::stringstream linestream(line);
+        std::string value;
+        while (getline(linestream, value, ','))
+        {
+            char *end;
+            double number = strtod(value.c_str(), &end);
+            if (end == value.c_str())
+            {
+                break;
+            }
+            values.push_back(number);
+        }
+        if (values.size() < 2)
+        {
+            continue;
+        }
+        if (ra.empty())
+        {
+            nBands = values.size() - 2;
+        }
+        if (values.size() != nBands + 2)
+        {
+            throw "Error! Catalog csv lines have different numbers of columns";
+        }
+        ra.push_back(normaliseRA(values[0]));
+        dec.push_back(std::min(std::max(values[1], -90.0), 90.0));
+        mags.insert(mags.end(), values.begin() + 2, values.end());
+    }
+
+    file_header head;
+    memcpy(head.magic, CATALOG_MAGIC, sizeof(CATALOG_MAGIC));
+    head.version = CATALOG_VERSION;
+    head.nBands = nBands;
+    head.nStars = ra.size();
+    head.nRings = std::max<uint32_t>(1, (uint32_t)std::ceil(180.0 / tileSize));
+    head.tileSize = 180.0 / head.nRings;
+
+    std::vector<uint32_t> rings(head.nRings + 1, 0);
+    for (uint32_t r = 0; r < head.nRings; r++)
+    {
+        rings[r + 1] = rings[r] + ringTiles(r, head.nRings);
+    }
+    head.nTiles = rings[head.nRings];
+
+    // Counting sort of the stars by tile
+    std::vector<uint32_t> starTile(head.nStars);
+    std::vector<uint64_t> tiles(head.nTiles + 1, 0);
+    for (uint64_t i = 0; i < head.nStars; i++)
+    {
+        uint32_t r = std::min<uint32_t>(head.nRings - 1, (uint32_t)std::floor((dec[i] + 90.0) / head.tileSize));
+        uint32_t n = rings[r + 1] - rings[r];
+        starTile[i] = rings[r] + std::min<uint32_t>(n - 1, (uint32_t)std::floor(ra[i] / 360.0 * n));
+        tiles[starTile[i] + 1]++;
+    }
+    for (uint32_t t = 0; t < head.nTiles; t++)
+    {
+        tiles[t + 1] += tiles[t];
+    }
+    std::vector<uint64_t> order(head.nStars);
+    std::vector<uint64_t> next(tiles.begin(), tiles.end() - 1);
+    for (uint64_t i = 0; i < head.nStars; i++)
+    {
+        order[next[starTile[i]]++] = i;
+    }
+
+    std::ofstream file(catalogFilename.c_str(), std::ios::out | std::ios::binary);
+    if (file.fail())
+    {
+        throw "Error! Could not write catalog file";
+    }
+
+    catalog_layout layout(head.nRings, head.nTiles, head.nStars, head.nBands);
+    file.write((const char *)&head, sizeof(head));
+    file.write((const char *)rings.data(), rings.size() * sizeof(uint32_t));
+    std::vector<char> padding(layout.tiles - layout.rings - rings.size() * sizeof(uint32_t), 0);
+    file.write(padding.data(), padding.size());
+    file.write((const char *)tiles.data(), tiles.size() * sizeof(uint64_t));
+
+    std::vector<double> column(head.nStars);
+    for (uint64_t i = 0; i < head.nStars; i++)
+        column[i] = ra[order[i]];
+    file.write((const char *)column.data(), column.size() * sizeof(double));
+    for (uint64_t i = 0; i < head.nStars; i++)
+        column[i] = dec[order[i]];
+    file.write((const char *)column.data(), column.size() * sizeof(double));
+
+    std::vector<float> magColumn(head.nStars);
+    for (uint32_t band = 0; band < nBands; band++)
+    {
+        for (uint64_t i = 0; i < head.nStars; i++)
+            magColumn[i] = mags[order[i] * nBands + band];
+        file.write((const char *)magColumn.data(), magColumn.size() * sizeof(float));
+    }
+
+    file.close();
+    return head.nStars;
+}
+
+/**
+ * Stars within an angular distance of a sky position
+ *
+ * @param center Centre of the cone, in degrees
+ * @param radius Radius of the cone, in degrees
+ * @return Stars in the cone, in catalog order
+ */
+catalog_batch Catalog::cone(sky_coordinates center, double radius) const
+{
+    const double toRad = M_PI / 180;
+    double decMin = center.dec - radius;
+    double decMax = center.dec + radius;
+
+    // Widest RA extent of the cap, unless it contains a pole
+    double halfRA = 180.0;
+    if (decMax < 90.0 && decMin > -90.0)
+    {
+        halfRA = asin(std::min(1.0, sin(radius * toRad) / cos(center.dec * toRad))) / toRad;
+    }
+
+    std::vector<std::pair<uint64_t, uint64_t>> ranges;
+    for (uint32_t r = ring(std::max(decMin, -90.0)); r <= ring(std::min(decMax, 90.0)); r++)
+    {
+        addTiles(r, center.ra - halfRA, center.ra + halfRA, ranges);
+    }
+
+    catalog_batch batch;
+    batch.nBands = nBands();
+    const double cosRadius = cos(radius * toRad);
+    const double sinDec = sin(center.dec * toRad);
+    const double cosDec = cos(center.dec * toRad);
+    for (const std::pair<uint64_t, uint64_t> &range : ranges)
+    {
+        for (uint64_t i = range.first; i < range.second; i++)
+        {
+            double d = decColumn[i] * toRad;
+            double cosDistance = sinDec * sin(d) + cosDec * cos(d) * cos((raColumn[i] - center.ra) * toRad);
+            if (cosDistance >= cosRadius)
+            {
+                append(i, batch);
+            }
+        }
+    }
+    return batch;
+}
+
+/**
+ * Stars within an RA and Dec box
+ *
+ * @param raMin Lower RA, in degrees. If larger than raMax, the box wraps through RA 0
+ * @param raMax Upper RA, in degrees
+ * @param decMin Lower declination, in degrees
+ * @param decMax Upper declination, in degrees
+ * @return Stars in the box, in catalog order
+ */
+catalog_batch Catalog::rectangle(double raMin, double raMax, double decMin, double decMax) const
+{
+    raMin = normaliseRA(raMin);
+    double width = normaliseRA(raMax - raMin);
+    if (width == 0 && raMax != raMin)
+    {
+        width = 360.0;
+    }
+
+    std::vector<std::pair<uint64_t, uint64_t>> ranges;
+    for (uint32_t r = ring(std::max(decMin, -90.0)); r <= ring(std::min(decMax, 90.0)); r++)
+    {
+        addTiles(r, raMin, raMin + width, ranges);
+    }
+
+    catalog_batch batch;
+    batch.nBands = nBands();
+    for (const std::pair<uint64_t, uint64_t> &range : ranges)
+    {
+        for (uint64_t i = range.first; i < range.second; i++)
+        {
+            if (decColumn[i] >= decMin && decColumn[i] <= decMax && normaliseRA(raColumn[i] - raMin) <= width)
+            {
+                append(i, batch);
+            }
+        }
+    }
+    return batch;
+}
+
+uint32_t Catalog::ringTiles(uint32_t ring, uint32_t nRings)
+{
+    double h = 180.0 / nRings;
+    double decMid = -90.0 + (ring + 0.5) * h;
+    return std::max<uint32_t>(1, (uint32_t)std::lround(360.0 * cos(decMid * M_PI / 180) / h));
+}
+
+uint32_t Catalog::ring(double dec) const
+{
+    return std::min<uint32_t>(header->nRings - 1, (uint32_t)std::max(0.0, std::floor((dec + 90.0) / header->tileSize)));
+}
+
+uint32_t Catalog::tileInRing(uint32_t ring, double ra) const
+{
+    uint32_t n = ringFirstTile[ring + 1] - ringFirstTile[ring];
+    return std::min<uint32_t>(n - 1, (uint32_t)std::floor(normaliseRA(ra) / 360.0 * n));
+}
+
+// Star ranges of the tiles of a ring overlapping an RA interval. The interval can wrap through RA 0.
+void Catalog::addTiles(uint32_t ring, double raMin, double raMax, std::vector<std::pair<uint64_t, uint64_t>> &ranges) const
+{
+    const uint32_t first = ringFirstTile[ring];
+    const uint32_t n = ringFirstTile[ring + 1] - first;
+
+    if (raMax - raMin >= 360.0)
+    {
+        ranges.emplace_back(tileStart[first], tileStart[first + n]);
+        return;
+    }
+
+    uint32_t t0 = tileInRing(ring, raMin);
+    uint32_t t1 = tileInRing(ring, raMax);
+    if (normaliseRA(raMax) >= normaliseRA(raMin))
+    {
+        ranges.emplace_back(tileStart[first + t0], tileStart[first + t1 + 1]);
+    }
+    else if (t1 >= t0)
+    {
+        // Wraps back into the first tile
+        ranges.emplace_back(tileStart[first], tileStart[first + n]);
+    }
+    else
+    {
+        ranges.emplace_back(tileStart[first + t0], tileStart[first + n]);
+        ranges.emplace_back(tileStart[first], tileStart[first + t1 + 1]);
+    }
+}
+
+void Catalog::append(uint64_t id, catalog_batch &batch) const
+{
+    batch.ids.push_back(id);
+    batch.ra.push_back(raColumn[id]);
+    batch.dec.push_back(decColumn[id]);
+    for (uint16_t band = 0; band < batch.nBands; band++)
+    {
+        batch.mags.push_back(magColumns[band * header->nStars + id]);
+    }
+}
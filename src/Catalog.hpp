@@ -0,0 +1,85 @@
+/**
+ * Twinkle FGS-Sim: Centroid recovery simulation
+ *
+ * @file Catalog.hpp
+ * @brief Header file for Catalog class
+ * @author Claudio Arena
+ * @version 1.0.0 2026-10-18
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "typedefs.h"
+
+/**
+ * Stars returned by a catalog query, as a structure of arrays.
+ * mags holds nBands magnitudes per star, star after star, as expected by Scene::addStars.
+ */
+struct catalog_batch
+{
+  uint16_t nBands = 0;
+  std::vector<uint64_t> ids; // position of the star in the catalog file
+  std::vector<double> ra, dec; // degrees
+  std::vector<double> mags;
+
+  std::size_t size() const { return ids.size(); }
+};
+
+/**
+ * Read only star catalog, memory mapped from a binary file.
+ * The sky is cut in iso-latitude rings of equal height, and each ring in tiles of roughly equal area, similar to
+ * HEALPix rings. Stars are stored sorted by tile, with per-tile offsets, so a query only touches the pages of the
+ * tiles it overlaps. Columns are stored one after the other (ra, dec, then one float column per band).
+ *
+ * @brief Class to query a local star catalog
+ */
+class Catalog
+{
+public:
+  Catalog(std::string filename);
+  ~Catalog();
+  Catalog(const Catalog &) = delete;
+  Catalog &operator=(const Catalog &) = delete;
+
+  // Writes a catalog file from a csv with ra, dec (degrees) and one magnitude per band on each line
+  static uint64_t convertCSV(std::string csvFilename, std::string catalogFilename, double tileSize = 0.5);
+
+  catalog_batch cone(sky_coordinates center, double radius) const;
+  catalog_batch rectangle(double raMin, double raMax, double decMin, double decMax) const;
+
+  uint64_t size() const { return header->nStars; }
+  uint16_t nBands() const { return header->nBands; }
+  uint32_t nTiles() const { return header->nTiles; }
+  double tileSize() const { return header->tileSize; }
+
+  struct file_header
+  {
+    char magic[8];
+    uint32_t version;
+    uint32_t nBands;
+    uint64_t nStars;
+    double tileSize; // ring height, in degrees
+    uint32_t nRings;
+    uint32_t nTiles;
+  };
+
+private:
+  int fd = -1;
+  void *mapping = nullptr;
+  std::size_t mappingSize = 0;
+
+  const file_header *header = nullptr;
+  const uint32_t *ringFirstTile = nullptr; // nRings + 1 entries
+  const uint64_t *tileStart = nullptr;     // nTiles + 1 entries
+  const double *raColumn = nullptr;
+  const double *decColumn = nullptr;
+  const float *magColumns = nullptr; // nBands columns of nStars
+
+  static uint32_t ringTiles(uint32_t ring, uint32_t nRings);
+  uint32_t ring(double dec) const;
+  uint32_t tileInRing(uint32_t ring, double ra) const;
+  void addTiles(uint32_t ring, double raMin, double raMax, std::vector<std::pair<uint64_t, uint64_t>> &ranges) const;
+  void append(uint64_t id, catalog_batch &batch) const;
+};
@@ -0,0 +1,187 @@
+/**
+ * Twinkle FGS-Sim: Centroid recovery simulation
+ *
+ * @file CosmicRays.cpp
+ * @brief Cosmic ray hits with realistic track lengths
+ * @author Claudio Arena
+ * @version 1.0.0 2026-10-18
+ * @description Default flux is of the order of the galactic cosmic ray flux at L2, around 5 hits / cm^2 / s.
+ * Incidence angles follow a cosine law on the detector plane: cos(theta) = sqrt(U), with U uniform.
+ * Tracks are rasterised by sampling them every half pixel and sharing the charge of each sample bilinearly between
+ * the four nearest pixels. Sample positions and weights are computed in bulk, then added to the frame.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+#include "CosmicRays.hpp"
+#include "GridStorage.hpp"
+
+namespace
+{
+// Pixels and shares of the four pixels nearest to each sample. The arrays never overlap, and the loop has no branches,
+// so it vectorises. Positions are clamped to [-1, w] x [-1, h]: a sample off the frame then gives nothing to the pixels
+// in it. Corners off the frame get a zero share on a clamped index, so the scatter needs no bounds check.
+void shareSamples(std::size_t m, int32_t w, int32_t h, const double *__restrict xs, const double *__restrict ys,
+                  const double *__restrict qs, int32_t *__restrict cx0, int32_t *__restrict cx1, int32_t *__restrict cy0,
+                  int32_t *__restrict cy1, double *__restrict s00, double *__restrict s10, double *__restrict s01,
+                  double *__restrict s11)
+{
+    const double wd = w, hd = h;
+    for (std::size_t k = 0; k < m; k++)
+    {
+        const double sampleX = xs[k], sampleY = ys[k];
+        const double x = std::min(std::max(sampleX, -1.0), wd);
+        const double y = std::min(std::max(sampleY, -1.0), hd);
+        // Truncation of a positive value is the floor
+        const int32_t px = (int32_t)(x + 1) - 1;
+        const int32_t py = (int32_t)(y + 1) - 1;
+        const double fx = x - px, fy = y - py;
+        const double inX0 = px >= 0, inX1 = px + 1 < w, inY0 = py >= 0, inY1 = py + 1 < h;
+        // px is -1 at the left edge and w at the right one
+        const int32_t firstX = std::max(px, 0), firstY = std::max(py, 0);
+        cx0[k] = std::min(firstX, w - 1);
+        cx1[k] = std::min(px + 1, w - 1);
+        cy0[k] = std::min(firstY, h - 1);
+        cy1[k] = std::min(py + 1, h - 1);
+        s00[k] = qs[k] * (1 - fx) * (1 - fy) * inX0 * inY0;
+        s10[k] = qs[k] * fx * (1 - fy) * inX1 * inY0;
+        s01[k] = qs[k] * (1 - fx) * fy * inX0 * inY1;
+        s11[k] = qs[k] * fx * fy * inX1 * inY1;
+    }
+}
+} // namespace
+
+/**
+ * Constructs a CosmicRays object.
+ *
+ * @param _flux Hits per cm^2 per second
+ * @param _depth Thickness of the depleted silicon, in micron
+ * @param _electronsPerMicron Charge left by a particle along its path, in electrons per micron
+ * @param seed Seed for the random generator. 0 to seed from the clock
+ */
+CosmicRays::CosmicRays(double _flux, double _depth, double _electronsPerMicron, uint32_t seed)
+    : flux(_flux), depth(_depth), electronsPerMicron(_electronsPerMicron)
+{
+    if (seed == 0)
+    {
+        seed = std::chrono::system_clock::now().time_since_epoch().count();
+    }
+    generator.seed(seed);
+}
+
+CosmicRays::~CosmicRays()
+{
+#ifdef DEBUG_MEMORY
+    std::cout << "Destroyed CosmicRays " << std::endl;
+#endif
+}
+
+double CosmicRays::expectedHits(const Telescope &tel, double expT) const
+{
+    double area = (tel.FRAME_W * tel.PIXEL_SIZE * 1E-4) * (tel.FRAME_H * tel.PIXEL_SIZE * 1E-4); // cm^2
+    return flux * area * expT;
+}
+
+/**
+ * Adds the hits of one exposure to a frame.
+ *
+ * @param frame Frame, in ADUs
+ * @param tel Telescope. Frame size, pixel size and gain are used
+ * @param expT Exposure time, in seconds
+ * @return Number of hits
+ */
+uint32_t CosmicRays::addHits(Grid<uint32_t> &frame, const Telescope &tel, double expT)
+{
+    double expected = expectedHits(tel, expT);
+    if (expected <= 0)
+    {
+        return 0;
+    }
+
+    std::poisson_distribution<uint32_t> hits(expected);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    uint32_t n = hits(generator);
+
+    std::vector<double> x0(n), y0(n), x1(n), y1(n), charge(n);
+    for (uint32_t i = 0; i < n; i++)
+    {
+        double cosTheta = sqrt(std::max(uniform(generator), 1e-6));
+        double tanTheta = sqrt(1 - cosTheta * cosTheta) / cosTheta;
+        double azimuth = 2 * M_PI * uniform(generator);
+
+        // Projected length on the detector, in pixels, and charge along the whole path
+        double length = std::min(depth * tanTheta / tel.PIXEL_SIZE, (double)std::max(frame.width(), frame.height()));
+        double path = sqrt(pow(length * tel.PIXEL_SIZE, 2) + depth * depth);
+
+        x0[i] = uniform(generator) * frame.width() - 0.5;
+        y0[i] = uniform(generator) * frame.height() - 0.5;
+        x1[i] = x0[i] + length * cos(azimuth);
+        y1[i] = y0[i] + length * sin(azimuth);
+        charge[i] = path * electronsPerMicron / tel.GAIN;
+    }
+
+    drawTracks(n, x0.data(), y0.data(), x1.data(), y1.data(), charge.data(), frame);
+    return n;
+}
+
+/**
+ * Rasterises straight tracks on a frame. Parts of tracks outside the frame are lost.
+ *
+ * @param n Number of tracks
+ * @param x0, y0 Start of each track, in pixels
+ * @param x1, y1 End of each track, in pixels
+ * @param charge Total charge of each track, in ADUs
+ * @param frame Frame to add the tracks to
+ */
+void CosmicRays::drawTracks(std::size_t n, const double *x0, const double *y0, const double *x1, const double *y1, const double *charge, Grid<uint32_t> &frame)
+{
+    // Samples every half pixel along each track. Scratch arrays come from the thread arena, so repeated calls reuse
+    // the same memory.
+    Arena::Scope scratch;
+    std::vector<uint32_t, ArenaAllocator<uint32_t>> samples(n);
+    std::size_t m = 0;
+    for (std::size_t i = 0; i < n; i++)
+    {
+        double length = sqrt(pow(x1[i] - x0[i], 2) + pow(y1[i] - y0[i], 2));
+        samples[i] = (uint32_t)std::ceil(2 * length) + 1;
+        m += samples[i];
+    }
+    std::vector<double, ArenaAllocator<double>> sx(m), sy(m), sq(m);
+    for (std::size_t i = 0, start = 0; i < n; start += samples[i], i++)
+    {
+        const double dx = (samples[i] > 1) ? (x1[i] - x0[i]) / (samples[i] - 1) : 0;
+        const double dy = (samples[i] > 1) ? (y1[i] - y0[i]) / (samples[i] - 1) : 0;
+        const double q = charge[i] / samples[i];
+        for (uint32_t k = 0; k < samples[i]; k++)
+        {
+            sx[start + k] = x0[i] + k * dx;
+            sy[start + k] = y0[i] + k * dy;
+            sq[start + k] = q;
+        }
+    }
+
+    // Share each sample between the four nearest pixels. Pixel x covers x - 0.5 to x + 0.5.
+    const int32_t w = frame.width();
+    const int32_t h = frame.height();
+    if (w == 0 || h == 0)
+    {
+        return;
+    }
+    std::vector<int32_t, ArenaAllocator<int32_t>> left(m), right(m), top(m), bottom(m);
+    std::vector<double, ArenaAllocator<double>> topLeft(m), topRight(m), bottomLeft(m), bottomRight(m);
+    shareSamples(m, w, h, sx.data(), sy.data(), sq.data(), left.data(), right.data(), top.data(), bottom.data(), topLeft.data(),
+                 topRight.data(), bottomLeft.data(), bottomRight.data());
+
+    // Pixels of a sample can collide with those of the next ones, so the scatter stays scalar. Shares are never
+    // negative: adding a half and truncating rounds them, without a call to round().
+    for (std::size_t k = 0; k < m; k++)
+    {
+        frame[(std::size_t)top[k] * w + left[k]] += (uint32_t)(topLeft[k] + 0.5);
+        frame[(std::size_t)top[k] * w + right[k]] += (uint32_t)(topRight[k] + 0.5);
+        frame[(std::size_t)bottom[k] * w + left[k]] += (uint32_t)(bottomLeft[k] + 0.5);
+        frame[(std::size_t)bottom[k] * w + right[k]] += (uint32_t)(bottomRight[k] + 0.5);
+    }
+}
@@ -0,0 +1,41 @@
+/**
+ * Twinkle FGS-Sim: Centroid recovery simulation
+ *
+ * @file CosmicRays.hpp
+ * @brief Header file for CosmicRays class
+ * @author Claudio Arena
+ * @version 1.0.0 2026-10-18
+ */
+#pragma once
+
+#include <random>
+#include <vector>
+
+#include "typedefs.h"
+#include "Grid.hpp"
+#include "telescopes.h"
+
+/**
+ * Cosmic ray hits on the detector. Hits arrive as a Poisson process over the detector area, with isotropic directions.
+ * Each particle crosses the depleted silicon and leaves a straight track, whose projected length depends on the
+ * incidence angle, with a charge proportional to the path length. Steep hits give spots, shallow ones long streaks.
+ *
+ * @brief Class to inject cosmic ray hits in frames
+ */
+class CosmicRays
+{
+public:
+  CosmicRays(double _flux = 5.0, double _depth = 16.0, double _electronsPerMicron = 80.0, uint32_t seed = 0);
+  ~CosmicRays();
+
+  uint32_t addHits(Grid<uint32_t> &frame, const Telescope &tel, double expT);
+  double expectedHits(const Telescope &tel, double expT) const;
+
+  static void drawTracks(std::size_t n, const double *x0, const double *y0, const double *x1, const double *y1, const double *charge, Grid<uint32_t> &frame);
+
+private:
+  double flux;              // hits / cm^2 / s
+  double depth;             // depleted thickness, in micron
+  double electronsPerMicron; // charge left along the path
+  std::mt19937 generator;
+};
@@ -0,0 +1,54 @@
+/**
+ * Twinkle FGS-Sim: Centroid recovery simulation
+ *
+ * @file DetectorMTF.hpp
+ * @brief Header file for DetectorMTF class
+ * @author Claudio Arena
+ * @version 1.0.0 2026-10-18
+ */
+#pragma once
+
+#include <random>
+#include <vector>
+
+#include "typedefs.h"
+#include "Grid.hpp"
+
+/**
+ * Detector blurring of the expected image: charge diffusion between neighbouring pixels, or any pixel MTF given as a
+ * convolution kernel. Separable kernels run as two 1-D passes, wide ones through FFTs. Charge reaching past the edges
+ * of the frame is lost.
+ *
+ * @brief Class applying a detector MTF to frames
+ */
+class DetectorMTF
+{
+public:
+  // Gaussian charge diffusion, sigma in pixels
+  DetectorMTF(double diffusionSigma);
+  // Separable kernel, the same along x and y. Odd length, centred.
+  DetectorMTF(std::vector<double> _kernel);
+  // Non separable kernel. Odd sizes, centred.
+  DetectorMTF(const Grid<double> &_kernel2d);
+  ~DetectorMTF();
+
+  void apply(Grid<uint32_t> &frame, std::mt19937 &generator) const;
+  void convolve(std::vector<float> &image, uint32_t width, uint32_t height) const;
+
+  bool isSeparable() const { return kernel2d.empty(); }
+  uint32_t radius() const { return isSeparable() ? kernel.size() / 2 : std::max(kernelW, kernelH) / 2; }
+
+  // Kernel radius from which convolutions go through FFTs
+  static constexpr uint32_t FFT_RADIUS = 24;
+
+private:
+  std::vector<float> kernel;   // separable kernel
+  std::vector<float> kernel2d; // row major, kernelW x kernelH
+  uint32_t kernelW = 0, kernelH = 0;
+
+  void convolveRows(std::vector<float> &image, uint32_t width, uint32_t height) const;
+  void convolveColumns(std::vector<float> &image, uint32_t width, uint32_t height) const;
+  void convolveFFT1d(std::vector<float> &image, uint32_t width, uint32_t height, bool columns) const;
+  void convolve2d(std::vector<float> &image, uint32_t width, uint32_t height) const;
+  void convolveFFT2d(std::vector<float> &image, uint32_t width, uint32_t height) const;
+};
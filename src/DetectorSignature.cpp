@@ -0,0 +1,122 @@
+/**
+ * Twinkle FGS-Sim: Centroid recovery simulation
+ *
+ * @file DetectorSignature.cpp
+ * @brief Fixed pattern maps of a detector
+ * @author Claudio Arena
+ * @version 1.0.0 2026-10-18
+ * @description File layout: magic, width and height as uint32, then the gain map, the dark factor map (both uint16,
+ * row major) and the column bias (int16). Values are stored in the byte order of the machine writing the file.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+
+#include "DetectorSignature.hpp"
+
+namespace
+{
+const char SIGNATURE_MAGIC[8] = {'F', 'G', 'S', 'S', 'I', 'G', '0', '2'};
+
+uint16_t toFixed(double value, double scale)
+{
+    return (uint16_t)std::min(std::max(std::round(value / scale), 0.0), 65535.0);
+}
+} // namespace
+
+/**
+ * Generates the maps of a detector.
+ *
+ * @param _width Width of the detector, in pixels
+ * @param _height Height of the detector, in pixels
+ * @param parameters Statistics of the fixed pattern
+ * @param seed Seed of the detector. The same seed gives the same detector.
+ */
+DetectorSignature::DetectorSignature(uint32_t _width, uint32_t _height, signature_parameters parameters, uint32_t seed)
+    : w(_width), h(_height), gainMap((std::size_t)_width * _height), darkMap((std::size_t)_width * _height), biasMap(_width)
+{
+    std::mt19937 generator(seed);
+    std::normal_distribution<double> normal(0.0, 1.0);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+    for (std::size_t i = 0; i < gainMap.size(); i++)
+    {
+        gainMap[i] = toFixed(1 + parameters.prnu * normal(generator), GAIN_SCALE);
+        double dark = (uniform(generator) < parameters.hotFraction) ? parameters.hotDarkFactor : 1 + parameters.dsnu * normal(generator);
+        darkMap[i] = toFixed(dark, DARK_SCALE);
+    }
+
+    for (uint32_t x = 0; x < w; x++)
+    {
+        biasMap[x] = (int16_t)std::round(parameters.columnBiasRMS * normal(generator));
+    }
+
+    std::uniform_int_distribution<uint32_t> column(0, w - 1);
+    for (uint16_t c = 0; c < parameters.deadColumns; c++)
+    {
+        uint32_t x = column(generator);
+        for (uint32_t y = 0; y < h; y++)
+        {
+            gainMap[(std::size_t)y * w + x] = 0;
+            darkMap[(std::size_t)y * w + x] = 0;
+        }
+    }
+}
+
+/**
+ * Loads the maps of a detector saved with save.
+ */
+DetectorSignature::DetectorSignature(std::string filename)
+{
+    std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary);
+    if (file.fail())
+    {
+        throw "Error! Could not open detector signature file";
+    }
+
+    char magic[8];
+    file.read(magic, sizeof(magic));
+    file.read((char *)&w, sizeof(w));
+    file.read((char *)&h, sizeof(h));
+    if (!file || memcmp(magic, SIGNATURE_MAGIC, sizeof(SIGNATURE_MAGIC)) != 0)
+    {
+        throw "Error! Not a detector signature file";
+    }
+
+    gainMap.resize((std::size_t)w * h);
+    darkMap.resize((std::size_t)w * h);
+    biasMap.resize(w);
+    file.read((char *)gainMap.data(), gainMap.size() * sizeof(uint16_t));
+    file.read((char *)darkMap.data(), darkMap.size() * sizeof(uint16_t));
+    file.read((char *)biasMap.data(), biasMap.size() * sizeof(int16_t));
+    if (!file)
+    {
+        throw "Error! Detector signature file is truncated";
+    }
+}
+
+DetectorSignature::~DetectorSignature()
+{
+#ifdef DEBUG_MEMORY
+    std::cout << "Destroyed DetectorSignature " << std::endl;
+#endif
+}
+
+void DetectorSignature::save(std::string filename) const
+{
+    std::ofstream file(filename.c_str(), std::ios::out | std::ios::binary);
+    if (file.fail())
+    {
+        throw "Error! Could not write detector signature file";
+    }
+    file.write(SIGNATURE_MAGIC, sizeof(SIGNATURE_MAGIC));
+    file.write((const char *)&w, sizeof(w));
+    file.write((const char *)&h, sizeof(h));
+    file.write((const char *)gainMap.data(), gainMap.size() * sizeof(uint16_t));
+    file.write((const char *)darkMap.data(), darkMap.size() * sizeof(uint16_t));
+    file.write((const char *)biasMap.data(), biasMap.size() * sizeof(int16_t));
+}
@@ -0,0 +1,63 @@
+/**
+ * Twinkle FGS-Sim: Centroid recovery simulation
+ *
+ * @file DetectorSignature.hpp
+ * @brief Header file for DetectorSignature class
+ * @author Claudio Arena
+ * @version 1.0.0 2026-10-18
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "typedefs.h"
+
+// Statistics of the fixed pattern of a detector
+struct signature_parameters
+{
+  double prnu = 0.01;         // pixel response non uniformity, relative rms
+  double dsnu = 0.1;          // dark signal non uniformity, relative rms
+  double hotFraction = 1E-4;  // fraction of hot pixels
+  double hotDarkFactor = 50;  // dark current of hot pixels over the mean
+  uint16_t deadColumns = 0;   // number of dead columns
+  double columnBiasRMS = 1.0; // rms of the per column bias offset, in ADUs
+};
+
+/**
+ * Fixed pattern of a detector: per pixel gain (PRNU, dead columns), per pixel dark current (DSNU, hot pixels) and per
+ * column bias. Made once per detector from a seed, or loaded from disk, and applied by Frame in the detector noise pass.
+ * Maps are stored as 16 bit fixed point values: gain with 15 fractional bits, dark factor with 8, and column bias in ADUs,
+ * i.e. 4 bytes per pixel.
+ *
+ * @brief Class holding the fixed pattern maps of a detector
+ */
+class DetectorSignature
+{
+public:
+  DetectorSignature(uint32_t _width, uint32_t _height, signature_parameters parameters = signature_parameters(), uint32_t seed = 1);
+  DetectorSignature(std::string filename);
+  ~DetectorSignature();
+
+  void save(std::string filename) const;
+
+  uint32_t width() const { return w; }
+  uint32_t height() const { return h; }
+
+  float gain(std::size_t pixel) const { return gainMap[pixel] * GAIN_SCALE; }
+  float darkFactor(std::size_t pixel) const { return darkMap[pixel] * DARK_SCALE; }
+  int16_t columnBias(uint32_t x) const { return biasMap[x]; }
+
+  const uint16_t *gains() const { return gainMap.data(); }
+  const uint16_t *darkFactors() const { return darkMap.data(); }
+  const int16_t *columnBiases() const { return biasMap.data(); }
+
+  static constexpr float GAIN_SCALE = 1.0f / 32768;
+  static constexpr float DARK_SCALE = 1.0f / 256;
+
+private:
+  uint32_t w, h;
+  std::vector<uint16_t> gainMap; // gain * 2^15
+  std::vector<uint16_t> darkMap; // dark factor * 2^8
+  std::vector<int16_t> biasMap;  // per column, in ADUs
+};
@@ -0,0 +1,36 @@
+/**
+ * Twinkle FGS-Sim: Centroid recovery simulation
+ *
+ * @file EMCCD.hpp
+ * @brief Header file for EMCCD class
+ * @author Claudio Arena
+ * @version 1.0.0 2026-10-18
+ */
+#pragma once
+
+#include <random>
+
+#include "typedefs.h"
+
+/**
+ * Electron multiplying readout. The multiplication register turns n input electrons into a gamma (Erlang) distributed
+ * number of output electrons, with mean n g and variance n g^2, so the read noise becomes negligible at high gain at the
+ * cost of an excess noise factor of sqrt(2). Clock induced charge adds spurious electrons before the register.
+ *
+ * @brief Class modelling an EMCCD multiplication register
+ */
+class EMCCD
+{
+public:
+  EMCCD(double _gain = 1000, double _cic = 0.005);
+  ~EMCCD();
+
+  double gain() const { return emGain; }
+  double cic() const { return clockInducedCharge; }
+
+  void multiply(const uint32_t *electrons, double *out, std::size_t n, std::mt19937 &generator) const;
+
+private:
+  double emGain;             // mean multiplication
+  double clockInducedCharge; // e- / pixel / frame
+};
@@ -0,0 +1,74 @@
+/**
+ * Twinkle FGS-Sim: Centroid recovery simulation
+ *
+ * @file EventList.cpp
+ * @brief Sparse frame made of detection events
+ * @author Claudio Arena
+ * @version 1.0.0 2026-10-18
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "EventList.hpp"
+
+/**
+ * Sets the background description
+ *
+ * @param level Uniform level, e.g. bias and dark, in ADUs per pixel
+ * @param map Optional expected background map, in ADUs. Shared, not copied
+ */
+void EventList::setBackground(double level, std::shared_ptr<const Grid<double>> map)
+{
+    backgroundLevel = level;
+    backgroundMap = map;
+    backgroundMapMean = 0;
+    if (backgroundMap && backgroundMap->size() > 0)
+    {
+        backgroundMapMean = backgroundMap->total() / backgroundMap->size();
+    }
+}
+
+/**
+ * Collapses pixel indices of single detections into (pixel, count) events.
+ *
+ * @param pixels Pixel index of each detection. Sorted in place
+ */
+void EventList::build(std::vector<uint64_t> &pixels)
+{
+    std::sort(pixels.begin(), pixels.end());
+    events.clear();
+    for (std::size_t i = 0; i < pixels.size();)
+    {
+        std::size_t j = i;
+        while (j < pixels.size() && pixels[j] == pixels[i])
+        {
+            j++;
+        }
+        events.push_back({pixels[i], (uint32_t)(j - i)});
+        i = j;
+    }
+}
+
+/**
+ * Dense frame with the events added to the rounded expected background. Mostly for checks and output.
+ */
+Grid<uint32_t> EventList::densify() const
+{
+    Grid<uint32_t> grid(w, h);
+    for (std::size_t i = 0; i < grid.size(); i++)
+    {
+        grid[i] = (uint32_t)std::round(background(i));
+    }
+    for (const pixel_event &event : events)
+    {
+        grid[event.pixel] += event.count;
+    }
+    grid.extraPixel() = outside;
+    return grid;
+}
+
+std::size_t EventList::bytes() const
+{
+    return sizeof(EventList) + events.capacity() * sizeof(pixel_event) + photons.capacity() * sizeof(photon_event);
+}
@@ -0,0 +1,66 @@
+/**
+ * Twinkle FGS-Sim: Centroid recovery simulation
+ *
+ * @file EventList.hpp
+ * @brief Header file for EventList class
+ * @author Claudio Arena
+ * @version 1.0.0 2026-10-18
+ */
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "typedefs.h"
+#include "Grid.hpp"
+
+// Detections in one pixel. Pixel index is y * width + x, in 64 bits as frames can pass 2^32 pixels.
+struct pixel_event
+{
+  uint64_t pixel;
+  uint32_t count;
+};
+
+// A single time tagged detection. The pixel comes first, so the event packs in 16 bytes.
+struct photon_event
+{
+  uint64_t pixel;
+  float time;      // seconds from the start of the frame
+  uint32_t source; // index of the source in the frame
+};
+
+/**
+ * Sparse frame: source detections as a list of (pixel, count), sorted by pixel, plus a compact description of the
+ * background, which is not sampled. Optionally keeps every detection with its arrival time.
+ * Pixels without events hold the background only.
+ *
+ * @brief Class holding a sparse frame
+ */
+class EventList
+{
+public:
+  EventList(uint32_t _width = 0, uint32_t _height = 0) : w(_width), h(_height) {}
+
+  uint32_t width() const { return w; }
+  uint32_t height() const { return h; }
+
+  // Expected background in a pixel: uniform level plus the optional background map, in ADUs
+  double background(uint64_t pixel) const { return backgroundLevel + (backgroundMap ? (*backgroundMap)[pixel] : 0.0); }
+  double background() const { return backgroundLevel + backgroundMapMean; }
+  void setBackground(double level, std::shared_ptr<const Grid<double>> map = nullptr);
+
+  // Collapses the raw pixel indices into sorted (pixel, count) events
+  void build(std::vector<uint64_t> &pixels);
+
+  Grid<uint32_t> densify() const;
+  std::size_t bytes() const;
+
+  std::vector<pixel_event> events;
+  std::vector<photon_event> photons; // filled for time tagged lists only
+  uint64_t outside = 0;               // detections falling outside the frame
+
+private:
+  uint32_t w, h;
+  double backgroundLevel = 0, backgroundMapMean = 0;
+  std::shared_ptr<const Grid<double>> backgroundMap;
+};
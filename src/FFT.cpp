@@ -0,0 +1,131 @@
+/**
+ * Twinkle FGS-Sim: FFT namespace.
+ * Radix-2 fast Fourier transforms, used for phase screens, jitter synthesis and wide convolutions
+ *
+ * @file FFT.cpp
+ * @brief Iterative radix-2 Cooley-Tukey FFT
+ * @author Claudio Arena
+ * @version 1.0.0 2026-10-18
+ */
+#include <algorithm>
+#include <cmath>
+
+#include "FFT.hpp"
+
+namespace fft
+{
+/**
+ * function returning the smallest power of two not smaller than n
+ */
+uint32_t nextPowerOfTwo(uint32_t n)
+{
+    uint32_t p = 1;
+    while (p < n)
+    {
+        p <<= 1;
+    }
+    return p;
+}
+
+bool isPowerOfTwo(uint32_t n)
+{
+    return n > 0 && (n & (n - 1)) == 0;
+}
+
+/**
+ * In place FFT of a 1D array.
+ *
+ * @brief 1D FFT
+ * @param data Array to transform. Size must be a power of two
+ * @param inverse True for the inverse transform, normalised by 1/N
+ */
+void transform(std::vector<complex> &data, bool inverse)
+{
+    const std::size_t n = data.size();
+    if (!isPowerOfTwo(n))
+    {
+        throw "Error! FFT size must be a power of two";
+    }
+
+    // Bit reversal permutation
+    for (std::size_t i = 1, j = 0; i < n; i++)
+    {
+        std::size_t bit = n >> 1;
+        for (; j & bit; bit >>= 1)
+        {
+            j ^= bit;
+        }
+        j ^= bit;
+        if (i < j)
+        {
+            std::swap(data[i], data[j]);
+        }
+    }
+
+    for (std::size_t len = 2; len <= n; len <<= 1)
+    {
+        double angle = 2 * M_PI / len * (inverse ? 1 : -1);
+        complex wlen(cos(angle), sin(angle));
+        for (std::size_t i = 0; i < n; i += len)
+        {
+            complex w(1);
+            for (std::size_t j = 0; j < len / 2; j++)
+            {
+                complex u = data[i + j];
+                complex v = data[i + j + len / 2] * w;
+                data[i + j] = u + v;
+                data[i + j + len / 2] = u - v;
+                w *= wlen;
+            }
+        }
+    }
+
+    if (inverse)
+    {
+        for (complex &c : data)
+        {
+            c /= (double)n;
+        }
+    }
+}
+
+/**
+ * In place FFT of a 2D array stored row by row.
+ *
+ * @brief 2D FFT
+ * @param data Array to transform, width * height elements
+ * @param width Number of columns. Must be a power of two
+ * @param height Number of rows. Must be a power of two
+ * @param inverse True for the inverse transform, normalised by 1/(width * height)
+ */
+void transform2d(std::vector<complex> &data, uint32_t width, uint32_t height, bool inverse)
+{
+    if (data.size() != (std::size_t)width * height)
+    {
+        throw "Error! FFT data size doesn't match width and height";
+    }
+
+    std::vector<complex> line(width);
+    for (uint32_t y = 0; y < height; y++)
+    {
+        std::copy(data.begin() + (std::size_t)y * width, data.begin() + (std::size_t)(y + 1) * width, line.begin());
+        transform(line, inverse);
+        std::copy(line.begin(), line.end(), data.begin() + (std::size_t)y * width);
+    }
+
+    line.resize(height);
+    for (uint32_t x = 0; x < width; x++)
+    {
+        for (uint32_t y = 0; y < height; y++)
+        {
+            line[y] = data[(std::size_t)y * width + x];
+        }
+        transform(line, inverse);
+        for (uint32_t y = 0; y < height; y++)
+        {
+            data[(std::size_t)y * width + x] = line[y];
+        }
+    }
+}
+
+} // namespace fft
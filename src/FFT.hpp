@@ -0,0 +1,29 @@
+/**
+ * Twinkle FGS-Sim: FFT namespace.
+ * Radix-2 fast Fourier transforms, used for phase screens, jitter synthesis and wide convolutions
+ *
+ * @file FFT.hpp
+ * @brief Header file for FFT namespace
+ * @author Claudio Arena
+ * @version 1.0.0 2026-10-18
+ */
+
+#pragma once
+#include <complex>
+#include <vector>
+
+#include "typedefs.h"
+
+namespace fft
+{
+
+typedef std::complex<double> complex;
+
+uint32_t nextPowerOfTwo(uint32_t n);
+bool isPowerOfTwo(uint32_t n);
+
+// In place transforms. Sizes must be powers of two. Inverse transforms are normalised by 1/N.
+void transform(std::vector<complex> &data, bool inverse = false);
+void transform2d(std::vector<complex> &data, uint32_t width, uint32_t height, bool inverse = false);
+
+} // namespace fft
@@ -23,6 +23,9 @@
 #include <random>
 #include <chrono>
 #include <vector>
+#include <algorithm>
+#include <limits>
+#include <type_traits>
 
 #include "Frame.hpp"
 #include "Test.hpp"
@@ -33,6 +36,17 @@
 //#define PRINT_SOURCE_DATA
 //#define TIMING
 
+// Distribution of detections over the cells of a probability matrix, then its extra pixel for detections outside it.
+// The weights are read straight from the grid: the distribution calls the weight function at k + 0.5 for cell k.
+static std::discrete_distribution<uint32_t> detectionDistribution(const ArenaGrid<double> &probMatrix)
+{
+    const std::size_t n = probMatrix.size();
+    return std::discrete_distribution<uint32_t>(n + 1, 0.0, n + 1.0, [&probMatrix, n](double x) {
+        const std::size_t k = (std::size_t)x;
+        return (k < n) ? probMatrix[k] : probMatrix.extraPixel();
+    });
+}
+
 /**
  * Constructs a Frame object to generate image data arrays.
  *
@@ -46,7 +60,7 @@
 Frame::Frame(Telescope _tel, double _expTime, Grid<uint32_t> _grid)
     : tel(_tel), t(_expTime), h(_tel.FRAME_H), w(_tel.FRAME_W), hsim(h * _tel.SIMELS), wsim(w * _tel.SIMELS)
 {
-    if (_grid.size() == 0)
+    if (_grid.width() == w && _grid.height() == h)
     {
         fr = _grid;
     }
@@ -55,13 +69,12 @@ Frame::Frame(Telescope _tel, double _expTime, Grid<uint32_t> _grid)
         fr.resize(w, h);
     }
 
-    simfr.resize(wsim, hsim);
     sources.reserve(10);
 
     // Seec and initialise the distributions
     // TODO: temp dep on dark noise
     // TODO: check model of dakrk and bias noise
-    dark_generator.seed(std::chrono::system_clock::now().time_since_epoch().count());
+    noise_generator.seed(std::chrono::system_clock::now().time_since_epoch().count());
     darkCounts = std::poisson_distribution<ulong_t>(pow(((tel.DARK_NOISE / tel.GAIN) * t), 2));
     readnoise_generator.seed(std::chrono::system_clock::now().time_since_epoch().count());
     readnoiseCounts = std::normal_distribution<double>((tel.OFFSET / tel.GAIN), (tel.READOUT_NOISE / tel.GAIN));
@@ -79,11 +92,11 @@ Frame::~Frame()
 #endif
 }
 
-uint32_t &Frame::operator()(uint16_t x, uint16_t y)
+uint32_t &Frame::operator()(uint32_t x, uint32_t y)
 {
     return fr(x, y);
 }
-const uint32_t &Frame::operator()(uint16_t x, uint16_t y) const
+const uint32_t &Frame::operator()(uint32_t x, uint32_t y) const
 {
     return fr(x, y);
 }
@@ -117,24 +130,28 @@ void Frame::addSource(double cx, double cy, double fwhm_x, double fwhm_y, double
  */
 void Frame::addSource(double cx, double cy, double fwhm_x, double fwhm_y, std::vector<double> mags)
 {
+    if (chromaticPSF)
+    {
+        mags = checkMags(mags);
+        addSource(cx, cy, chromaticPSF->broadbandStamp(mags, fwhm_x, fwhm_y), mags);
+        sources.back().fwhm_x = fwhm_x;
+        sources.back().fwhm_y = fwhm_y;
+        return;
+    }
+
     // add a source to the list of sources. Make a temporary prob matrix.
     sources.emplace_back();
 
-    source *src = &sources[nsources() - 1];
-    Grid<double> tempProbMatrix(wsim, hsim);
-    Grid<double> *probMatrix = &tempProbMatrix;
+    source *src = &sources.back();
+    // Scratch matrices come from the thread arena and are released together on return
+    Arena::Scope scratch;
+    ArenaGrid<double> probMatrix(1, 1);
 
 #ifdef PRINT_SOURCE_DATA
-    printf("size of source array: %u \n", nsources());
+    printf("size of source array: %zu \n", nsources());
 #endif
 
-    if (tel.FGS_filter.size() != mags.size())
-    {
-        printf("Numbers of supplied mags doesn't match number of telescope filters!!");
-        double refMag = mags.at(0);
-        mags.resize(tel.FGS_filter.size());
-        std::fill(mags.begin(), mags.end(), refMag);
-    }
+    mags = checkMags(mags);
 
     src->expected_ADUs = astroUtilities::meanReceivedADUs(mags, (tel.FGS_filter), t, tel);
     // src->expected_photons = astroUtilities::meanReceivedPhotons(mags, (tel.FGS_filter), t, tel);
@@ -145,8 +162,8 @@ void Frame::addSource(double cx, double cy, double fwhm_x, double fwhm_y, std::v
     src->fwhm_y = fwhm_y;
 
 #ifdef PRINT_SOURCE_DATA
-    printf("Average n. of detections (ADUs / Photons) for source %d: %3.4f\n", nsources() - 1, src->expected_ADUs);
-    // printf("Average n. of detections (ADUs / Photons) for source %d: %3.4f\n", nsources() - 1, src->expected_photons);
+    printf("Average n. of detections (ADUs / Photons) for source %zu: %3.4f\n", nsources() - 1, src->expected_ADUs);
+    // printf("Average n. of detections (ADUs / Photons) for source %zu: %3.4f\n", nsources() - 1, src->expected_photons);
 
 #endif
 
@@ -159,20 +176,39 @@ void Frame::addSource(double cx, double cy, double fwhm_x, double fwhm_y, std::v
     // x.0 is center of pixel. x.5 is edge
     double simcx = cx * tel.SIMELS + (tel.SIMELS / 2.0) - 0.5;
     double simcy = cy * tel.SIMELS + (tel.SIMELS / 2.0) - 0.5;
-    calculateGaussian(simcx, simcy, sigmax, sigmay, probMatrix);
+
+    // Sampled on the simels within GAUSSIAN_EXTENT sigmas only, so a source costs its footprint and not the frame
+    int64_t minX = std::max<int64_t>(0, (int64_t)std::floor(simcx - GAUSSIAN_EXTENT * sigmax));
+    int64_t minY = std::max<int64_t>(0, (int64_t)std::floor(simcy - GAUSSIAN_EXTENT * sigmay));
+    int64_t maxX = std::min<int64_t>((int64_t)wsim - 1, (int64_t)std::ceil(simcx + GAUSSIAN_EXTENT * sigmax));
+    int64_t maxY = std::min<int64_t>((int64_t)hsim - 1, (int64_t)std::ceil(simcy + GAUSSIAN_EXTENT * sigmay));
+    if (maxX >= minX && maxY >= minY)
+    {
+        probMatrix.resize(maxX - minX + 1, maxY - minY + 1);
+        calculateGaussian(simcx - minX, simcy - minY, sigmax, sigmay, &probMatrix);
+        applyPixelResponse(probMatrix, minX, minY);
+    }
+    else
+    {
+        minX = 0;
+        minY = 0;
+    }
+    src->footprintX = minX;
+    src->footprintY = minY;
+    src->footprintW = probMatrix.width();
+    src->footprintH = probMatrix.height();
 #endif
 
 #ifdef PRINT_PROB_ARRAY
-    PrintProbArray(probMatrix, "source");
+    PrintProbArray(&probMatrix, "source");
 #endif
 
     // add a value outside the array to the distribution func. This takes cares of photons falling outside the array.
-    double prob_ADUs_outside_frame = 100 - probMatrix->total();
-    probMatrix->operator[](probMatrix->extraPixPos()) += prob_ADUs_outside_frame;
+    double prob_ADUs_outside_frame = 100 - probMatrix.total();
+    probMatrix.extraPixel() += std::max(prob_ADUs_outside_frame, 0.0);
 
     // Now assign it the vector to a distribution, and inizialize the distribution
-    std::discrete_distribution<uint32_t> distribution(probMatrix->begin(), probMatrix->end());
-    src->source_distribution = distribution;
+    src->source_distribution = detectionDistribution(probMatrix);
 
     // Seec and initialise the distributions. One for total number of photons in frame, one for distribution of photons on frame.
     // src->photon_n_generator.seed(std::chrono::system_clock::now().time_since_epoch().count());
@@ -180,23 +216,182 @@ void Frame::addSource(double cx, double cy, double fwhm_x, double fwhm_y, std::v
     src->distribution_generator.seed(std::chrono::system_clock::now().time_since_epoch().count());
 }
 
+/**
+ * Add source to a Frame object, rendered from a PSF stamp. The stamp is sampled on the simels around the source only.
+ *
+ * @param cx X-coordinate for source centre
+ * @param cy Y-coordinate for source centre
+ * @param stamp normalised PSF stamp, as built by PolychromaticPSF
+ * @param mags array with target magnitudes. Make sure to have matching magnitudes with your telescope filter set.
+ */
+void Frame::addSource(double cx, double cy, std::shared_ptr<const PSFStamp> stamp, std::vector<double> mags)
+{
+    sources.emplace_back();
+    source *src = &sources.back();
+
+    mags = checkMags(mags);
+    src->expected_ADUs = astroUtilities::meanReceivedADUs(mags, (tel.FGS_filter), t, tel);
+    src->cx = cx;
+    src->cy = cy;
+    src->fwhm_x = 0;
+    src->fwhm_y = 0;
+
+    // x.0 is center of pixel. x.5 is edge
+    double simcx = cx * tel.SIMELS + (tel.SIMELS / 2.0) - 0.5;
+    double simcy = cy * tel.SIMELS + (tel.SIMELS / 2.0) - 0.5;
+    calculateStamp(simcx, simcy, *stamp, *src);
+
+    src->distribution_generator.seed(std::chrono::system_clock::now().time_since_epoch().count());
+}
+
+/**
+ * Add the stars of a scene to the frame. Stars whose PSF footprint misses the frame, or all the regions of interest, are skipped.
+ *
+ * @param scene Scene, in the pixel coordinates of this frame
+ * @param rois Regions of interest, in pixels. Empty for the whole frame
+ * @return Number of sources added
+ */
+uint32_t Frame::addScene(const Scene &scene, const std::vector<pixel_window> &rois)
+{
+    std::vector<uint32_t> ids = scene.visible(rois);
+    sources.reserve(sources.size() + ids.size());
+
+    const double *x = scene.x();
+    const double *y = scene.y();
+    for (uint32_t id : ids)
+    {
+        addSource(x[id], y[id], scene.psf(scene.psfId(id)), scene.starMags(id));
+    }
+    return ids.size();
+}
+
+void Frame::setLightCurve(std::shared_ptr<const LightCurve> curve, int32_t sourceIndex)
+{
+    if (sourceIndex < 0)
+    {
+        sourceIndex = (int32_t)nsources() - 1;
+    }
+    if (sourceIndex < 0 || (std::size_t)sourceIndex >= nsources())
+    {
+        throw "Error! Light curve set on a source that doesn't exist";
+    }
+    sources[sourceIndex].lightCurve = curve;
+}
+
+// Expected detections of a source, with its light curve evaluated at the given time
+double Frame::sourceFlux(const source &src, double time) const
+{
+    double flux = src.expected_ADUs * transmission;
+    if (src.lightCurve)
+    {
+        flux *= std::max(src.lightCurve->flux(time), 0.0);
+    }
+    return flux;
+}
+
+std::vector<double> Frame::checkMags(std::vector<double> mags)
+{
+    if (tel.FGS_filter.size() != mags.size())
+    {
+        printf("Numbers of supplied mags doesn't match number of telescope filters!!");
+        double refMag = mags.at(0);
+        mags.resize(tel.FGS_filter.size());
+        std::fill(mags.begin(), mags.end(), refMag);
+    }
+    return mags;
+}
+
 void Frame::generateFrame(bool statistical)
 {
-    for (uint16_t isrc = 0; isrc < nsources(); isrc++)
+    // Each call is a new exposure of the same sources. Binned frames leave a smaller grid behind.
+    if (fr.width() != w || fr.height() != h)
     {
-        source src = sources[isrc];
-        addSourceDetections(src);
+        fr.resize(w, h);
     }
+    fr.reset();
+    saturated = false;
+
+    if (lineTime > 0)
+    {
+        for (source &src : sources)
+        {
+            addRollingShutterDetections(src);
+        }
+    }
+    else if (jitter)
+    {
+        // Same slice offsets for all sources, converted from arcsec to simels
+        std::vector<pixel_coordinates> offsets(slices);
+        jitter->meanOffsets(startTime, t / slices, slices, offsets.data());
+        const double simelsPerArcsec = tel.SIMELS / astroUtilities::plateScale(tel);
+
+        const double sliceT = t / slices;
+        for (source &src : sources)
+        {
+            // Running total, so rounding doesn't lose detections
+            double expected = 0;
+            ulong_t detected = 0;
+            for (uint16_t k = 0; k < slices; k++)
+            {
+                expected += sourceFlux(src, startTime + (k + 0.5) * sliceT) / slices;
+                ulong_t sliceDetections = (ulong_t)expected - detected;
+                addSourceDetections(src, sliceDetections, offsets[k].x * simelsPerArcsec, offsets[k].y * simelsPerArcsec);
+                detected += sliceDetections;
+            }
+        }
+    }
+    else
+    {
+        for (source &src : sources)
+        {
+            addSourceDetections(src, sourceFlux(src, startTime + t / 2));
+        }
+    }
+    startTime += t;
 
     // Transform the simel to the actual frame
     simelsToFrame(statistical);
+    if (detectorMTF)
+    {
+        detectorMTF->apply(fr, noise_generator);
+    }
+
+    // Background map is cached by the Background object, so this is only a lookup unless exposure or pointing changed
+    std::shared_ptr<const Grid<double>> backgroundMap;
+    if (background)
+    {
+        backgroundMap = background->map(tel, t, pointing);
+        if (backgroundMap->width() != w || backgroundMap->height() != h)
+        {
+            printf("Warning! Background map doesn't match the frame size, and is not used \n");
+            backgroundMap.reset();
+        }
+    }
+
     if (statistical == true)
     {
-        addShotNoise();
-        addBiasNoise();
-        addDarkNoise();
+        if (cosmicRays)
+        {
+            cosmicRays->addHits(fr, tel, t);
+        }
+        addDetectorNoise(backgroundMap.get());
         // addPedestal(10);
     }
+    else
+    {
+        if (backgroundMap)
+        {
+            addBackground(backgroundMap.get());
+        }
+        if (binning > 1)
+        {
+            binFrame();
+        }
+        if (adc)
+        {
+            adc->convert(&fr[0], &fr[0], fr.size());
+        }
+    }
 
     if (saturated)
     {
@@ -205,59 +400,289 @@ void Frame::generateFrame(bool statistical)
 
 #ifdef DEBUG
     uint64_t tot_photons = std::accumulate(fr.begin(), fr.end(), 0.0);
-    uint64_t outside_photons = fr[fr.extraPixPos()];
-    printf("Total photons in frame array: %d \n", tot_photons - outside_photons);
+    uint64_t outside_photons = fr.extraPixel();
+    printf("Total photons in frame array: %d \n", tot_photons);
     printf("Total photons outside frame: %d\n", outside_photons);
     printf("Saturated: %s\n", (isSaturated() ? "Yes" : "No"));
 #endif
 
-    // remove Saturation above bit limit
-    for (int i = 0; i < h; i++)
+    // remove Saturation above bit limit. The ADC clips at its own full scale.
+    if (!adc)
+    {
+        for (uint32_t i = 0; i < fr.height(); i++)
+        {
+            for (uint32_t j = 0; j < fr.width(); j++)
+            {
+                if (fr(j, i) > tel.FGS_MAX_ADU)
+                {
+                    fr(j, i) = tel.FGS_MAX_ADU;
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Generates the next frame as a sparse event list, straight from the photon sampler. No dense grid is touched.
+ * Detections of each source are Poisson distributed around the expected value. The background (bias, dark and background map)
+ * is described by its expected level, and not sampled. Saturation is not modelled, so this is meant for faint, sparse scenes.
+ *
+ * @param timeTagged Also keep every detection with its arrival time
+ * @return Event list of the frame
+ */
+EventList Frame::generateEvents(bool timeTagged)
+{
+    EventList list(w, h);
+    std::vector<uint64_t> pixels;
+
+    std::vector<pixel_coordinates> offsets(slices, pixel_coordinates{0, 0});
+    double simelsPerArcsec = 0;
+    if (jitter)
+    {
+        jitter->meanOffsets(startTime, t / slices, slices, offsets.data());
+        simelsPerArcsec = tel.SIMELS / astroUtilities::plateScale(tel);
+    }
+
+    const double sliceT = t / slices;
+    std::uniform_real_distribution<double> arrival(0.0, 1.0);
+    for (uint32_t isrc = 0; isrc < nsources(); isrc++)
+    {
+        source &src = sources[isrc];
+        for (uint16_t k = 0; k < slices; k++)
+        {
+            double expected = sourceFlux(src, startTime + (k + 0.5) * sliceT) / slices;
+            if (expected <= 0)
+            {
+                continue;
+            }
+            std::poisson_distribution<ulong_t> detections(expected);
+            forEachDetection(
+                src, detections(src.distribution_generator), offsets[k].x * simelsPerArcsec, offsets[k].y * simelsPerArcsec,
+                [&](uint32_t x, uint32_t y) {
+                    const uint64_t pixel = (uint64_t)(y / tel.SIMELS) * w + (x / tel.SIMELS);
+                    pixels.push_back(pixel);
+                    if (timeTagged)
+                    {
+                        list.photons.push_back({pixel, (float)((k + arrival(src.distribution_generator)) * sliceT), isrc});
+                    }
+                },
+                [&]() { list.outside++; });
+        }
+    }
+
+    list.build(pixels);
+    if (timeTagged)
+    {
+        std::sort(list.photons.begin(), list.photons.end(), [](const photon_event &a, const photon_event &b) { return a.time < b.time; });
+    }
+
+    std::shared_ptr<const Grid<double>> backgroundMap;
+    if (background)
+    {
+        backgroundMap = background->map(tel, t, pointing);
+        if (backgroundMap->width() != w || backgroundMap->height() != h)
+        {
+            printf("Warning! Background map doesn't match the frame size, and is not used \n");
+            backgroundMap.reset();
+        }
+    }
+    list.setBackground(readnoiseCounts.mean() + darkCounts.mean(), backgroundMap);
+
+    startTime += t;
+    return list;
+}
+
+/**
+ * Detector noise in a single pass over the frame, one row at a time: shot noise on the detected ADUs, background map and
+ * dark current together, as their sum is Poisson too, then parallel CTI, on-chip binning, the EM register if any, then
+ * bias and read noise.
+ * Without CTI, binned frames sum the expected charge of each superpixel and draw it at once, so noise costs scale with
+ * the output pixels. CTI acts on the full resolution rows before binning. Rows are generated in readout order, so the
+ * fast CTI model runs inside the same pass; the exact model needs the whole frame and adds a second pass.
+ * In EM mode the expected image is converted to electrons, clock induced charge is added, and the amplified electrons
+ * go back to ADUs before the read noise.
+ * A detector signature scales the expected signal by the pixel gain and the dark current by the pixel dark factor, and
+ * adds the column bias at readout, so fixed pattern noise only costs the loads of its maps. An ADC turns each read row
+ * into codes through its lookup table.
+ */
+void Frame::addDetectorNoise(const Grid<double> *backgroundMap)
+{
+    const double dark = darkCounts.mean();
+    const double electronsPerUnit = emccd ? 1.0 : tel.GAIN;
+    const double cic = emccd ? emccd->cic() : 0.0;
+    const uint32_t bw = w / binning, bh = h / binning;
+    std::poisson_distribution<uint32_t> counts;
+    auto draw = [&](double expected, uint32_t pixels) -> uint32_t {
+        if (emccd)
+        {
+            expected = expected * tel.GAIN + pixels * cic;
+        }
+        return (expected > 0) ? counts(noise_generator, std::poisson_distribution<uint32_t>::param_type(expected)) : 0;
+    };
+
+    Grid<uint32_t> binned(binning > 1 ? bw : 0, binning > 1 ? bh : 0);
+    auto outputRow = [&](uint32_t y) { return (binning > 1) ? binned.row(y) : fr.row(y); };
+    std::vector<uint32_t> electrons(w), summed(bw);
+    std::vector<double> charge(w);
+
+    if (!cti)
     {
-        for (int j = 0; j < w; j++)
+        for (uint32_t yb = 0; yb < bh; yb++)
         {
-            if (fr(j, i) > tel.FGS_MAX_ADU)
+            std::fill(charge.begin(), charge.begin() + bw, signature ? 0.0 : binning * binning * dark);
+            for (uint32_t y = yb * binning; y < (yb + 1) * binning; y++)
+            {
+                const uint32_t *row = fr.row(y);
+                const double *bg = (backgroundMap != NULL) ? backgroundMap->row(y) : NULL;
+                if (signature)
+                {
+                    const uint16_t *gain = &signature->gains()[(std::size_t)y * w];
+                    const uint16_t *darkFactor = &signature->darkFactors()[(std::size_t)y * w];
+                    for (uint32_t x = 0; x < bw * binning; x++)
+                    {
+                        charge[x / binning] += (row[x] + (bg != NULL ? bg[x] : 0.0)) * (gain[x] * DetectorSignature::GAIN_SCALE) +
+                                               dark * (darkFactor[x] * DetectorSignature::DARK_SCALE);
+                    }
+                    continue;
+                }
+                for (uint32_t x = 0; x < bw * binning; x++)
+                {
+                    charge[x / binning] += row[x] + (bg != NULL ? bg[x] : 0.0);
+                }
+            }
+            for (uint32_t xb = 0; xb < bw; xb++)
             {
-                fr(j, i) = tel.FGS_MAX_ADU;
+                summed[xb] = draw(charge[xb], binning * binning);
             }
+            readoutRow(outputRow(yb), summed.data(), bw, charge);
         }
     }
+    else
+    {
+        // Full resolution charge, through the parallel transfer, then summed into superpixel rows
+        const bool exactCTI = cti->isExact();
+        cti->reset(w);
+        for (uint32_t y = 0; y < h; y++)
+        {
+            uint32_t *row = fr.row(y);
+            const double *bg = (backgroundMap != NULL) ? backgroundMap->row(y) : NULL;
+            const uint16_t *gain = signature ? &signature->gains()[(std::size_t)y * w] : NULL;
+            const uint16_t *darkFactor = signature ? &signature->darkFactors()[(std::size_t)y * w] : NULL;
+            for (uint32_t x = 0; x < w; x++)
+            {
+                double expected = row[x] + (bg != NULL ? bg[x] : 0.0);
+                if (signature)
+                {
+                    expected = expected * (gain[x] * DetectorSignature::GAIN_SCALE) + dark * (darkFactor[x] * DetectorSignature::DARK_SCALE);
+                }
+                else
+                {
+                    expected += dark;
+                }
+                electrons[x] = draw(expected, 1);
+            }
+            if (exactCTI)
+            {
+                std::copy(electrons.begin(), electrons.end(), row);
+                continue;
+            }
+            std::copy(electrons.begin(), electrons.end(), charge.begin());
+            cti->transferRow(y, charge.data(), w, electronsPerUnit);
+            for (uint32_t x = 0; x < w; x++)
+            {
+                row[x] = (uint32_t)std::round(charge[x]);
+            }
+        }
+        if (exactCTI)
+        {
+            cti->apply(fr, electronsPerUnit);
+        }
+
+        for (uint32_t yb = 0; yb < bh; yb++)
+        {
+            std::fill(summed.begin(), summed.end(), 0);
+            for (uint32_t y = yb * binning; y < (yb + 1) * binning; y++)
+            {
+                const uint32_t *row = &fr[(std::size_t)y * w];
+                for (uint32_t x = 0; x < bw * binning; x++)
+                {
+                    summed[x / binning] += row[x];
+                }
+            }
+            readoutRow(outputRow(yb), summed.data(), bw, charge);
+        }
+    }
+
+    if (binning > 1)
+    {
+        binned.extraPixel() = fr.extraPixel();
+        fr = binned;
+    }
 }
 
-void Frame::addShotNoise()
+// EM register, if any, bias and read noise of a row of collected charge
+void Frame::readoutRow(uint32_t *row, const uint32_t *electrons, uint32_t n, std::vector<double> &amplified)
 {
-    std::default_random_engine ADUs_n_generator;
-    std::poisson_distribution<uint32_t> ADUs;
+    if (emccd)
+    {
+        emccd->multiply(electrons, amplified.data(), n, noise_generator);
+        for (uint32_t x = 0; x < n; x++)
+        {
+            row[x] = (uint32_t)std::round(amplified[x] / tel.GAIN) + pixel_readnoiseCounts();
+        }
+    }
+    else
+    {
+        for (uint32_t x = 0; x < n; x++)
+        {
+            row[x] = electrons[x] + pixel_readnoiseCounts();
+        }
+    }
 
-    uint32_t pix_val = 0;
-    
-    for (int i = 0; i < w*h; i++)
+    // Column bias of the output amplifier, from the first physical column of each superpixel
+    if (signature)
     {
-            pix_val = fr[i];
-            ADUs = std::poisson_distribution<uint32_t>(pix_val);
-            fr[i] = ADUs(ADUs_n_generator);
+        const int16_t *bias = signature->columnBiases();
+        for (uint32_t x = 0; x < n; x++)
+        {
+            row[x] = (uint32_t)std::max<int64_t>((int64_t)row[x] + bias[x * binning], 0);
+        }
+    }
+
+    if (adc)
+    {
+        adc->convert(row, row, n);
     }
 }
 
-void Frame::addDarkNoise()
+// Sums the frame into superpixels, for noiseless frames
+void Frame::binFrame()
 {
-    for (int i = 0; i < w*h; i++)
+    const uint32_t bw = w / binning, bh = h / binning;
+    Grid<uint32_t> binned(bw, bh);
+    for (uint32_t y = 0; y < bh * binning; y++)
     {
-            fr[i]  += pixel_darkCounts();
+        for (uint32_t x = 0; x < bw * binning; x++)
+        {
+            binned[(std::size_t)(y / binning) * bw + x / binning] += fr[(std::size_t)y * w + x];
+        }
     }
+    binned.extraPixel() = fr.extraPixel();
+    fr = binned;
 }
 
-void Frame::addBiasNoise()
+// Noiseless frames get the expected background only
+void Frame::addBackground(const Grid<double> *backgroundMap)
 {
-    for (int i = 0; i < w*h; i++)
+    for (std::size_t i = 0; i < fr.size(); i++)
     {
-           fr[i]  += pixel_readnoiseCounts();
+            fr[i] += (uint32_t)std::round((*backgroundMap)[i]);
     }
 }
 
 void Frame::addPedestal(uint16_t value)
 {
-    for (int i = 0; i < w*h; i++)
+    for (std::size_t i = 0; i < fr.size(); i++)
     {
             fr[i] += value;
     }
@@ -267,17 +692,18 @@ void Frame::reset()
 {
     sources.clear();
     fr.reset();
-    simfr.reset();
     saturated = false;
 }
 
 void Frame::saveToFile(std::string filename)
 {
+    uint32_t w = fr.width();
+    uint32_t h = fr.height();
     uint32_t maxValue = 0;
 
-    for (int i = 0; i < h; i++)
+    for (uint32_t i = 0; i < h; i++)
     {
-        for (int j = 0; j < w; j++)
+        for (uint32_t j = 0; j < w; j++)
         {
             if (fr(j, i) > maxValue)
             {
@@ -299,13 +725,13 @@ void Frame::saveToFile(std::string filename)
         // Write each row and column of Pixels into the image file -- we write
         // from bottom left corner, going right and up
 
-        for (int y = 0; y < h; y++)
+        for (uint32_t y = 0; y < h; y++)
         {
-            uint16_t pixVal = fr(0, y);
+            uint32_t pixVal = fr(0, y);
             file << pixVal;
-            for (int x = 1; x < w; x++)
+            for (uint32_t x = 1; x < w; x++)
             {
-                uint16_t pixVal = fr(x, y);
+                uint32_t pixVal = fr(x, y);
                 file << "," << pixVal;
             }
             file << std::endl;
@@ -317,6 +743,8 @@ void Frame::saveToFile(std::string filename)
 
 void Frame::saveToBitmap(std::string filename)
 {
+    uint32_t w = fr.width();
+    uint32_t h = fr.height();
     std::ofstream file(filename.c_str(), std::ios::out | std::ios::binary);
 
     if (file.fail())
@@ -356,9 +784,9 @@ void Frame::saveToBitmap(std::string filename)
 
         // Write each row and column of Pixels into the image file -- we write
         // from bottom left corner, going right and up
-        for (int y = 0; y < h; y++)
+        for (uint32_t y = 0; y < h; y++)
         {
-            for (int x = 0; x < w; x++)
+            for (uint32_t x = 0; x < w; x++)
             {
 #if FGS_BITS == 8
                 uchar_t pixVal = (uchar_t)fr(x, y);
@@ -380,7 +808,7 @@ void Frame::saveToBitmap(std::string filename)
 
             // Rows are padded so that they're always a multiple of 4
             // bytes. This line skips the padding at the end of each row.
-            for (int i = 0; i < ((w * bytes_per_pixels) % 4); i++)
+            for (uint32_t i = 0; i < ((w * bytes_per_pixels) % 4); i++)
             {
                 file.put(0);
             }
@@ -390,8 +818,10 @@ void Frame::saveToBitmap(std::string filename)
     }
 }
 
-void Frame::set(uint16_t initialX, uint16_t finalX, uint16_t initialY, uint16_t finalY, uint16_t value)
+void Frame::set(uint32_t initialX, uint32_t finalX, uint32_t initialY, uint32_t finalY, uint32_t value)
 {
+    uint32_t w = fr.width();
+    uint32_t h = fr.height();
     if (finalX >= w)
     {
         finalX = w - 1;
@@ -402,41 +832,40 @@ void Frame::set(uint16_t initialX, uint16_t finalX, uint16_t initialY, uint16_t
         finalY = h - 1;
     }
 
-    for (int i = initialY; i <= finalY; i++)
+    for (uint32_t i = initialY; i <= finalY; i++)
     {
-        for (int j = initialX; j <= finalX; j++)
+        for (uint32_t j = initialX; j <= finalX; j++)
         {
             (*this)(j, i) = value;
         }
     }
 }
 
-void Frame::setAll(uint16_t value)
+void Frame::setAll(uint32_t value)
 {
-    set(0, w - 1, 0, h - 1, value);
+    set(0, fr.width() - 1, 0, fr.height() - 1, value);
 }
 
-void Frame::subFrame(uint16_t centerX, uint16_t centerY, uint16_t width, uint16_t height)
+void Frame::subFrame(uint32_t centerX, uint32_t centerY, uint32_t width, uint32_t height)
 {
     fr = fr.subGrid(centerX, centerY, width, height);
     w = fr.width();
     h = fr.height();
     hsim = h * tel.SIMELS;
     wsim = w * tel.SIMELS;
-    simfr.resize(wsim, hsim);
 }
 
 void Frame::Print()
 {
-    uint16_t w = fr.width();
-    uint16_t h = fr.height();
+    uint32_t w = fr.width();
+    uint32_t h = fr.height();
     std::cout << "Printing frame values" << std::endl;
     std::cout << "Array Width: " << w << std::endl;
     std::cout << "Array Heigth : " << h << std::endl;
 
-    for (uint16_t y = h - 1; y == 0; y--)
+    for (uint32_t y = h - 1; y == 0; y--)
     {
-        for (uint16_t x = 0; x < w; x++)
+        for (uint32_t x = 0; x < w; x++)
         {
             printf("%d \t", fr(x, y));
         }
@@ -445,17 +874,17 @@ void Frame::Print()
     std::cout << std::endl;
 }
 
-void Frame::PrintProbArray(Grid<double> *probMatrixptr, const char *message)
+void Frame::PrintProbArray(ArenaGrid<double> *probMatrixptr, const char *message)
 {
-    uint16_t w = probMatrixptr->width();
-    uint16_t h = probMatrixptr->height();
+    uint32_t w = probMatrixptr->width();
+    uint32_t h = probMatrixptr->height();
     printf("Printing %s probability array values\n", message);
     std::cout << "Array Width: " << w << std::endl;
     std::cout << "Array Heigth : " << h << std::endl;
 
-    for (uint16_t y = h - 1; y == 0; y--)
+    for (uint32_t y = h - 1; y == 0; y--)
     {
-        for (uint16_t x = 0; x < w; x++)
+        for (uint32_t x = 0; x < w; x++)
         {
             printf("%4.3f \t", probMatrixptr->operator()(x, y));
         }
@@ -464,48 +893,123 @@ void Frame::PrintProbArray(Grid<double> *probMatrixptr, const char *message)
     std::cout << std::endl;
 }
 
-void Frame::PrintSimelArray()
+void Frame::calculateGaussian(double cx, double cy, double sigmax, double sigmay, ArenaGrid<double> *probMatrix)
 {
-    uint16_t w = simfr.width();
-    uint16_t h = simfr.height();
-    std::cout << "Printing simels values" << std::endl;
-    std::cout << "Array Width: " << w << std::endl;
-    std::cout << "Array Heigth : " << h << std::endl;
+    uint32_t xlim = probMatrix->width();
+    uint32_t ylim = probMatrix->height();
+    const double A = 100 / (2 * M_PI * sigmax * sigmay);
+    for (unsigned int y = 0; y < ylim; y++)
+    {
+        for (unsigned int x = 0; x < xlim; x++)
+        {
+            double xTerm = pow((x - cx), 2) / (2 * pow(sigmax, 2));
+            double yTerm = pow((y - cy), 2) / (2 * pow(sigmay, 2));
+            double sample_prob = (A * exp(-(xTerm + yTerm)));
+            probMatrix->operator()(x, y) = sample_prob;
+        }
+    }
+}
 
-    for (uint16_t y = h - 1; y == 0; y--)
+// Builds the source distribution on the simels covered by the stamp only. Detections outside the footprint go to the extra pixel.
+void Frame::calculateStamp(double cx, double cy, const PSFStamp &stamp, source &src)
+{
+    int32_t minX = std::max<int32_t>(0, (int32_t)std::floor(cx - stamp.halfWidth()));
+    int32_t minY = std::max<int32_t>(0, (int32_t)std::floor(cy - stamp.halfHeight()));
+    int32_t maxX = std::min<int32_t>(wsim - 1, (int32_t)std::ceil(cx + stamp.halfWidth()));
+    int32_t maxY = std::min<int32_t>(hsim - 1, (int32_t)std::ceil(cy + stamp.halfHeight()));
+
+    Arena::Scope scratch;
+    ArenaGrid<double> probMatrix(1, 1);
+    if (maxX >= minX && maxY >= minY)
     {
-        for (uint16_t x = 0; x < w; x++)
+        probMatrix.resize(maxX - minX + 1, maxY - minY + 1);
+        const double A = 100 * stamp.oversampling * stamp.oversampling;
+        for (uint32_t y = 0; y < probMatrix.height(); y++)
         {
-            printf("%d \t", simfr(x, y));
+            for (uint32_t x = 0; x < probMatrix.width(); x++)
+            {
+                probMatrix(x, y) = A * stamp.density(minX + x - cx, minY + y - cy);
+            }
         }
-        std::cout << std::endl;
+        applyPixelResponse(probMatrix, minX, minY);
     }
-    std::cout << std::endl;
+    else
+    {
+        minX = 0;
+        minY = 0;
+    }
+
+#ifdef PRINT_PROB_ARRAY
+    PrintProbArray(&probMatrix, "stamp");
+#endif
+
+    double prob_ADUs_outside_footprint = 100 - probMatrix.total();
+    probMatrix.extraPixel() = std::max(prob_ADUs_outside_footprint, 0.0);
+
+    src.source_distribution = detectionDistribution(probMatrix);
+    src.footprintX = minX;
+    src.footprintY = minY;
+    src.footprintW = probMatrix.width();
+    src.footprintH = probMatrix.height();
 }
 
-void Frame::calculateGaussian(double cx, double cy, double sigmax, double sigmay, Grid<double> *probMatrix)
+// Weights a simel probability matrix by the response at each simel, for a matrix starting at the given simel
+void Frame::applyPixelResponse(ArenaGrid<double> &probMatrix, uint32_t originX, uint32_t originY) const
 {
-    uint16_t xlim = probMatrix->width();
-    uint16_t ylim = probMatrix->height();
-    const double A = 100 / (2 * M_PI * sigmax * sigmay);
-    for (unsigned int y = 0; y < ylim; y++)
+    if (simelWeights.empty())
     {
-        for (unsigned int x = 0; x < xlim; x++)
+        return;
+    }
+    const uint32_t S = tel.SIMELS;
+    for (uint32_t y = 0; y < probMatrix.height(); y++)
+    {
+        const double *weights = &simelWeights[((originY + y) % S) * S];
+        for (uint32_t x = 0; x < probMatrix.width(); x++)
         {
-            double xTerm = pow((x - cx), 2) / (2 * pow(sigmax, 2));
-            double yTerm = pow((y - cy), 2) / (2 * pow(sigmay, 2));
-            double sample_prob = (A * exp(-(xTerm + yTerm)));
-            probMatrix->operator()(x, y) = sample_prob;
+            probMatrix[y * probMatrix.width() + x] *= weights[(originX + x) % S];
         }
     }
 }
 
-void Frame::addSourceDetections(source &src)
+// Samples detections of a source, shifted by whole and fractional simels. Calls detect(simelX, simelY) for detections on the
+// simel array, outside() for the others.
+// Sub-simel shifts: a matching fraction of the detections is moved one simel further, keeping the mean position exact.
+template <typename Detect, typename Outside>
+void Frame::forEachDetection(source &src, ulong_t totDetections, double shiftX, double shiftY, Detect detect, Outside outside)
 {
-    ulong_t totDetections = src.expected_ADUs;
+    const int32_t ix = (int32_t)std::floor(shiftX);
+    const int32_t iy = (int32_t)std::floor(shiftY);
+    const ulong_t nx = (ulong_t)std::round(totDetections * (1 - (shiftX - ix)));
+    const ulong_t ny = (ulong_t)std::round(totDetections * (1 - (shiftY - iy)));
+
+    const uint32_t distributionW = (src.footprintW == 0) ? wsim : src.footprintW;
+    const uint64_t distributionSize = (src.footprintW == 0) ? (uint64_t)wsim * hsim : (uint64_t)src.footprintW * src.footprintH;
+    for (ulong_t i = 0; i < totDetections; i++)
+    {
+        uint32_t pos = src.detection_position();
+        if (pos >= distributionSize)
+        {
+            outside();
+            continue;
+        }
+
+        int64_t x = (int64_t)src.footprintX + (pos % distributionW) + ix + (i >= nx);
+        int64_t y = (int64_t)src.footprintY + (pos / distributionW) + iy + (i >= ny);
+        if (x < 0 || y < 0 || x >= wsim || y >= hsim)
+        {
+            outside();
+        }
+        else
+        {
+            detect((uint32_t)x, (uint32_t)y);
+        }
+    }
+}
 
+void Frame::addSourceDetections(source &src, ulong_t totDetections, double shiftX, double shiftY)
+{
 #ifdef DEBUG
-    printf("N. of total detections (photons/ADUs) for source in this frame: %d \n", isrc, totDetections);
+    printf("N. of total detections (photons/ADUs) for source in this frame: %lu \n", totDetections);
 #endif
 
 // Distribute photons
@@ -514,68 +1018,143 @@ void Frame::addSourceDetections(source &src)
     auto t1 = std::chrono::high_resolution_clock::now();
 #endif
 
-    while (totDetections > 0)
-    {
-        simfr[src.detection_position()]++;
-        totDetections--;
-    }
+    // Detections are binned to pixels as they land, so no simel array is kept
+    forEachDetection(
+        src, totDetections, shiftX, shiftY, [this](uint32_t x, uint32_t y) { fr(x / tel.SIMELS, y / tel.SIMELS)++; },
+        [this]() { fr.extraPixel()++; });
 
 #ifdef TIMING
     auto t2 = std::chrono::high_resolution_clock::now();
-    printf("Assign of source %f took: %f milliseconds \n", isrc, (double)std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count());
+    printf("Assign of source took: %f milliseconds \n", (double)std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count());
 #endif
 
 #ifdef DEBUG
-    printf("Total detections (photons/ADUs) in simel array: %f \n", std::accumulate(simfr.begin(), simfr.end(), 0.0));
-    printf("Total detections (photons/ADUs) outside simel array: %f \n\n", simfr[simfr.extraPixPos()]);
+    printf("Total detections (photons/ADUs) in frame: %f \n", std::accumulate(fr.begin(), fr.end(), 0.0));
+    printf("Total detections (photons/ADUs) outside frame: %u \n\n", fr.extraPixel());
 #endif
 }
 
+/**
+ * Rolling shutter detections of a source. Time is cut in slices of t / slices from the frame start, shared by all rows
+ * and sources: each slice is rendered once with its mean jitter offset, and a row keeps the detections of a slice in
+ * proportion to the part of the slice it is open for. Only slices seen by the rows the source can reach, its footprint
+ * shifted by the jitter, are rendered, so a source costs about as much as in a global shutter frame, plus the footprint
+ * height in line times.
+ */
+void Frame::addRollingShutterDetections(source &src)
+{
+    const double sliceT = t / slices;
+    const double plateScale = astroUtilities::plateScale(tel);
+    const double simelsPerArcsec = tel.SIMELS / plateScale;
+
+    // Rows the source can reach: its footprint, widened by the largest jitter shift over the readout
+    const uint32_t readoutSlices = (uint32_t)std::ceil(((h - 1) * lineTime + t) / sliceT);
+    std::vector<pixel_coordinates> offsets(readoutSlices, {0, 0});
+    if (jitter)
+    {
+        jitter->meanOffsets(startTime, sliceT, readoutSlices, offsets.data());
+    }
+    int64_t firstRow = 0, lastRow = h - 1;
+    if (src.footprintW != 0)
+    {
+        double shift = 0;
+        for (const pixel_coordinates &offset : offsets)
+        {
+            shift = std::max(shift, std::abs(offset.y));
+        }
+        const int64_t margin = 1 + (int64_t)std::ceil(shift / plateScale);
+        firstRow = std::max<int64_t>((int64_t)src.footprintY / tel.SIMELS - margin, 0);
+        lastRow = std::min<int64_t>((int64_t)(src.footprintY + src.footprintH - 1) / tel.SIMELS + margin, h - 1);
+    }
+    const uint32_t firstSlice = (uint32_t)std::floor(firstRow * lineTime / sliceT);
+    const uint32_t lastSlice = std::min((uint32_t)std::ceil((lastRow * lineTime + t) / sliceT), readoutSlices);
+
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    double expected = 0;
+    ulong_t detected = 0;
+    for (uint32_t k = firstSlice; k < lastSlice; k++)
+    {
+        const double sliceStart = k * sliceT, sliceEnd = sliceStart + sliceT;
+        expected += sourceFlux(src, startTime + sliceStart + sliceT / 2) * sliceT / t;
+        ulong_t sliceDetections = (ulong_t)expected - detected;
+        detected += sliceDetections;
+
+        // The fraction of the slice a row is open for is computed for the row each detection lands on, so no row is
+        // left out
+        forEachDetection(
+            src, sliceDetections, offsets[k].x * simelsPerArcsec, offsets[k].y * simelsPerArcsec,
+            [&](uint32_t x, uint32_t y) {
+                const double open = (y / tel.SIMELS) * lineTime;
+                const double fraction = std::max(0.0, std::min(sliceEnd, open + t) - std::max(sliceStart, open)) / sliceT;
+                if (fraction >= 1 || (fraction > 0 && uniform(noise_generator) < fraction))
+                {
+                    fr(x / tel.SIMELS, y / tel.SIMELS)++;
+                }
+            },
+            [this]() { fr.extraPixel()++; });
+    }
+}
+
 // TODO: if statistical, we still need to worry about saturation!
 void Frame::simelsToFrame(bool statistical)
 {
     if (statistical == false) // just to debug, make smooth gaussian
     {
-        Grid<double> tempMatrix(w, h);
-        source src = sources[0];
-        Grid<double> *tempMatrixPtr = &tempMatrix;
+        const source &src = sources[0];
+        if (pixelResponse)
+        {
+            // Gaussian integrated over the response of each pixel, one row and one column profile as both are separable.
+            // Scaled to the peak of the point sampled gaussian.
+            const double sigmax = src.fwhm_x / 2.3585, sigmay = src.fwhm_y / 2.3585;
+            std::vector<double> columns(w), rows(h);
+            for (uint32_t x = 0; x < w; x++)
+            {
+                columns[x] = pixelResponse->integrateGaussianX(x - src.cx, sigmax) * sqrt(2 * M_PI) * sigmax;
+            }
+            for (uint32_t y = 0; y < h; y++)
+            {
+                rows[y] = pixelResponse->integrateGaussianY(y - src.cy, sigmay) * sqrt(2 * M_PI) * sigmay;
+            }
+            for (uint32_t y = 0; y < h; y++)
+            {
+                for (uint32_t x = 0; x < w; x++)
+                {
+                    fr(x, y) = (uint32_t)(45000.0 * columns[x] * rows[y]);
+                }
+            }
+            fr.extraPixel() = 0;
+            return;
+        }
+
+        Arena::Scope scratch;
+        ArenaGrid<double> tempMatrix(w, h);
+        ArenaGrid<double> *tempMatrixPtr = &tempMatrix;
         calculateGaussian(src.cx, src.cy, src.fwhm_x / 2.3585, src.fwhm_y / 2.3585, tempMatrixPtr);
         const double A = 100 / (2 * M_PI * (src.fwhm_x / 2.3585) * (src.fwhm_y / 2.3585));
 
-        for (uint16_t y = 0; y < h; y++)
+        for (uint32_t y = 0; y < h; y++)
         {
-            for (uint16_t x = 0; x < w; x++)
+            for (uint32_t x = 0; x < w; x++)
             {
                 fr(x, y) = (uint32_t)(tempMatrix(x, y) * (45000.0 / A));
             }
         }
+        fr.extraPixel() = 0;
     }
     else
     {
-        for (uint16_t y = 0; y < h; y++)
+        // Detections are already binned to pixels. Pixels reaching the full scale are saturated.
+        for (uint32_t y = 0; y < h; y++)
         {
-            for (uint16_t x = 0; x < w; x++)
-            { // Loop through image
-                uint64_t pixVal = 0;
-                for (uint16_t simy = y * tel.SIMELS; simy < y * tel.SIMELS + tel.SIMELS && (pixVal < tel.FGS_MAX_ADU); simy++)
+            uint32_t *row = fr.row(y);
+            for (uint32_t x = 0; x < w; x++)
+            {
+                if (row[x] >= tel.FGS_MAX_ADU)
                 {
-                    for (uint16_t simx = x * tel.SIMELS; simx < x * tel.SIMELS + tel.SIMELS && (pixVal < tel.FGS_MAX_ADU); simx++)
-                    { // Loop through simels for selected pixel
-                        if ((pixVal + simfr(simx, simy)) < tel.FGS_MAX_ADU)
-                        {
-                            pixVal += simfr(simx, simy);
-                        }
-                        else
-                        {
-                            pixVal = tel.FGS_MAX_ADU;
-                            saturated = true;
-                        }
-                    }
+                    row[x] = tel.FGS_MAX_ADU;
+                    saturated = true;
                 }
-                fr(x, y) = pixVal;
             }
         }
-
-        fr[fr.extraPixPos()] = simfr[simfr.extraPixPos()];
     }
 }
@@ -8,13 +8,30 @@
  */
 #pragma once
 
+#include <algorithm>
+#include <limits>
 #include <random>
+#include <type_traits>
 #include <chrono>
 #include <memory>
 
 #include "typedefs.h"
 #include "Grid.hpp"
+#include "GridStorage.hpp"
 #include "telescopes.h"
+#include "PolychromaticPSF.hpp"
+#include "Background.hpp"
+#include "Jitter.hpp"
+#include "Scene.hpp"
+#include "LightCurve.hpp"
+#include "EventList.hpp"
+#include "CosmicRays.hpp"
+#include "EMCCD.hpp"
+#include "CTI.hpp"
+#include "DetectorMTF.hpp"
+#include "DetectorSignature.hpp"
+#include "ADC.hpp"
+#include "PixelResponse.hpp"
 
 const int BMP_MAGIC_ID = 2;
 
@@ -59,6 +76,13 @@ struct source
   double expected_ADUs;
   double cx, cy, fwhm_x, fwhm_y;
 
+  // Simel footprint of the distribution. A zero width means the distribution covers the whole simel array.
+  // Last element of a footprint distribution collects detections falling outside the footprint.
+  uint32_t footprintX = 0, footprintY = 0, footprintW = 0, footprintH = 0;
+
+  // Relative flux over time, evaluated at mid exposure. Null for a constant source.
+  std::shared_ptr<const LightCurve> lightCurve;
+
   /*ulong_t frame_photons()
   {
     return photons(photon_n_generator);
@@ -84,26 +108,103 @@ public:
 
   ~Frame();
 
-  uint32_t &operator()(uint16_t x, uint16_t y);
-  const uint32_t &operator()(uint16_t x, uint16_t y) const;
+  uint32_t &operator()(uint32_t x, uint32_t y);
+  const uint32_t &operator()(uint32_t x, uint32_t y) const;
 
   // Redirect first method to second, generic one
   void addSource(double cx, double cy, double fwhm_x, double fwhm_y, double magnitude);
   void addSource(double cx, double cy, double fwhm_x, double fwhm_y, std::vector<double> mags);
+  void addSource(double cx, double cy, std::shared_ptr<const PSFStamp> stamp, std::vector<double> mags);
+
+  // Adds the stars of a scene touching the frame, or the given regions only
+  uint32_t addScene(const Scene &scene, const std::vector<pixel_window> &rois = {});
+
+  // Render sources from chromatic stamps. Pass nullptr to go back to achromatic gaussians.
+  void setChromaticPSF(std::shared_ptr<PolychromaticPSF> psf) { chromaticPSF = psf; }
+
+  // Light curve of a source, by index in order of addition. -1 for the last added source.
+  void setLightCurve(std::shared_ptr<const LightCurve> curve, int32_t sourceIndex = -1);
+
+  // Fraction of the source flux reaching the telescope in the next frames, e.g. from Atmosphere::scintillationFactor
+  void setTransmission(double _transmission) { transmission = _transmission; }
+
+  // Sky and thermal background, added to the expected image before shot noise. Pass nullptr to remove it.
+  void setBackground(std::shared_ptr<Background> bg, sky_coordinates _pointing = {0, 0})
+  {
+    background = bg;
+    pointing = _pointing;
+  }
+
+  // Pointing jitter. Each frame is split in slices, each shifted by the mean jitter offset over the slice. Pass nullptr to remove it.
+  void setJitter(std::shared_ptr<const Jitter> _jitter, uint16_t _slices = 1)
+  {
+    jitter = _jitter;
+    slices = std::max<uint16_t>(_slices, 1);
+  }
+
+  // Cosmic ray hits, deposited in noisy frames before the detector noise. Pass nullptr to remove them.
+  void setCosmicRays(std::shared_ptr<CosmicRays> _cosmicRays) { cosmicRays = _cosmicRays; }
+
+  // Electron multiplying readout for noisy frames: gamma distributed gain and clock induced charge. Pass nullptr for a conventional CCD.
+  void setEMCCD(std::shared_ptr<const EMCCD> _emccd) { emccd = _emccd; }
+
+  // Charge transfer inefficiency of the parallel readout, for noisy frames. Pass nullptr to remove it.
+  void setCTI(std::shared_ptr<CTI> _cti) { cti = _cti; }
+
+  // Rolling shutter: row y integrates from the frame start plus y line times, for the exposure time. 0 for a global shutter.
+  // Rows open during the same jitter slice share its offset and rendered detections.
+  void setRollingShutter(double _lineTime) { lineTime = std::max(_lineTime, 0.0); }
+
+  // Charge diffusion or pixel MTF, applied to the expected image before background and noise. Pass nullptr to remove it.
+  void setDetectorMTF(std::shared_ptr<const DetectorMTF> _mtf) { detectorMTF = _mtf; }
+
+  // Fixed pattern of the detector (PRNU, DSNU, hot pixels, dead columns, column bias), for noisy frames. Pass nullptr to remove it.
+  void setDetectorSignature(std::shared_ptr<const DetectorSignature> _signature)
+  {
+    if (_signature && (_signature->width() != w || _signature->height() != h))
+    {
+      throw "Error! Detector signature doesn't match the frame size";
+    }
+    signature = _signature;
+  }
+
+  // Detector response and ADC, applied as a lookup table at readout. Replaces the plain clipping at FGS_MAX_ADU. Pass nullptr to remove it.
+  void setADC(std::shared_ptr<const ADC> _adc) { adc = _adc; }
+
+  // Intra-pixel response. Folded in the distribution of each source as simel weights, so set it before adding sources.
+  // Lost detections count as outside the frame. Jitter and rolling shutter shifts move detections after the response.
+  void setPixelResponse(std::shared_ptr<const PixelResponse> _response)
+  {
+    if (!sources.empty())
+    {
+      throw "Error! Set the pixel response before adding sources";
+    }
+    pixelResponse = _response;
+    simelWeights = _response ? _response->simelWeights(tel.SIMELS) : std::vector<double>();
+  }
+
+  // On-chip binning: charge is summed in factor x factor superpixels before read noise, and frames come out smaller.
+  // Leftover rows and columns are not read. Pass the factor to FrameProcessor to get centroids in unbinned pixels.
+  void setBinning(uint16_t factor) { binning = std::max<uint16_t>(factor, 1); }
+  uint16_t getBinning() const { return binning; }
+
+  // Start time of the next frame in the jitter series, in seconds. Advanced by the exposure time after each frame.
+  void setStartTime(double _startTime) { startTime = _startTime; }
+  double getStartTime() const { return startTime; }
 
   void generateFrame(bool statistical = true);
+  EventList generateEvents(bool timeTagged = false);
   void reset();
 
   void saveToBitmap(std::string filename);
   void saveToFile(std::string filename);
   void Print();
-  void PrintSimelArray();
 
-  void set(uint16_t initialX, uint16_t finalX, uint16_t initialY, uint16_t finalY, uint16_t value);
-  void setAll(uint16_t value);
+  void set(uint32_t initialX, uint32_t finalX, uint32_t initialY, uint32_t finalY, uint32_t value);
+  void setAll(uint32_t value);
 
   // TODO: return smart pointer
-  void subFrame(uint16_t centerX, uint16_t centerY, uint16_t width, uint16_t height);
+  void subFrame(uint32_t centerX, uint32_t centerY, uint32_t width, uint32_t height);
 
   bool isSaturated()
   {
@@ -114,6 +215,34 @@ public:
   {
     return &fr;
   }
+  // Frame read out in another pixel type: uint16_t detector output, or float calibrated data. Frames accumulate in
+  // uint32_t; integer outputs saturate at their largest value. out is resized as needed, so it can be reused across frames.
+  // out can have any layout or allocator, so frames can be read out straight into mapped files or shared memory.
+  template <class Pixel, class Layout, class Access, class Allocator>
+  void get(Grid<Pixel, Layout, Access, Allocator> &out) const
+  {
+    if (out.width() != fr.width() || out.height() != fr.height())
+    {
+      out.resize(fr.width(), fr.height());
+    }
+    const uint32_t maxValue = std::is_integral<Pixel>::value ? std::min<uint64_t>(std::numeric_limits<Pixel>::max(), UINT32_MAX) : UINT32_MAX;
+    // Row major outputs are written in place, tiled ones through a row buffer
+    std::vector<Pixel> buffer(Layout::rowMajor ? 0 : fr.width());
+    for (uint32_t y = 0; y < fr.height(); y++)
+    {
+      const uint32_t *row = fr.row(y);
+      Pixel *output = buffer.data();
+      if constexpr (Layout::rowMajor)
+        output = out.row(y);
+      for (uint32_t x = 0; x < fr.width(); x++)
+      {
+        output[x] = (Pixel)std::min(row[x], maxValue);
+      }
+      if constexpr (!Layout::rowMajor)
+        out.setRow(y, output);
+    }
+    out.extraPixel() = (Pixel)std::min(fr.extraPixel(), maxValue);
+  }
   // const Grid<uint32_t> getGrid() { return fr; }
 
   inline std::shared_ptr<Grid<uint32_t>> get_smartPtr()
@@ -123,18 +252,23 @@ public:
   }
 
 private:
+  // Gaussian sources are sampled within this many sigmas of their centre
+  static constexpr double GAUSSIAN_EXTENT = 8;
+
   Telescope tel;
   double mag, t;
+  double transmission = 1.0;
+  double startTime = 0;
+  double lineTime = 0;
+  uint16_t binning = 1;
+  uint16_t slices = 1;
   bool saturated = false;
 
-  std::default_random_engine readnoise_generator, dark_generator;
+  std::default_random_engine readnoise_generator;
+  std::mt19937 noise_generator;
   std::poisson_distribution<ulong_t> darkCounts;
   std::normal_distribution<double> readnoiseCounts;
 
-  ulong_t pixel_darkCounts()
-  {
-    return darkCounts(dark_generator);
-  }
   ulong_t pixel_readnoiseCounts()
   {
     double readnoise = readnoiseCounts(readnoise_generator);
@@ -147,21 +281,41 @@ private:
   }
 
   std::vector<source> sources;
+  std::shared_ptr<PolychromaticPSF> chromaticPSF;
+  std::shared_ptr<Background> background;
+  std::shared_ptr<const Jitter> jitter;
+  std::shared_ptr<CosmicRays> cosmicRays;
+  std::shared_ptr<const EMCCD> emccd;
+  std::shared_ptr<CTI> cti;
+  std::shared_ptr<const DetectorMTF> detectorMTF;
+  std::shared_ptr<const DetectorSignature> signature;
+  std::shared_ptr<const ADC> adc;
+  std::shared_ptr<const PixelResponse> pixelResponse;
+  std::vector<double> simelWeights; // SIMELS x SIMELS, from the pixel response
+  sky_coordinates pointing = {0, 0};
   uint32_t h, w, hsim, wsim;
-  Grid<uint32_t> simfr, fr;
+  Grid<uint32_t> fr;
 
-  uint16_t nsources()
+  std::size_t nsources() const
   {
     return sources.size();
   }
   void calculateGaussian(double cx, double cy, double sigmax, double sigmay,
-                         Grid<double> *probMatrix);
-  void addShotNoise();
-  void addDarkNoise();
-  void addBiasNoise();
+                         ArenaGrid<double> *probMatrix);
+  void calculateStamp(double cx, double cy, const PSFStamp &stamp, source &src);
+  void applyPixelResponse(ArenaGrid<double> &probMatrix, uint32_t originX, uint32_t originY) const;
+  std::vector<double> checkMags(std::vector<double> mags);
+  void addDetectorNoise(const Grid<double> *backgroundMap = NULL);
+  void readoutRow(uint32_t *row, const uint32_t *electrons, uint32_t n, std::vector<double> &amplified);
+  void binFrame();
+  void addBackground(const Grid<double> *backgroundMap);
   void addPedestal(uint16_t value);
 
-  void PrintProbArray(Grid<double> *probMatrixptr, const char *message);
+  void PrintProbArray(ArenaGrid<double> *probMatrixptr, const char *message);
   void simelsToFrame(bool statistical = true);
-  void addSourceDetections(source &src);
+  void addSourceDetections(source &src, ulong_t totDetections, double shiftX = 0, double shiftY = 0);
+  void addRollingShutterDetections(source &src);
+  double sourceFlux(const source &src, double time) const;
+  template <typename Detect, typename Outside>
+  void forEachDetection(source &src, ulong_t totDetections, double shiftX, double shiftY, Detect detect, Outside outside);
 };
\ No newline at end of file
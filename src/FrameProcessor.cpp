@@ -11,118 +11,151 @@
 #include <iostream>
 #include <random>
 #include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
 #include "astroUtilities.hpp"
 #include "FrameProcessor.hpp"
 #define DEBUG
 
+namespace
+{
+// Pixel value of a computed level. Integer pixels are rounded and saturate, floating point pixels take it as is.
+template <class Pixel>
+Pixel toPixel(double value)
+{
+    if constexpr (std::is_integral<Pixel>::value)
+    {
+        return (Pixel)std::round(std::clamp(value, 0.0, (double)std::numeric_limits<Pixel>::max()));
+    }
+    else
+    {
+        return (Pixel)value;
+    }
+}
+} // namespace
+
 /**
  * Constructs a FrameProcessor object to analyse image data arrays. 
  *
  * @param _frame pointer to constant grid object representing the image
  */
-FrameProcessor::~FrameProcessor()
+template <class Pixel, class Layout>
+BasicFrameProcessor<Pixel, Layout>::~BasicFrameProcessor()
 {
 #ifdef DEBUG_MEMORY
     std::cout << "Destroyed Frame Processor " << std::endl;
 #endif
 }
 
-const uint32_t &FrameProcessor::operator()(unsigned int x, unsigned int y) const
+template <class Pixel, class Layout>
+const Pixel &BasicFrameProcessor<Pixel, Layout>::operator()(unsigned int x, unsigned int y) const
 {
     return frame->operator()(x, y);
 }
 
-const pixel_coordinates FrameProcessor::momentum(const Grid<uint32_t> *fr, uint16_t threshold)
+// First moments of the pixels passing the threshold, in a single row by row pass
+template <class Pixel, class Layout>
+pixel_coordinates BasicFrameProcessor<Pixel, Layout>::momentum(view_type fr, Pixel threshold)
 {
-    pixel_coordinates centr;
-
-    uint64_t totalWeight = total(fr, threshold);
-
-    // Calculate x momentum
-    std::vector<uint64_t> horizontalSum = sumVertical(fr, threshold); // Sum the binned data vertically
-    uint64_t sum = 0;
-    for (uint16_t pixelIndex = 0; pixelIndex < fr->height(); pixelIndex++)
-    { // Calculate weighted mean of vertically summed data
-        sum += (horizontalSum[pixelIndex] * (pixelIndex));
-    }
-    centr.y = (static_cast<double>(sum) / totalWeight);
-
-    // Calculate vertical centre
-    std::vector<uint64_t> verticalSum = sumHorizontal(fr, threshold); // Sum the binned data vertically
-    sum = 0;
-    for (uint16_t pixelIndex = 0; pixelIndex < fr->width(); pixelIndex++)
-    { // Calculate weighted mean of vertically summed data
-        sum += (verticalSum[pixelIndex] * (pixelIndex));
+    pixel_sum_t<Pixel> totalWeight = 0, sumX = 0, sumY = 0;
+    for (uint32_t y = 0; y < fr.height(); y++)
+    {
+        pixel_sum_t<Pixel> rowSum = 0;
+        for (uint32_t x = 0; x < fr.width(); x++)
+        {
+            const Pixel pixel = fr(x, y);
+            const pixel_sum_t<Pixel> value = (pixel >= threshold) ? pixel : 0;
+            rowSum += value;
+            sumX += value * x;
+        }
+        totalWeight += rowSum;
+        sumY += rowSum * y;
     }
-    centr.x = (static_cast<double>(sum) / totalWeight);
 
+    pixel_coordinates centr;
+    centr.x = (static_cast<double>(sumX) / totalWeight);
+    centr.y = (static_cast<double>(sumY) / totalWeight);
     return centr;
-};
+}
 
-const pixel_coordinates FrameProcessor::momentum(uint16_t threshold) const
+template <class Pixel, class Layout>
+pixel_coordinates BasicFrameProcessor<Pixel, Layout>::momentum(const grid_type *fr, Pixel threshold)
 {
-    return momentum(frame, threshold);
+    return momentum(fr->view(), threshold);
 }
 
-uint64_t FrameProcessor::total(uint16_t threshold) const
+template <class Pixel, class Layout>
+pixel_coordinates BasicFrameProcessor<Pixel, Layout>::momentum(Pixel threshold) const
+{
+    return unbinned(momentum(frame, threshold), binning);
+}
+
+template <class Pixel, class Layout>
+pixel_sum_t<Pixel> BasicFrameProcessor<Pixel, Layout>::total(Pixel threshold) const
 {
     return total(frame, threshold);
 }
 
-uint64_t FrameProcessor::total(const Grid<uint32_t> *fr, uint16_t threshold)
+template <class Pixel, class Layout>
+pixel_sum_t<Pixel> BasicFrameProcessor<Pixel, Layout>::total(view_type fr, Pixel threshold)
 {
-    if (threshold == 0)
-    {
-        return std::accumulate(fr->begin(), fr->end(), 0);
-    }
-    else
+    pixel_sum_t<Pixel> total = 0;
+    for (uint32_t y = 0; y < fr.height(); y++)
     {
-        uint64_t total = 0;
-        for (uint16_t x = 0; x < fr->width(); x++)
+        for (uint32_t x = 0; x < fr.width(); x++)
         {
-            for (uint16_t y = 0; y < fr->height(); y++)
-            {
-                uint32_t value = fr->operator()(x, y);
-                if (value >= threshold)
-                {
-                    total += value;
-                }
-            }
+            const Pixel pixel = fr(x, y);
+            total += (pixel >= threshold) ? pixel : 0;
         }
-        return total;
     }
+    return total;
+}
+
+template <class Pixel, class Layout>
+pixel_sum_t<Pixel> BasicFrameProcessor<Pixel, Layout>::total(const grid_type *fr, Pixel threshold)
+{
+    return total(fr->view(), threshold);
 }
 
-const std::vector<uint64_t> FrameProcessor::sumVertical(uint16_t threshold) const
+template <class Pixel, class Layout>
+std::vector<pixel_sum_t<Pixel>> BasicFrameProcessor<Pixel, Layout>::sumVertical(Pixel threshold) const
 {
     return sumVertical(frame, 0, frame->height() - 1, threshold);
 }
 
-const std::vector<uint64_t> FrameProcessor::sumVertical(uint16_t initialPos, uint16_t finalPos, uint16_t threshold) const
+template <class Pixel, class Layout>
+std::vector<pixel_sum_t<Pixel>> BasicFrameProcessor<Pixel, Layout>::sumVertical(uint32_t initialPos, uint32_t finalPos, Pixel threshold) const
 {
     return sumVertical(frame, initialPos, finalPos, threshold);
 }
 
-const std::vector<uint64_t> FrameProcessor::sumVertical(const Grid<uint32_t> *fr, uint16_t threshold)
+template <class Pixel, class Layout>
+std::vector<pixel_sum_t<Pixel>> BasicFrameProcessor<Pixel, Layout>::sumVertical(const grid_type *fr, Pixel threshold)
 {
     return sumVertical(fr, 0, fr->height() - 1, threshold);
 }
 
-const std::vector<uint64_t> FrameProcessor::sumVertical(const Grid<uint32_t> *fr, uint16_t initialPos, uint16_t finalPos, uint16_t threshold)
+template <class Pixel, class Layout>
+std::vector<pixel_sum_t<Pixel>> BasicFrameProcessor<Pixel, Layout>::sumVertical(const grid_type *fr, uint32_t initialPos, uint32_t finalPos, Pixel threshold)
+{
+    return sumVertical(fr->view(), initialPos, finalPos, threshold);
+}
+
+template <class Pixel, class Layout>
+std::vector<pixel_sum_t<Pixel>> BasicFrameProcessor<Pixel, Layout>::sumVertical(view_type fr, uint32_t initialPos, uint32_t finalPos, Pixel threshold)
 {
-    std::vector<uint64_t> verticalVect;
+    std::vector<pixel_sum_t<Pixel>> verticalVect;
     verticalVect.resize(finalPos - initialPos + 1);
 
-    for (uint16_t y = initialPos; y <= finalPos; y++)
+    for (uint32_t y = initialPos; y <= finalPos; y++)
     {
-        uint64_t sumVal = 0;
-        for (uint16_t x = 0; x < fr->width(); x++)
+        pixel_sum_t<Pixel> sumVal = 0;
+        for (uint32_t x = 0; x < fr.width(); x++)
         {
-            uint32_t value = fr->operator()(x, y);
-            if (value >= threshold)
-            {
-                sumVal += value;
-            }
+            const Pixel pixel = fr(x, y);
+            sumVal += (pixel >= threshold) ? pixel : 0;
         }
         verticalVect[y - initialPos] = sumVal;
     }
@@ -130,66 +163,80 @@ const std::vector<uint64_t> FrameProcessor::sumVertical(const Grid<uint32_t> *fr
     return verticalVect;
 }
 
-const std::vector<uint64_t> FrameProcessor::sumHorizontal(uint16_t threshold) const
+template <class Pixel, class Layout>
+std::vector<pixel_sum_t<Pixel>> BasicFrameProcessor<Pixel, Layout>::sumHorizontal(Pixel threshold) const
 {
     return sumHorizontal(frame, 0, frame->width() - 1, threshold);
 }
 
-const std::vector<uint64_t> FrameProcessor::sumHorizontal(uint16_t initialPos, uint16_t finalPos, uint16_t threshold) const
+template <class Pixel, class Layout>
+std::vector<pixel_sum_t<Pixel>> BasicFrameProcessor<Pixel, Layout>::sumHorizontal(uint32_t initialPos, uint32_t finalPos, Pixel threshold) const
 {
     return sumHorizontal(frame, initialPos, finalPos, threshold);
 }
 
-const std::vector<uint64_t> FrameProcessor::sumHorizontal(const Grid<uint32_t> *fr, uint16_t threshold)
+template <class Pixel, class Layout>
+std::vector<pixel_sum_t<Pixel>> BasicFrameProcessor<Pixel, Layout>::sumHorizontal(const grid_type *fr, Pixel threshold)
 {
     return sumHorizontal(fr, 0, fr->width() - 1, threshold);
 }
 
-const std::vector<uint64_t> FrameProcessor::FrameProcessor::sumHorizontal(const Grid<uint32_t> *fr, uint16_t initialPos, uint16_t finalPos, uint16_t threshold)
+template <class Pixel, class Layout>
+std::vector<pixel_sum_t<Pixel>> BasicFrameProcessor<Pixel, Layout>::sumHorizontal(const grid_type *fr, uint32_t initialPos, uint32_t finalPos, Pixel threshold)
 {
-    std::vector<uint64_t> horizontalVect;
+    return sumHorizontal(fr->view(), initialPos, finalPos, threshold);
+}
+
+// Column sums, accumulated row by row so the frame is read in memory order
+template <class Pixel, class Layout>
+std::vector<pixel_sum_t<Pixel>> BasicFrameProcessor<Pixel, Layout>::sumHorizontal(view_type fr, uint32_t initialPos, uint32_t finalPos, Pixel threshold)
+{
+    std::vector<pixel_sum_t<Pixel>> horizontalVect;
     horizontalVect.resize(finalPos - initialPos + 1);
 
-    for (uint16_t x = initialPos; x <= finalPos; x++)
+    for (uint32_t y = 0; y < fr.height(); y++)
     {
-        uint64_t sumVal = 0;
-        for (uint16_t y = 0; y < fr->height(); y++)
+        for (uint32_t x = 0; x <= finalPos - initialPos; x++)
         {
-            uint32_t value = fr->operator()(x, y);
-            if (value >= threshold)
-            {
-                sumVal += value;
-            }
+            const Pixel pixel = fr(initialPos + x, y);
+            horizontalVect[x] += (pixel >= threshold) ? pixel : 0;
         }
-        horizontalVect[x - initialPos] = sumVal;
     }
 
     return horizontalVect;
 }
 
-const pixel_coordinates FrameProcessor::initial_guess_momentum(const Grid<uint32_t> *fr, uint16_t sigma_threshold, uint8_t background_method)
+template <class Pixel, class Layout>
+pixel_coordinates BasicFrameProcessor<Pixel, Layout>::initial_guess_momentum(view_type fr, uint16_t sigma_threshold, uint8_t background_method)
 {
     double background = backgroundLevel(fr, background_method);
     //TODO: change with proper stDev
     double stDev = sqrt(background);
-    uint16_t threshold = round(background + (sigma_threshold * stDev));
+    Pixel threshold = toPixel<Pixel>(background + (sigma_threshold * stDev));
     pixel_coordinates guess = momentum(fr, threshold);
     return guess;
 }
 
-const pixel_coordinates FrameProcessor::initial_guess_momentum(uint16_t sigma_threshold, uint8_t background_method) const
+template <class Pixel, class Layout>
+pixel_coordinates BasicFrameProcessor<Pixel, Layout>::initial_guess_momentum(const grid_type *fr, uint16_t sigma_threshold, uint8_t background_method)
 {
-    return initial_guess_momentum(frame, sigma_threshold, background_method);
+    return initial_guess_momentum(fr->view(), sigma_threshold, background_method);
 }
 
-//Main method to find centroid, from whole frame to accurate guess
-const pixel_coordinates FrameProcessor::multiple_guess_momentum(const Grid<uint32_t> *fr, uint16_t minWindowSize, uint16_t sigma_threshold, uint16_t sigma_threshold_final)
+template <class Pixel, class Layout>
+pixel_coordinates BasicFrameProcessor<Pixel, Layout>::initial_guess_momentum(uint16_t sigma_threshold, uint8_t background_method) const
 {
-    Grid<uint32_t> subframe = (*fr);
+    return unbinned(initial_guess_momentum(frame, sigma_threshold, background_method), binning);
+}
+
+//Main method to find centroid, from whole frame to accurate guess. Windows are views on the frame, nothing is copied.
+template <class Pixel, class Layout>
+pixel_coordinates BasicFrameProcessor<Pixel, Layout>::multiple_guess_momentum(view_type fr, uint32_t minWindowSize, uint16_t sigma_threshold, uint16_t sigma_threshold_final)
+{
+    view_type subframe = fr;
 
-    uint16_t newWidth = subframe.width();
-    uint16_t newHeight = subframe.height();
-    uint16_t offsetX = 0, offsetY = 0;
+    uint32_t newWidth = subframe.width();
+    uint32_t newHeight = subframe.height();
     pixel_coordinates guess;
 
     //find center and keep halving the size
@@ -201,51 +248,240 @@ const pixel_coordinates FrameProcessor::multiple_guess_momentum(const Grid<uint3
             method = Border;
         }
 
-        guess = initial_guess_momentum(&subframe, sigma_threshold, method);
+        guess = initial_guess_momentum(subframe, sigma_threshold, method);
         newWidth = subframe.width() / 2.0;
         newHeight = subframe.height() / 2.0;
 
-        subframe = subframe.subGrid(guess.x, guess.y, newWidth, newHeight, &offsetX, &offsetY);
+        subframe = subframe.subView(guess.x, guess.y, newWidth, newHeight);
     }
 
-    pixel_coordinates result_centroid = initial_guess_momentum(&subframe, sigma_threshold_final, Border);
-    result_centroid.x += offsetX;
-    result_centroid.y += offsetY;
+    pixel_coordinates result_centroid = initial_guess_momentum(subframe, sigma_threshold_final, Border);
+    result_centroid.x += subframe.originX() - fr.originX();
+    result_centroid.y += subframe.originY() - fr.originY();
 
     result_centroid = fine_momentum(fr, result_centroid.x, result_centroid.y, minWindowSize, sigma_threshold_final);
 
     return result_centroid;
 }
 
-const pixel_coordinates FrameProcessor::multiple_guess_momentum(uint16_t minWindowSize, uint16_t sigma_threshold, uint16_t sigma_threshold_final) const
+template <class Pixel, class Layout>
+pixel_coordinates BasicFrameProcessor<Pixel, Layout>::multiple_guess_momentum(const grid_type *fr, uint32_t minWindowSize, uint16_t sigma_threshold, uint16_t sigma_threshold_final)
 {
-    return multiple_guess_momentum(frame, minWindowSize, sigma_threshold, sigma_threshold_final);
+    return multiple_guess_momentum(fr->view(), minWindowSize, sigma_threshold, sigma_threshold_final);
 }
 
-const pixel_coordinates FrameProcessor::fine_momentum(double guessX, double guessY, uint16_t windowSize, uint16_t sigma_threshold) const
+template <class Pixel, class Layout>
+pixel_coordinates BasicFrameProcessor<Pixel, Layout>::multiple_guess_momentum(uint32_t minWindowSize, uint16_t sigma_threshold, uint16_t sigma_threshold_final) const
 {
-    return fine_momentum(frame, guessX, guessY, windowSize, sigma_threshold);
+    return unbinned(multiple_guess_momentum(frame, minWindowSize, sigma_threshold, sigma_threshold_final), binning);
 }
 
-const pixel_coordinates FrameProcessor::fine_momentum(const Grid<uint32_t> *fr, double guessX, double guessY, uint16_t windowSize, uint16_t sigma_threshold)
+// Guess in unbinned pixels, window size in frame pixels
+template <class Pixel, class Layout>
+pixel_coordinates BasicFrameProcessor<Pixel, Layout>::fine_momentum(double guessX, double guessY, uint32_t windowSize, uint16_t sigma_threshold) const
+{
+    pixel_coordinates guess = binned({guessX, guessY}, binning);
+    return unbinned(fine_momentum(frame, guess.x, guess.y, windowSize, sigma_threshold), binning);
+}
+
+/**
+ * Converts coordinates of a binned frame to unbinned pixels. Superpixel x covers pixels x * factor to (x + 1) * factor - 1.
+ */
+template <class Pixel, class Layout>
+pixel_coordinates BasicFrameProcessor<Pixel, Layout>::unbinned(pixel_coordinates coordinates, uint16_t factor)
+{
+    return {(coordinates.x + 0.5) * factor - 0.5, (coordinates.y + 0.5) * factor - 0.5};
+}
+
+template <class Pixel, class Layout>
+pixel_coordinates BasicFrameProcessor<Pixel, Layout>::binned(pixel_coordinates coordinates, uint16_t factor)
+{
+    return {(coordinates.x + 0.5) / factor - 0.5, (coordinates.y + 0.5) / factor - 0.5};
+}
+
+template <class Pixel, class Layout>
+pixel_coordinates BasicFrameProcessor<Pixel, Layout>::fine_momentum(view_type fr, double guessX, double guessY, uint32_t windowSize, uint16_t sigma_threshold)
 {
-    Grid<uint32_t> grid = *fr;
     double diffX = 100, diffY = 100;
     pixel_coordinates subFrameCenter = astroUtilities::frameCenter(windowSize, windowSize);
     uint16_t maxRepetitions = 15, nRuns = 0;
 
-    //find center and keep halving the size
+    //find center and keep moving the window on it
     while (((abs(diffX) >= 1) || (abs(diffY) >= 1)) && (nRuns <= maxRepetitions))
     {
-        uint16_t offsetX = 0, offsetY = 0;
-        Grid<uint32_t> subframe = grid.subGrid(round(guessX), round(guessY), windowSize, windowSize, &offsetX, &offsetY);
+        view_type subframe = fr.subView(round(guessX), round(guessY), windowSize, windowSize);
 
-        pixel_coordinates guess = initial_guess_momentum(&subframe, sigma_threshold, Border);
+        pixel_coordinates guess = initial_guess_momentum(subframe, sigma_threshold, Border);
         diffX = subFrameCenter.x - guess.x;
         diffY = subFrameCenter.y - guess.y;
-        guessX = guess.x + offsetX;
-        guessY = guess.y + offsetY;
+        guessX = guess.x + subframe.originX() - fr.originX();
+        guessY = guess.y + subframe.originY() - fr.originY();
+
+        nRuns++;
+    }
+
+    pixel_coordinates result = {guessX, guessY};
+    return result;
+}
+
+template <class Pixel, class Layout>
+pixel_coordinates BasicFrameProcessor<Pixel, Layout>::fine_momentum(const grid_type *fr, double guessX, double guessY, uint32_t windowSize, uint16_t sigma_threshold)
+{
+    return fine_momentum(fr->view(), guessX, guessY, windowSize, sigma_threshold);
+}
+
+/**
+ * Fine centroids of many stars, tile by tile. Each star is refined on a view of its tile grown by one window, so the
+ * windows of stars close to the tile edges are not clipped by the tile.
+ *
+ * @param fr Frame, or window of a frame
+ * @param guesses Initial positions, in window coordinates
+ * @param tileSize Side of the tiles, in pixels
+ * @param windowSize Side of the centroiding windows, in pixels
+ * @param sigma_threshold Threshold above the background, in sigmas
+ * @return Centroids, in the order of the guesses
+ */
+template <class Pixel, class Layout>
+std::vector<pixel_coordinates> BasicFrameProcessor<Pixel, Layout>::tiled_momentum(view_type fr, const std::vector<pixel_coordinates> &guesses,
+                                                                                uint32_t tileSize, uint32_t windowSize, uint16_t sigma_threshold)
+{
+    std::vector<pixel_coordinates> centroids(guesses.size());
+    if (fr.width() == 0 || fr.height() == 0 || guesses.empty())
+    {
+        return centroids;
+    }
+    tileSize = std::max<uint32_t>(tileSize, 1);
+    const uint64_t tilesX = (fr.width() + (uint64_t)tileSize - 1) / tileSize;
+
+    // Tile of each guess, clamped to the frame
+    auto tile = [&](const pixel_coordinates &guess) {
+        const uint64_t x = (uint64_t)std::min<double>(std::max(guess.x, 0.0), fr.width() - 1);
+        const uint64_t y = (uint64_t)std::min<double>(std::max(guess.y, 0.0), fr.height() - 1);
+        return (y / tileSize) * tilesX + x / tileSize;
+    };
+    std::vector<std::size_t> order(guesses.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) { return tile(guesses[a]) < tile(guesses[b]); });
+
+    // The halo covers the windows of the stars in the tile, plus the steps fine_momentum takes towards the centroid
+    const int64_t halo = windowSize;
+    for (std::size_t i = 0; i < order.size();)
+    {
+        const uint64_t current = tile(guesses[order[i]]);
+        const int64_t tileX = (current % tilesX) * tileSize, tileY = (current / tilesX) * tileSize;
+        const int64_t minX = std::max<int64_t>(tileX - halo, 0), minY = std::max<int64_t>(tileY - halo, 0);
+        const int64_t maxX = std::min<int64_t>(tileX + tileSize + halo, fr.width()), maxY = std::min<int64_t>(tileY + tileSize + halo, fr.height());
+        view_type window = fr.window(minX, minY, maxX - minX, maxY - minY);
+
+        for (; i < order.size() && tile(guesses[order[i]]) == current; i++)
+        {
+            const pixel_coordinates &guess = guesses[order[i]];
+            pixel_coordinates centroid = fine_momentum(window, guess.x - minX, guess.y - minY, windowSize, sigma_threshold);
+            centroids[order[i]] = {centroid.x + minX, centroid.y + minY};
+        }
+    }
+    return centroids;
+}
+
+// Guesses in unbinned pixels, tile and window sizes in frame pixels
+template <class Pixel, class Layout>
+std::vector<pixel_coordinates> BasicFrameProcessor<Pixel, Layout>::tiled_momentum(const std::vector<pixel_coordinates> &guesses, uint32_t tileSize,
+                                                                                uint32_t windowSize, uint16_t sigma_threshold) const
+{
+    std::vector<pixel_coordinates> binnedGuesses;
+    for (const pixel_coordinates &guess : guesses)
+    {
+        binnedGuesses.push_back(binned(guess, binning));
+    }
+    std::vector<pixel_coordinates> centroids = tiled_momentum(frame->view(), binnedGuesses, tileSize, windowSize, sigma_threshold);
+    for (pixel_coordinates &centroid : centroids)
+    {
+        centroid = unbinned(centroid, binning);
+    }
+    return centroids;
+}
+
+namespace
+{
+// Moments of the events passing the threshold, inside a window. A zero size window is the whole frame.
+pixel_coordinates eventMomentum(const EventList *events, uint16_t threshold, int64_t minX, int64_t minY, int64_t maxX, int64_t maxY, uint64_t *weight)
+{
+    double sumX = 0, sumY = 0;
+    uint64_t total = 0;
+    const uint32_t w = events->width();
+    for (const pixel_event &event : events->events)
+    {
+        int64_t x = event.pixel % w;
+        int64_t y = event.pixel / w;
+        if (x < minX || x > maxX || y < minY || y > maxY)
+        {
+            continue;
+        }
+        if (event.count + events->background(event.pixel) >= threshold)
+        {
+            sumX += (double)event.count * x;
+            sumY += (double)event.count * y;
+            total += event.count;
+        }
+    }
+
+    if (weight != NULL)
+    {
+        *weight = total;
+    }
+    // No event passes: the centre of the window, so window searches stay where they are
+    if (total == 0)
+    {
+        return {(minX + maxX) / 2.0, (minY + maxY) / 2.0};
+    }
+    pixel_coordinates centr = {sumX / total, sumY / total};
+    return centr;
+}
+} // namespace
+
+template <class Pixel, class Layout>
+uint64_t BasicFrameProcessor<Pixel, Layout>::total(const EventList *events, uint16_t threshold)
+{
+    uint64_t weight;
+    eventMomentum(events, threshold, 0, 0, events->width() - 1, events->height() - 1, &weight);
+    return weight;
+}
+
+template <class Pixel, class Layout>
+pixel_coordinates BasicFrameProcessor<Pixel, Layout>::momentum(const EventList *events, uint16_t threshold)
+{
+    return eventMomentum(events, threshold, 0, 0, events->width() - 1, events->height() - 1, NULL);
+}
+
+template <class Pixel, class Layout>
+pixel_coordinates BasicFrameProcessor<Pixel, Layout>::initial_guess_momentum(const EventList *events, uint16_t sigma_threshold)
+{
+    // The background is an expected level, not sampled, so its noise is the Poisson one
+    double background = events->background();
+    double stDev = sqrt(background);
+    uint16_t threshold = round(background + (sigma_threshold * stDev));
+    return momentum(events, threshold);
+}
 
+template <class Pixel, class Layout>
+pixel_coordinates BasicFrameProcessor<Pixel, Layout>::fine_momentum(const EventList *events, double guessX, double guessY, uint32_t windowSize, uint16_t sigma_threshold)
+{
+    double background = events->background();
+    uint16_t threshold = round(background + (sigma_threshold * sqrt(background)));
+    uint32_t half = windowSize / 2;
+    uint16_t maxRepetitions = 15, nRuns = 0;
+    double diffX = 100, diffY = 100;
+
+    // Move the window on the last guess, until it stops moving
+    while (((fabs(diffX) >= 1) || (fabs(diffY) >= 1)) && (nRuns <= maxRepetitions))
+    {
+        int64_t cx = llround(guessX);
+        int64_t cy = llround(guessY);
+        pixel_coordinates guess = eventMomentum(events, threshold, cx - half, cy - half, cx + half, cy + half, NULL);
+        diffX = guess.x - cx;
+        diffY = guess.y - cy;
+        guessX = guess.x;
+        guessY = guess.y;
         nRuns++;
     }
 
@@ -256,45 +492,46 @@ const pixel_coordinates FrameProcessor::fine_momentum(const Grid<uint32_t> *fr,
 //TODO: tests?
 //TODO: add st deviation; normal distro with no repetiotions
 
-const double FrameProcessor::backgroundLevel(const Grid<uint32_t> *fr, uint8_t method)
+template <class Pixel, class Layout>
+double BasicFrameProcessor<Pixel, Layout>::backgroundLevel(view_type fr, uint8_t method)
 {
 
-    uint64_t backgroundTotal = 0;
+    pixel_sum_t<Pixel> backgroundTotal = 0;
     double backgroundAverage = 0;
 
-    if (method == FrameProcessor::Random_Global)
+    if (method == Random_Global)
     {
-        uint32_t nPixels = (fr->height() * fr->width());
+        std::size_t nPixels = (std::size_t)fr.height() * fr.width();
         //Generate random frame positions to sample
         std::random_device rd;  //Will be used to obtain a seed for the random number engine
         std::mt19937 gen(rd()); //Standard mersenne_twister_engine seeded with rd()
-        std::uniform_int_distribution<> dis(0, nPixels - 1);
+        std::uniform_int_distribution<uint64_t> dis(0, nPixels - 1);
 
         //use one tenth of the pixels to estimate the background
-        uint32_t selectedPixelsN = (uint32_t)((double)nPixels * 0.1);
+        std::size_t selectedPixelsN = (std::size_t)((double)nPixels * 0.1);
 
-        for (int n = 0; n < selectedPixelsN; ++n)
+        for (std::size_t n = 0; n < selectedPixelsN; ++n)
         {
-            uint32_t pos = dis(gen);
-            backgroundTotal += fr->operator[](pos);
+            uint64_t pos = dis(gen);
+            backgroundTotal += fr(pos % fr.width(), pos / fr.width());
         }
         backgroundAverage = backgroundTotal / (double)selectedPixelsN;
     }
-    else if (method == FrameProcessor::Border)
+    else if (method == Border)
     {
-        uint16_t w = fr->width();
-        uint16_t h = fr->height();
-        uint32_t nPixels = 2 * w + 2 * (h - 2);
-        for (uint16_t x = 0; x < w; x++)
+        uint32_t w = fr.width();
+        uint32_t h = fr.height();
+        uint64_t nPixels = 2 * (uint64_t)w + 2 * ((uint64_t)h - 2);
+        for (uint32_t x = 0; x < w; x++)
         {
-            backgroundTotal += fr->operator()(x, 0);
-            backgroundTotal += fr->operator()(x, h - 1);
+            backgroundTotal += fr(x, 0);
+            backgroundTotal += fr(x, h - 1);
         }
 
-        for (uint16_t y = 1; y < h - 1; y++)
+        for (uint32_t y = 1; y < h - 1; y++)
         {
-            backgroundTotal += fr->operator()(0, y);
-            backgroundTotal += fr->operator()(w - 1, y);
+            backgroundTotal += fr(0, y);
+            backgroundTotal += fr(w - 1, y);
         }
 
         backgroundAverage = backgroundTotal / (double)nPixels;
@@ -303,7 +540,208 @@ const double FrameProcessor::backgroundLevel(const Grid<uint32_t> *fr, uint8_t m
     return backgroundAverage;
 }
 
-const double FrameProcessor::backgroundLevel(uint8_t method) const
+template <class Pixel, class Layout>
+double BasicFrameProcessor<Pixel, Layout>::backgroundLevel(const grid_type *fr, uint8_t method)
+{
+    return backgroundLevel(fr->view(), method);
+}
+
+template <class Pixel, class Layout>
+double BasicFrameProcessor<Pixel, Layout>::backgroundLevel(uint8_t method) const
 {
     return backgroundLevel(frame, method);
 }
+
+namespace
+{
+// Median of the values, reordering them
+template <class Pixel>
+Pixel median(std::vector<Pixel> &values)
+{
+    std::nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+    return values[values.size() / 2];
+}
+} // namespace
+
+/**
+ * Finds cosmic ray hits in a single frame with a Laplacian edge detector, similar to L.A.Cosmic, and replaces them by
+ * interpolating the closest good pixels. A pixel is a hit when its Laplacian (4 p - sum of the 4 neighbours) is both
+ * significant against the noise and larger than a star of the given FWHM could give: a sampled gaussian has
+ * L / (p - background) = 4 (1 - exp(-1 / 2 sigma^2)) at its peak, and new hits must pass it by a significant margin.
+ * Noise is the background scatter plus Poisson noise in ADUs.
+ * Every pass reads the frame row by row and only the pixels above the background are tested, so it is a single streaming
+ * sweep on mostly empty frames. Passes are repeated to peel the wings of the tracks: next to pixels already flagged, the
+ * significance threshold is lowered to 0.3 of its value, and the sharpness one to half, as the star adds to their excess.
+ *
+ * @param fr Frame, modified in place
+ * @param psfFWHM FWHM of the stars, in pixels
+ * @param sigma_threshold Significance of the Laplacian, in sigmas
+ * @param iterations Maximum number of passes
+ * @return Number of replaced pixels
+ */
+template <class Pixel, class Layout>
+uint32_t BasicFrameProcessor<Pixel, Layout>::rejectCosmicRays(Grid<Pixel> *fr, double psfFWHM, double sigma_threshold, uint16_t iterations)
+{
+    const int32_t w = fr->width();
+    const int32_t h = fr->height();
+    if (w < 3 || h < 3)
+    {
+        return 0;
+    }
+
+    // Robust background level and scatter from a strided sample
+    std::vector<Pixel> sample;
+    for (std::size_t i = 0; i < fr->size(); i += 7)
+    {
+        sample.push_back((*fr)[i]);
+    }
+    const double bg = median(sample);
+    for (Pixel &value : sample)
+    {
+        value = toPixel<Pixel>(std::abs((double)value - bg));
+    }
+    const double bgNoise = std::max(1.4826 * median(sample), 1.0);
+
+    const double psfSigma = psfFWHM / 2.3548;
+    const double sharpness = 1.5 * 4 * (1 - exp(-1 / (2 * psfSigma * psfSigma)));
+    // Noise of the Laplacian is sqrt(16 + 4) = sqrt(20) times the pixel one
+    const double laplacianScale = sqrt(20.0);
+    const double laplacianNoise = sigma_threshold * laplacianScale;
+    const double growthFraction = 0.3;
+    auto pos = [w](int32_t x, int32_t y) { return (std::size_t)y * w + x; };
+    auto inside = [w, h](int32_t x, int32_t y) { return x >= 0 && y >= 0 && x < w && y < h; };
+    const int32_t directions[4][2] = {{1, 0}, {0, 1}, {1, 1}, {1, -1}};
+
+    std::vector<uint8_t> flags(fr->size(), 0);
+    std::vector<std::size_t> hits;
+    std::vector<Pixel> neighbours;
+    uint32_t replaced = 0;
+    for (uint16_t pass = 0; pass < iterations; pass++)
+    {
+        hits.clear();
+        for (int32_t y = 1; y < h - 1; y++)
+        {
+            const Pixel *row = fr->row(y);
+            const Pixel *up = fr->row(y - 1);
+            const Pixel *down = fr->row(y + 1);
+            for (int32_t x = 1; x < w - 1; x++)
+            {
+                double excess = (double)row[x] - bg;
+                if (excess <= growthFraction * sigma_threshold * bgNoise)
+                {
+                    continue;
+                }
+                const bool growth = pass > 0 && (flags[pos(x - 1, y)] || flags[pos(x + 1, y)] || flags[pos(x, y - 1)] || flags[pos(x, y + 1)] ||
+                                                 flags[pos(x - 1, y - 1)] || flags[pos(x + 1, y - 1)] || flags[pos(x - 1, y + 1)] || flags[pos(x + 1, y + 1)]);
+                double significance = 1.0, sharpnessLimit = sharpness;
+                if (growth)
+                {
+                    significance = growthFraction;
+                    sharpnessLimit = 0.5 * sharpness;
+                }
+                else if (excess <= sigma_threshold * bgNoise)
+                {
+                    continue;
+                }
+                double laplacian = 4.0 * row[x] - (double)row[x - 1] - (double)row[x + 1] - (double)up[x] - (double)down[x];
+                // New hits must be sharper than a star by two sigmas of noise, so bright stars don't pass on a fluctuation
+                // of their peak. Growth next to a hit only needs both tests.
+                const double noise = sqrt(bgNoise * bgNoise + excess);
+                const double margin = growth ? 0.0 : 2 * laplacianScale * noise;
+                if (laplacian > significance * laplacianNoise * noise && laplacian > sharpnessLimit * excess + margin)
+                {
+                    hits.push_back(pos(x, y));
+                }
+            }
+        }
+        if (hits.empty())
+        {
+            break;
+        }
+
+        for (std::size_t hit : hits)
+        {
+            flags[hit] = 1;
+        }
+        for (std::size_t hit : hits)
+        {
+            // Linear interpolation between the closest good pixels on opposite sides, along rows, columns and diagonals.
+            // Across a track this bridges the gap evenly, also on the gradient of a star.
+            int32_t x = hit % w, y = hit / w;
+            neighbours.clear();
+            for (const int32_t *dir : directions)
+            {
+                int32_t k1 = 1, k2 = 1;
+                while (k1 <= 3 && inside(x - k1 * dir[0], y - k1 * dir[1]) && flags[pos(x - k1 * dir[0], y - k1 * dir[1])])
+                    k1++;
+                while (k2 <= 3 && inside(x + k2 * dir[0], y + k2 * dir[1]) && flags[pos(x + k2 * dir[0], y + k2 * dir[1])])
+                    k2++;
+                if (k1 > 3 || k2 > 3 || !inside(x - k1 * dir[0], y - k1 * dir[1]) || !inside(x + k2 * dir[0], y + k2 * dir[1]))
+                {
+                    continue;
+                }
+                double v1 = (*fr)[pos(x - k1 * dir[0], y - k1 * dir[1])];
+                double v2 = (*fr)[pos(x + k2 * dir[0], y + k2 * dir[1])];
+                neighbours.push_back(toPixel<Pixel>((v1 * k2 + v2 * k1) / (k1 + k2)));
+            }
+            (*fr)[hit] = neighbours.empty() ? toPixel<Pixel>(bg) : median(neighbours);
+        }
+        replaced += hits.size();
+    }
+    return replaced;
+}
+
+/**
+ * Temporal sigma clip on a sequence of frames of the same field. Each pixel is compared with its median over the sequence,
+ * with Poisson noise in ADUs, and values above median + sigma_threshold sigmas are replaced by the median.
+ * Needs at least three frames.
+ *
+ * @param frames Frames of the same size, modified in place
+ * @param sigma_threshold Clipping level, in sigmas
+ * @return Number of replaced pixels
+ */
+template <class Pixel, class Layout>
+uint32_t BasicFrameProcessor<Pixel, Layout>::rejectCosmicRays(const std::vector<Grid<Pixel> *> &frames, double sigma_threshold)
+{
+    if (frames.size() < 3)
+    {
+        return 0;
+    }
+    const std::size_t nPixels = frames[0]->size();
+    for (const Grid<Pixel> *fr : frames)
+    {
+        if (fr->width() != frames[0]->width() || fr->height() != frames[0]->height())
+        {
+            throw "Error! Frames in a sequence must have the same size";
+        }
+    }
+
+    std::vector<Pixel> values(frames.size());
+    uint32_t replaced = 0;
+    for (std::size_t i = 0; i < nPixels; i++)
+    {
+        for (std::size_t k = 0; k < frames.size(); k++)
+        {
+            values[k] = (*frames[k])[i];
+        }
+        const Pixel m = median(values);
+        const double limit = m + sigma_threshold * sqrt(std::max<double>(m, 1.0));
+        for (Grid<Pixel> *fr : frames)
+        {
+            if ((*fr)[i] > limit)
+            {
+                (*fr)[i] = m;
+                replaced++;
+            }
+        }
+    }
+    return replaced;
+}
+
+template class BasicFrameProcessor<uint16_t>;
+template class BasicFrameProcessor<uint32_t>;
+template class BasicFrameProcessor<float>;
+template class BasicFrameProcessor<uint32_t, PaddedRows<64>>;
+template class BasicFrameProcessor<uint32_t, TiledLayout<8>>;
+template class BasicFrameProcessor<uint32_t, TiledLayout<16>>;
+template class BasicFrameProcessor<uint32_t, MortonTiles<16>>;
@@ -8,56 +8,108 @@
  */
 #pragma once
 
+#include <type_traits>
+
 #include "Grid.hpp"
+#include "EventList.hpp"
 #include "typedefs.h"
 
-class FrameProcessor
+// Accumulator of reductions over pixels. Integer pixels are summed in 64 bits, floating point pixels in double.
+template <class Pixel>
+using pixel_sum_t = typename std::conditional<std::is_floating_point<Pixel>::value, double, uint64_t>::type;
+
+// Centroiding on frames of any pixel type: uint16_t detector output, uint32_t accumulated frames, float calibrated data.
+// Pixels are read in their own type and only widened in the sums. Instantiated for these three types in FrameProcessor.cpp.
+// The routines read pixels through the grid accessors, so they also run on padded and tiled layouts; FrameProcessor.cpp
+// instantiates those for uint32_t frames. Cosmic ray rejection works on packed rows only.
+template <class Pixel, class Layout = PackedRows>
+class BasicFrameProcessor
 {
 public:
+  typedef Grid<Pixel, Layout> grid_type;
+  typedef typename grid_type::const_view_type view_type;
+
   enum backgroundMethod : uint8_t
   {
     Random_Global,
     Border
   };
 
-  //Main constructor
-  FrameProcessor(const Grid<uint32_t> *const _frame) : frame(_frame)
+  //Main constructor. Frames binned on chip give their binning factor, and the object returns positions in unbinned pixels.
+  BasicFrameProcessor(const grid_type *const _frame, uint16_t _binning = 1) : frame(_frame), binning(std::max<uint16_t>(_binning, 1))
   {
 #ifdef DEBUG_MEMORY
     std::cout << "Make Frame Processor " << std::endl;
 #endif
   };
 
-  ~FrameProcessor();
-  const static pixel_coordinates momentum(const Grid<uint32_t> *fr, uint16_t threshold = 0);
-  const pixel_coordinates momentum(uint16_t threshold = 0) const;
+  ~BasicFrameProcessor();
+  // Routines on views work on the window only, allocate nothing, and return coordinates in the window. Grid versions
+  // take the whole frame.
+  static pixel_coordinates momentum(view_type fr, Pixel threshold = 0);
+  static pixel_coordinates momentum(const grid_type *fr, Pixel threshold = 0);
+  pixel_coordinates momentum(Pixel threshold = 0) const;
+
+  static pixel_coordinates initial_guess_momentum(view_type fr, uint16_t sigma_threshold = 4, uint8_t background_method = Random_Global);
+  static pixel_coordinates initial_guess_momentum(const grid_type *fr, uint16_t sigma_threshold = 4, uint8_t background_method = Random_Global);
+  pixel_coordinates initial_guess_momentum(uint16_t sigma_threshold = 4, uint8_t background_method = Random_Global) const;
 
-  const static pixel_coordinates initial_guess_momentum(const Grid<uint32_t> *fr, uint16_t sigma_threshold = 4, uint8_t background_method = Random_Global);
-  const pixel_coordinates initial_guess_momentum(uint16_t sigma_threshold = 4, uint8_t background_method = Random_Global) const;
+  pixel_coordinates multiple_guess_momentum(uint32_t minWindowSize, uint16_t sigma_threshold, uint16_t sigma_threshold_final) const;
+  static pixel_coordinates multiple_guess_momentum(view_type fr, uint32_t minWindowSize, uint16_t sigma_threshold, uint16_t sigma_threshold_final);
+  static pixel_coordinates multiple_guess_momentum(const grid_type *fr, uint32_t minWindowSize, uint16_t sigma_threshold, uint16_t sigma_threshold_final);
 
-  const pixel_coordinates multiple_guess_momentum(uint16_t minWindowSize, uint16_t sigma_threshold, uint16_t sigma_threshold_final) const;
-  const static pixel_coordinates multiple_guess_momentum(const Grid<uint32_t> *fr, uint16_t minWindowSize, uint16_t sigma_threshold, uint16_t sigma_threshold_final);
+  pixel_coordinates fine_momentum(double guessX, double guessY, uint32_t windowSize, uint16_t sigma_threshold) const;
+  static pixel_coordinates fine_momentum(view_type fr, double guessX, double guessY, uint32_t windowSize, uint16_t sigma_threshold);
+  static pixel_coordinates fine_momentum(const grid_type *fr, double guessX, double guessY, uint32_t windowSize, uint16_t sigma_threshold);
 
-  const pixel_coordinates fine_momentum(double guessX, double guessY, uint16_t windowSize, uint16_t sigma_threshold) const;
-  const static pixel_coordinates fine_momentum(const Grid<uint32_t> *fr, double guessX, double guessY, uint16_t windowSize, uint16_t sigma_threshold);
+  // Fine centroids of many stars on a large frame, one tile at a time. Guesses are grouped by tile and refined on the tile
+  // grown by a windowSize halo, so the pixels touched at once stay bounded whatever the frame size. Results follow the
+  // order of the guesses, in frame coordinates.
+  static std::vector<pixel_coordinates> tiled_momentum(view_type fr, const std::vector<pixel_coordinates> &guesses,
+                                                             uint32_t tileSize, uint32_t windowSize, uint16_t sigma_threshold);
+  std::vector<pixel_coordinates> tiled_momentum(const std::vector<pixel_coordinates> &guesses, uint32_t tileSize, uint32_t windowSize,
+                                                      uint16_t sigma_threshold) const;
 
-  uint64_t static total(const Grid<uint32_t> *fr, uint16_t threshold = 0);
-  uint64_t total(uint16_t threshold = 0) const;
+  pixel_sum_t<Pixel> static total(view_type fr, Pixel threshold = 0);
+  pixel_sum_t<Pixel> static total(const grid_type *fr, Pixel threshold = 0);
+  pixel_sum_t<Pixel> total(Pixel threshold = 0) const;
 
-  const std::vector<uint64_t> sumVertical(uint16_t threshold = 0) const;
-  const std::vector<uint64_t> sumVertical(uint16_t initialPos, uint16_t finalPos, uint16_t threshold = 0) const;
-  const static std::vector<uint64_t> sumVertical(const Grid<uint32_t> *fr, uint16_t threshold = 0);
-  const static std::vector<uint64_t> sumVertical(const Grid<uint32_t> *fr, uint16_t initialPos, uint16_t finalPos, uint16_t threshold = 0);
+  std::vector<pixel_sum_t<Pixel>> sumVertical(Pixel threshold = 0) const;
+  std::vector<pixel_sum_t<Pixel>> sumVertical(uint32_t initialPos, uint32_t finalPos, Pixel threshold = 0) const;
+  static std::vector<pixel_sum_t<Pixel>> sumVertical(const grid_type *fr, Pixel threshold = 0);
+  static std::vector<pixel_sum_t<Pixel>> sumVertical(const grid_type *fr, uint32_t initialPos, uint32_t finalPos, Pixel threshold = 0);
+  static std::vector<pixel_sum_t<Pixel>> sumVertical(view_type fr, uint32_t initialPos, uint32_t finalPos, Pixel threshold = 0);
 
-  const std::vector<uint64_t> sumHorizontal(uint16_t threshold = 0) const;
-  const std::vector<uint64_t> sumHorizontal(uint16_t initialPos, uint16_t finalPos, uint16_t threshold = 0) const;
-  const static std::vector<uint64_t> sumHorizontal(const Grid<uint32_t> *fr, uint16_t threshold = 0);
-  const static std::vector<uint64_t> sumHorizontal(const Grid<uint32_t> *fr, uint16_t initialPos, uint16_t finalPos, uint16_t threshold = 0);
+  std::vector<pixel_sum_t<Pixel>> sumHorizontal(Pixel threshold = 0) const;
+  std::vector<pixel_sum_t<Pixel>> sumHorizontal(uint32_t initialPos, uint32_t finalPos, Pixel threshold = 0) const;
+  static std::vector<pixel_sum_t<Pixel>> sumHorizontal(const grid_type *fr, Pixel threshold = 0);
+  static std::vector<pixel_sum_t<Pixel>> sumHorizontal(const grid_type *fr, uint32_t initialPos, uint32_t finalPos, Pixel threshold = 0);
+  static std::vector<pixel_sum_t<Pixel>> sumHorizontal(view_type fr, uint32_t initialPos, uint32_t finalPos, Pixel threshold = 0);
 
-  const uint32_t &operator()(unsigned int x, unsigned int y) const;
-  const double backgroundLevel(uint8_t method = Random_Global) const;
-  const static double backgroundLevel(const Grid<uint32_t> *fr, uint8_t method = Random_Global);
+  // Event list versions. Pixel values are the events plus the expected background; only pixels with events can pass a threshold.
+  // Moments are weighted by the source detections only, so the background doesn't bias them.
+  uint64_t static total(const EventList *events, uint16_t threshold = 0);
+  static pixel_coordinates momentum(const EventList *events, uint16_t threshold = 0);
+  static pixel_coordinates initial_guess_momentum(const EventList *events, uint16_t sigma_threshold = 4);
+  static pixel_coordinates fine_momentum(const EventList *events, double guessX, double guessY, uint32_t windowSize, uint16_t sigma_threshold);
+
+  // Cosmic ray rejection, in place. Hit pixels are replaced and their number returned.
+  // Single frames: Laplacian edge detection, keeping features as smooth as a psfFWHM (pixels) star. Sequences: temporal sigma clip.
+  uint32_t static rejectCosmicRays(Grid<Pixel> *fr, double psfFWHM, double sigma_threshold = 5, uint16_t iterations = 4);
+  uint32_t static rejectCosmicRays(const std::vector<Grid<Pixel> *> &frames, double sigma_threshold = 5);
+
+  const Pixel &operator()(unsigned int x, unsigned int y) const;
+  double backgroundLevel(uint8_t method = Random_Global) const;
+  static double backgroundLevel(view_type fr, uint8_t method = Random_Global);
+  static double backgroundLevel(const grid_type *fr, uint8_t method = Random_Global);
+
+  // Binned frame coordinates to unbinned pixels, and back
+  static pixel_coordinates unbinned(pixel_coordinates coordinates, uint16_t factor);
+  static pixel_coordinates binned(pixel_coordinates coordinates, uint16_t factor);
 
 private:
-  const Grid<uint32_t> *frame;
-};
\ No newline at end of file
+  const grid_type *frame;
+  uint16_t binning;
+};
+
+typedef BasicFrameProcessor<uint32_t> FrameProcessor;
\ No newline at end of file
@@ -1,24 +1,262 @@
 
 //Template used to make 2D array using 1D vector.
-//This contains an extra pixel at the end, used to store any extra information needed (depending on implementation).
+//This contains an extra pixel, kept apart from the rows, used to store any extra information needed (depending on implementation).
 ///We use it to store pixels falling outside the image.
 #pragma once
 #include <vector>
 #include <algorithm>
 #include <numeric>
+#include <limits>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
 //#include "Config/parameters.h"
 #include "typedefs.h"
 
-template <class T>
+struct PackedRows;
+
+//Non owning window on the pixels of a grid. The origin is the position of the window in the grid it was first taken
+//from, so windows of windows keep the original coordinates. Row major views point to the first pixel of the window and
+//rows are stride elements apart. Views of tiled layouts point to the start of the grid storage and find pixels by their
+//position in the grid, so they have no row pointers. Views don't check bounds.
+template <class T, class Layout = PackedRows>
+class GridView
+{
+public:
+  GridView(T *data = NULL, uint32_t w = 0, uint32_t h = 0, uint32_t stride = 0, uint32_t originX = 0, uint32_t originY = 0)
+      : p(data), w(w), h(h), s(stride), x0(originX), y0(originY) {}
+
+  //Read only view of the same window
+  operator GridView<const T, Layout>() const { return GridView<const T, Layout>(p, w, h, s, x0, y0); }
+
+  T &operator()(uint32_t x, uint32_t y) const
+  {
+    if constexpr (Layout::rowMajor)
+      return p[(std::size_t)y * s + x];
+    else
+      return p[Layout::offset(x0 + x, y0 + y, s)];
+  }
+  T *row(uint32_t y) const
+  {
+    static_assert(Layout::rowMajor, "Tiled views have no row pointers, use the accessor");
+    return p + (std::size_t)y * s;
+  }
+
+  //Same window as Grid::subGrid: odd sizes centred on the given pixel, clipped at the edges
+  GridView<T, Layout> subView(uint32_t centerX, uint32_t centerY, uint32_t width, uint32_t height) const
+  {
+    if (width == 0 || height == 0)
+      return GridView<T, Layout>(p, 0, 0, s, x0, y0);
+
+    if ((width % 2) == 0)
+      width++;
+    if ((height % 2) == 0)
+      height++;
+
+    int64_t minX = (int64_t)centerX - ((width - 1) / 2);
+    int64_t minY = (int64_t)centerY - ((height - 1) / 2);
+    int64_t maxX = std::min<int64_t>(minX + width - 1, (int64_t)w - 1);
+    int64_t maxY = std::min<int64_t>(minY + height - 1, (int64_t)h - 1);
+    minX = std::max<int64_t>(minX, 0);
+    minY = std::max<int64_t>(minY, 0);
+    if (maxX < minX || maxY < minY)
+      return GridView<T, Layout>(p, 0, 0, s, x0, y0);
+
+    return window(minX, minY, maxX - minX + 1, maxY - minY + 1);
+  }
+
+  //Window with its top left corner at (x, y). It must fit in this one.
+  GridView<T, Layout> window(uint32_t x, uint32_t y, uint32_t width, uint32_t height) const
+  {
+    if constexpr (Layout::rowMajor)
+      return GridView<T, Layout>(p + (std::size_t)y * s + x, width, height, s, x0 + x, y0 + y);
+    else
+      return GridView<T, Layout>(p, width, height, s, x0 + x, y0 + y);
+  }
+
+  unsigned int width() const { return w; }
+  unsigned int height() const { return h; }
+  unsigned int stride() const { return s; }
+  unsigned int originX() const { return x0; }
+  unsigned int originY() const { return y0; }
+
+private:
+  T *p;
+  uint32_t w, h, s, x0, y0;
+};
+
+//Allocator of Alignment byte aligned buffers, so the first row of a grid starts on a cache line
+template <class T, std::size_t Alignment = 64>
+class AlignedAllocator
+{
+public:
+  typedef T value_type;
+  template <class U>
+  struct rebind
+  {
+    typedef AlignedAllocator<U, Alignment> other;
+  };
+
+  AlignedAllocator() noexcept {}
+  template <class U>
+  AlignedAllocator(const AlignedAllocator<U, Alignment> &) noexcept {}
+
+  T *allocate(std::size_t n) { return static_cast<T *>(::operator new(n * sizeof(T), std::align_val_t(Alignment))); }
+  void deallocate(T *p, std::size_t) noexcept { ::operator delete(p, std::align_val_t(Alignment)); }
+
+  template <class U>
+  bool operator==(const AlignedAllocator<U, Alignment> &) const noexcept { return true; }
+  template <class U>
+  bool operator!=(const AlignedAllocator<U, Alignment> &) const noexcept { return false; }
+};
+
+//Layouts. A layout gives the stride of the grid (elements from one row, or band of tiles, to the next), the storage
+//size and the offset of pixel (x, y). Row major layouts have contiguous rows, so grids using them have row pointers and
+//views. Packed layouts store pixels at their linear index.
+
+//Packed rows follow each other, so pixel (x, y) is at y * w + x, same as the linear index.
+struct PackedRows
+{
+  static constexpr bool packed = true;
+  static constexpr bool rowMajor = true;
+  static uint32_t stride(uint32_t w, std::size_t) { return w; }
+  static std::size_t storage(uint32_t, uint32_t h, uint32_t s) { return (std::size_t)s * h; }
+  static std::size_t offset(uint32_t x, uint32_t y, uint32_t s) { return (std::size_t)y * s + x; }
+  template <class T>
+  static void loadRow(T *v, uint32_t y, uint32_t w, uint32_t s, const T *src) { std::copy(src, src + w, v + offset(0, y, s)); }
+  template <class T>
+  static void storeRow(const T *v, uint32_t y, uint32_t w, uint32_t s, T *dst) { std::copy(v + offset(0, y, s), v + offset(w, y, s), dst); }
+};
+
+//Padded rows start every Bytes bytes, so each row is a whole number of vectors. Linear indices are split in row and
+//column. Pixel types that don't fill a vector exactly are packed.
+template <std::size_t Bytes = 64>
+struct PaddedRows : PackedRows
+{
+  static constexpr bool packed = false;
+  static uint32_t stride(uint32_t w, std::size_t pixelSize)
+  {
+    if (pixelSize > Bytes || Bytes % pixelSize != 0)
+      return w;
+    const uint32_t lanes = Bytes / pixelSize;
+    return (w + lanes - 1) / lanes * lanes;
+  }
+};
+
+//Square Tile x Tile blocks, stored one after the other a band of tiles at a time. Pixels are row major inside a tile, so
+//a window touches a few whole blocks instead of one line per row, and columns stride by Tile only. The grid is padded
+//to whole tiles; the stride is the padded width.
+template <uint32_t Tile = 8>
+struct TiledLayout
+{
+  static_assert(Tile > 0 && (Tile & (Tile - 1)) == 0, "Tiles must be a power of two");
+  static constexpr bool packed = false;
+  static constexpr bool rowMajor = false;
+  static uint32_t stride(uint32_t w, std::size_t) { return (w + Tile - 1) / Tile * Tile; }
+  static std::size_t storage(uint32_t, uint32_t h, uint32_t s) { return (std::size_t)s * ((h + Tile - 1) / Tile * Tile); }
+  static std::size_t offset(uint32_t x, uint32_t y, uint32_t s)
+  {
+    return (std::size_t)(y / Tile) * s * Tile + (std::size_t)(x / Tile) * Tile * Tile + (y % Tile) * Tile + x % Tile;
+  }
+  //A row crosses the tiles in Tile long runs
+  template <class T>
+  static void loadRow(T *v, uint32_t y, uint32_t w, uint32_t s, const T *src)
+  {
+    for (uint32_t x = 0; x < w; x += Tile)
+      std::copy(src + x, src + std::min(x + Tile, w), v + offset(x, y, s));
+  }
+  template <class T>
+  static void storeRow(const T *v, uint32_t y, uint32_t w, uint32_t s, T *dst)
+  {
+    for (uint32_t x = 0; x < w; x += Tile)
+    {
+      const T *run = v + offset(x, y, s);
+      std::copy(run, run + (std::min(x + Tile, w) - x), dst + x);
+    }
+  }
+};
+
+//Tiles as above, with pixels in Z order inside each tile: the bits of x and y are interleaved, so any aligned square
+//of the tile is contiguous, down to 2x2.
+template <uint32_t Tile = 16>
+struct MortonTiles : TiledLayout<Tile>
+{
+  static_assert(Tile <= 256, "Morton tiles interleave 8 bit coordinates");
+  static std::size_t offset(uint32_t x, uint32_t y, uint32_t s)
+  {
+    return (std::size_t)(y / Tile) * s * Tile + (std::size_t)(x / Tile) * Tile * Tile + (spread(x % Tile) | (spread(y % Tile) << 1));
+  }
+  template <class T>
+  static void loadRow(T *v, uint32_t y, uint32_t w, uint32_t s, const T *src)
+  {
+    for (uint32_t x = 0; x < w; x++)
+      v[offset(x, y, s)] = src[x];
+  }
+  template <class T>
+  static void storeRow(const T *v, uint32_t y, uint32_t w, uint32_t s, T *dst)
+  {
+    for (uint32_t x = 0; x < w; x++)
+      dst[x] = v[offset(x, y, s)];
+  }
+
+private:
+  //Bits of an 8 bit value moved to the even bits
+  static uint32_t spread(uint32_t a)
+  {
+    a = (a | (a << 4)) & 0x0F0F;
+    a = (a | (a << 2)) & 0x3333;
+    return (a | (a << 1)) & 0x5555;
+  }
+};
+
+//Access policies. Checked access throws std::out_of_range like vector::at, unchecked access is a plain load.
+struct CheckedAccess
+{
+  static void check(std::size_t pos, std::size_t size)
+  {
+    if (pos >= size)
+      throw std::out_of_range("Grid index out of range");
+  }
+};
+
+struct UncheckedAccess
+{
+  static void check(std::size_t, std::size_t) {}
+};
+
+//Debug builds check every access. Release builds (NDEBUG) don't, unless GRID_CHECKED is defined.
+#if defined(GRID_CHECKED) || !defined(NDEBUG)
+typedef CheckedAccess DefaultAccess;
+#else
+typedef UncheckedAccess DefaultAccess;
+#endif
+
+//Storage comes from the Allocator: aligned heap buffers by default, or the arenas and mappings of GridStorage.hpp
+template <class T, class Layout = PackedRows, class Access = DefaultAccess, class Allocator = AlignedAllocator<T>>
 class Grid
 {
 public:
-  Grid(uint16_t w = 0, uint16_t h = 0) : w(w), h(h), extraPixPosition(w * h), v(w * h + 1)
+  Grid(uint32_t w = 0, uint32_t h = 0) : w(w), h(h), s(Layout::stride(w, sizeof(T))), v(Layout::storage(w, h, s)), extra()
   {
 #ifdef DEBUG_MEMORY
     std::cout << "Created Grid " << std::endl;
 #endif
   }
+  Grid(uint32_t w, uint32_t h, const Allocator &allocator)
+      : w(w), h(h), s(Layout::stride(w, sizeof(T))), v(Layout::storage(w, h, s), allocator), extra()
+  {
+#ifdef DEBUG_MEMORY
+    std::cout << "Created Grid " << std::endl;
+#endif
+  }
+
+  //Copy of a grid with another layout, access policy or allocator
+  template <class OtherLayout, class OtherAccess, class OtherAllocator>
+  explicit Grid(const Grid<T, OtherLayout, OtherAccess, OtherAllocator> &other, const Allocator &allocator = Allocator())
+      : Grid(0, 0, allocator)
+  {
+    assign(other);
+  }
 
   ~Grid()
   {
@@ -27,93 +265,214 @@ public:
 #endif
   }
 
-  T &operator()(uint16_t x, uint16_t y) { return v.at((y * w) + x); }
-  const T &operator()(uint16_t x, uint16_t y) const { return v.at((y * w) + x); }
+  T &operator()(uint32_t x, uint32_t y)
+  {
+    Access::check(x, w);
+    Access::check(y, h);
+    return v[Layout::offset(x, y, s)];
+  }
+  const T &operator()(uint32_t x, uint32_t y) const
+  {
+    Access::check(x, w);
+    Access::check(y, h);
+    return v[Layout::offset(x, y, s)];
+  }
 
-  T &operator[](uint32_t pos) { return v.at(pos); }
-  const T &operator[](uint32_t pos) const { return v.at(pos); }
+  //Linear index, y * width + x, whatever the layout
+  T &operator[](std::size_t pos)
+  {
+    Access::check(pos, size());
+    return v[index(pos)];
+  }
+  const T &operator[](std::size_t pos) const
+  {
+    Access::check(pos, size());
+    return v[index(pos)];
+  }
 
-  void reserve(uint16_t w_, uint16_t h_) { v.reserve(w_ * h_ + 1); }
-  void resize(uint16_t w_, uint16_t h_)
+  //The pixel outside the grid
+  T &extraPixel() { return extra; }
+  const T &extraPixel() const { return extra; }
+
+  void reserve(uint32_t w_, uint32_t h_) { v.reserve(Layout::storage(w_, h_, Layout::stride(w_, sizeof(T)))); }
+  void resize(uint32_t w_, uint32_t h_)
   {
-    v.resize(w_ * h_ + 1);
     w = w_;
     h = h_;
-    extraPixPosition = w * h;
+    s = Layout::stride(w, sizeof(T));
+    v.resize(Layout::storage(w, h, s));
   }
 
-  auto begin() const { return v.begin(); }
-  auto end() const { return v.end(); }
-  auto size() { return v.size(); }
-  T max() { return *std::max_element(begin(), end()); }
-  T min() { return *std::min_element(begin(), end()); }
-  T total()
+  //Row y to and from row major buffers of width pixels, whatever the layout. Used to convert layouts and for I/O.
+  void setRow(uint32_t y, const T *src)
+  {
+    Access::check(y, h);
+    Layout::loadRow(v.data(), y, w, s, src);
+  }
+  void getRow(uint32_t y, T *dst) const
+  {
+    Access::check(y, h);
+    Layout::storeRow(v.data(), y, w, s, dst);
+  }
+  //Same pixels and extra pixel as other, a row at a time
+  template <class OtherLayout, class OtherAccess, class OtherAllocator>
+  void assign(const Grid<T, OtherLayout, OtherAccess, OtherAllocator> &other)
+  {
+    resize(other.width(), other.height());
+    std::fill(v.begin(), v.end(), T());
+    if constexpr (OtherLayout::rowMajor)
+    {
+      for (uint32_t y = 0; y < h; y++)
+        setRow(y, other.row(y));
+    }
+    else
+    {
+      std::vector<T> buffer(w);
+      for (uint32_t y = 0; y < h; y++)
+      {
+        other.getRow(y, buffer.data());
+        setRow(y, buffer.data());
+      }
+    }
+    extra = other.extraPixel();
+  }
+
+  //Iterators go through the storage, padding included, so only packed grids have them
+  auto begin() const
+  {
+    static_assert(Layout::packed, "Padded grids have no pixel iterators, use rows");
+    return v.begin();
+  }
+  auto end() const
+  {
+    static_assert(Layout::packed, "Padded grids have no pixel iterators, use rows");
+    return v.end();
+  }
+  //Number of pixels, without the extra pixel
+  std::size_t size() const { return (std::size_t)w * h; }
+  //Reductions skip padding. Tiled grids go pixel by pixel.
+  T max() const
+  {
+    T m = std::numeric_limits<T>::lowest();
+    if constexpr (Layout::rowMajor)
+    {
+      for (uint32_t y = 0; y < h; y++)
+        m = std::max(m, *std::max_element(row(y), row(y) + w));
+    }
+    else
+    {
+      for (uint32_t y = 0; y < h; y++)
+        for (uint32_t x = 0; x < w; x++)
+          m = std::max(m, v[Layout::offset(x, y, s)]);
+    }
+    return m;
+  }
+  T min() const
+  {
+    T m = std::numeric_limits<T>::max();
+    if constexpr (Layout::rowMajor)
+    {
+      for (uint32_t y = 0; y < h; y++)
+        m = std::min(m, *std::min_element(row(y), row(y) + w));
+    }
+    else
+    {
+      for (uint32_t y = 0; y < h; y++)
+        for (uint32_t x = 0; x < w; x++)
+          m = std::min(m, v[Layout::offset(x, y, s)]);
+    }
+    return m;
+  }
+  T total() const
   {
-    return std::accumulate(v.begin(), v.end(), 0.0);
+    double sum = 0.0;
+    if constexpr (Layout::rowMajor)
+    {
+      for (uint32_t y = 0; y < h; y++)
+        sum = std::accumulate(row(y), row(y) + w, sum);
+    }
+    else
+    {
+      for (uint32_t y = 0; y < h; y++)
+        for (uint32_t x = 0; x < w; x++)
+          sum += v[Layout::offset(x, y, s)];
+    }
+    return sum;
+  }
+  void reset()
+  {
+    std::fill(v.begin(), v.end(), T());
+    extra = T();
+  }
+  void clear()
+  {
+    v.clear();
+    w = h = s = 0;
   }
-  void reset() { std::fill(v.begin(), v.end(), 0); }
-  void clear() { v.clear(); }
 
-  //might need to delete following line.
-  std::vector<T> &vector()
+  T *data() { return v.data(); }
+  const T *data() const { return v.data(); }
+  //Row pointers need contiguous rows. Tiled grids use getRow, or convert to a row major grid first.
+  T *row(uint32_t y)
+  {
+    static_assert(Layout::rowMajor, "Tiled grids have no row pointers, use getRow");
+    return v.data() + (std::size_t)y * s;
+  }
+  const T *row(uint32_t y) const
   {
-    return v;
+    static_assert(Layout::rowMajor, "Tiled grids have no row pointers, use getRow");
+    return v.data() + (std::size_t)y * s;
   }
 
+  //Views of the whole grid, without the extra pixel. Row major layouts share the PackedRows view, with their stride.
+  typedef GridView<T, typename std::conditional<Layout::rowMajor, PackedRows, Layout>::type> view_type;
+  typedef GridView<const T, typename std::conditional<Layout::rowMajor, PackedRows, Layout>::type> const_view_type;
+  view_type view() { return view_type(v.data(), w, h, s); }
+  const_view_type view() const { return const_view_type(v.data(), w, h, s); }
+
   //TODO: might be better to return a smart pointer?
 
-  //This returns a subgrid. Also, increments the offset values passed, to keep track of original coordinates
-  Grid<T> subGrid(uint16_t centerX, uint16_t centerY, uint16_t width, uint16_t height, uint16_t *resultOffsetX = NULL, uint16_t *resultOffsetY = NULL)
+  //This returns a copy of a subgrid. Also, increments the offset values passed, to keep track of original coordinates
+  Grid subGrid(uint32_t centerX, uint32_t centerY, uint32_t width, uint32_t height, uint32_t *resultOffsetX = NULL, uint32_t *resultOffsetY = NULL) const
   {
-    if (width == 0 || height == 0)
+    const_view_type window = view().subView(centerX, centerY, width, height);
+    if (window.width() == 0)
     {
-      (*resultOffsetX) = 0;
-      (*resultOffsetY) = 0;
-      return Grid<T>(1, 1);
+      if (resultOffsetX != NULL)
+        (*resultOffsetX) = 0;
+      if (resultOffsetY != NULL)
+        (*resultOffsetY) = 0;
+      return Grid(1, 1);
     }
 
-    //if even size, we can't have a center pixel. Make it odd
-    if ((width % 2) == 0)
-      width++;
-    if ((height % 2) == 0)
-      height++;
-
-    int32_t minX = (int32_t)centerX - ((width - 1) / 2);
-    int32_t minY = (int32_t)centerY - ((height - 1) / 2);
-    int32_t maxX = minX + width - 1;
-    int32_t maxY = minY + height - 1;
-
-    if (minX < 0)
-      minX = 0;
-    if (minY < 0)
-      minY = 0;
-    if (maxX >= w)
-      maxX = w - 1;
-    if (maxY >= h)
-      maxY = h - 1;
-
-    width = (maxX - minX) + 1;
-    height = (maxY - minY) + 1;
-    Grid<T> subGrid = Grid<T>(width, height);
-
-    for (uint16_t x = 0; x < width; x++)
+    Grid subGrid(window.width(), window.height());
+    for (uint32_t y = 0; y < window.height(); y++)
     {
-      for (uint16_t y = 0; y < height; y++)
-      {
-        subGrid(x, y) = operator()(x + minX, y + minY);
-      }
+      std::copy(window.row(y), window.row(y) + window.width(), subGrid.row(y));
     }
 
-    *resultOffsetX += (uint16_t)minX;
-    *resultOffsetY += (uint16_t)minY;
+    if (resultOffsetX != NULL)
+      *resultOffsetX += window.originX();
+    if (resultOffsetY != NULL)
+      *resultOffsetY += window.originY();
     return subGrid;
   }
 
   unsigned int width() const { return w; }
   unsigned int height() const { return h; }
-  unsigned int extraPixPos() const { return extraPixPosition; };
+  //Elements from one row to the next
+  unsigned int stride() const { return s; }
 
 private:
-  uint32_t w, h, extraPixPosition;
-  std::vector<T> v;
-};
\ No newline at end of file
+  uint32_t w, h, s;
+  std::vector<T, Allocator> v;
+  T extra;
+
+  std::size_t index(std::size_t pos) const
+  {
+    if constexpr (Layout::packed)
+      return pos;
+    else
+      return Layout::offset(pos % w, pos / w, s);
+  }
+};
@@ -0,0 +1,185 @@
+/**
+ * Twinkle FGS-Sim: Centroid recovery simulation
+ *
+ * @file GridStorage.cpp
+ * @brief Thread arenas, mapped files and shared memory for grids
+ * @author Claudio Arena
+ * @version 1.0.0 2026-10-18
+ * @description The arena hands out aligned slices of its current chunk and moves to the next chunk, or a new one,
+ * when a slice doesn't fit. Mapped storage grows the file or object to the size asked for and maps it shared; a grid
+ * reallocating maps the storage again and copies the pixels onto themselves before the old mapping goes.
+ */
+
+#include <algorithm>
+#include <iostream>
+#include <new>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "GridStorage.hpp"
+
+Arena::Arena(std::size_t _chunkBytes) : chunkBytes(std::max<std::size_t>(_chunkBytes, 4096))
+{
+}
+
+Arena::~Arena()
+{
+    for (Block &block : blocks)
+    {
+        ::operator delete(block.data, std::align_val_t(64));
+    }
+#ifdef DEBUG_MEMORY
+    std::cout << "Destroyed Arena " << std::endl;
+#endif
+}
+
+Arena &Arena::local()
+{
+    thread_local Arena arena;
+    return arena;
+}
+
+char *Arena::newBlock(std::size_t bytes)
+{
+    return static_cast<char *>(::operator new(bytes, std::align_val_t(64)));
+}
+
+/**
+ * Slice of the arena, valid until the arena is rolled back past it.
+ *
+ * @param bytes Size of the slice
+ * @param alignment Alignment of the slice, a power of two up to 64
+ */
+void *Arena::allocate(std::size_t bytes, std::size_t alignment)
+{
+    while (current < blocks.size())
+    {
+        const std::size_t start = (offset + alignment - 1) & ~(alignment - 1);
+        if (start + bytes <= blocks[current].size)
+        {
+            offset = start + bytes;
+            return blocks[current].data + start;
+        }
+        current++;
+        offset = 0;
+    }
+
+    const std::size_t size = std::max(chunkBytes, bytes);
+    blocks.push_back({newBlock(size), size});
+    current = blocks.size() - 1;
+    offset = bytes;
+    return blocks[current].data;
+}
+
+void Arena::rollback(std::size_t chunk, std::size_t _offset)
+{
+    current = chunk;
+    offset = _offset;
+
+    // Empty arena: merge the chunks, so the next round fits in one
+    if (current == 0 && offset == 0 && blocks.size() > 1)
+    {
+        std::size_t size = 0;
+        for (Block &block : blocks)
+        {
+            size += block.size;
+            ::operator delete(block.data, std::align_val_t(64));
+        }
+        blocks.assign(1, {newBlock(size), size});
+    }
+}
+
+std::size_t Arena::used() const
+{
+    std::size_t bytes = offset;
+    for (std::size_t i = 0; i < current && i < blocks.size(); i++)
+    {
+        bytes += blocks[i].size;
+    }
+    return bytes;
+}
+
+std::size_t Arena::capacity() const
+{
+    std::size_t bytes = 0;
+    for (const Block &block : blocks)
+    {
+        bytes += block.size;
+    }
+    return bytes;
+}
+
+MappedStorage::MappedStorage(int _fd, std::string _name, bool _unlink) : fd(_fd), name(_name), unlinkOnClose(_unlink)
+{
+}
+
+MappedStorage::~MappedStorage()
+{
+    close(fd);
+    if (unlinkOnClose)
+    {
+        shm_unlink(name.c_str());
+    }
+#ifdef DEBUG_MEMORY
+    std::cout << "Destroyed MappedStorage " << std::endl;
+#endif
+}
+
+std::shared_ptr<MappedStorage> MappedStorage::file(const std::string &path)
+{
+    int fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+    {
+        throw "Error! Could not open the file to map";
+    }
+    return std::shared_ptr<MappedStorage>(new MappedStorage(fd, path, false));
+}
+
+std::shared_ptr<MappedStorage> MappedStorage::sharedMemory(const std::string &name, bool unlink)
+{
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT, 0600);
+    if (fd < 0)
+    {
+        throw "Error! Could not open the shared memory object";
+    }
+    return std::shared_ptr<MappedStorage>(new MappedStorage(fd, name, unlink));
+}
+
+std::size_t MappedStorage::size() const
+{
+    struct stat info;
+    if (fstat(fd, &info) != 0)
+    {
+        throw "Error! Could not read the size of mapped storage";
+    }
+    return info.st_size;
+}
+
+void *MappedStorage::map(std::size_t bytes)
+{
+    if (bytes == 0)
+    {
+        return NULL;
+    }
+    if (size() < bytes && ftruncate(fd, bytes) != 0)
+    {
+        throw "Error! Could not grow mapped storage";
+    }
+    void *p = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED)
+    {
+        throw "Error! Could not map storage";
+    }
+    return p;
+}
+
+void MappedStorage::unmap(void *p, std::size_t bytes)
+{
+    if (p != NULL)
+    {
+        munmap(p, bytes);
+    }
+}
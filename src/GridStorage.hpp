@@ -0,0 +1,203 @@
+/**
+ * Twinkle FGS-Sim: Centroid recovery simulation
+ *
+ * @file GridStorage.hpp
+ * @brief Header file for Grid allocators: thread arenas, mapped files and shared memory
+ * @author Claudio Arena
+ * @version 1.0.0 2026-10-18
+ */
+#pragma once
+
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "Grid.hpp"
+
+/**
+ * Bump allocator on a few large chunks. Allocating moves a pointer and freeing does nothing; memory comes back all at
+ * once, when a Scope ends or on reset. Chunks are kept, and merged in a single one when the arena is empty, so a loop
+ * doing the same allocations each iteration stops allocating after the first one.
+ * Each thread has its own arena, so no locking is needed.
+ *
+ * @brief Per thread bump arena for short lived grids
+ */
+class Arena
+{
+public:
+  // Marks the arena and rolls it back to the mark when it goes out of scope. Scopes must nest, and grids allocated in
+  // a scope must not outlive it.
+  class Scope
+  {
+  public:
+    Scope(Arena &_arena = Arena::local()) : arena(_arena), chunk(_arena.current), offset(_arena.offset) {}
+    ~Scope() { arena.rollback(chunk, offset); }
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+  private:
+    Arena &arena;
+    std::size_t chunk, offset;
+  };
+
+  Arena(std::size_t _chunkBytes = 16 << 20);
+  ~Arena();
+  Arena(const Arena &) = delete;
+  Arena &operator=(const Arena &) = delete;
+
+  // Arena of the calling thread
+  static Arena &local();
+
+  void *allocate(std::size_t bytes, std::size_t alignment);
+  // Releases everything allocated so far. Nothing allocated from the arena may be used afterwards.
+  void reset() { rollback(0, 0); }
+
+  // Bytes in use, and bytes held in chunks
+  std::size_t used() const;
+  std::size_t capacity() const;
+  std::size_t chunks() const { return blocks.size(); }
+
+private:
+  struct Block
+  {
+    char *data;
+    std::size_t size;
+  };
+  std::vector<Block> blocks;
+  std::size_t chunkBytes;
+  std::size_t current = 0, offset = 0;
+
+  void rollback(std::size_t chunk, std::size_t _offset);
+  static char *newBlock(std::size_t bytes);
+};
+
+// Allocator of grids in an arena, by default the one of the constructing thread
+template <class T>
+class ArenaAllocator
+{
+public:
+  typedef T value_type;
+  template <class U>
+  struct rebind
+  {
+    typedef ArenaAllocator<U> other;
+  };
+
+  ArenaAllocator() noexcept : arena(&Arena::local()) {}
+  explicit ArenaAllocator(Arena &_arena) noexcept : arena(&_arena) {}
+  template <class U>
+  ArenaAllocator(const ArenaAllocator<U> &other) noexcept : arena(other.arena) {}
+
+  T *allocate(std::size_t n) { return static_cast<T *>(arena->allocate(n * sizeof(T), std::max<std::size_t>(alignof(T), 64))); }
+  void deallocate(T *, std::size_t) noexcept {}
+
+  template <class U>
+  bool operator==(const ArenaAllocator<U> &other) const noexcept { return arena == other.arena; }
+  template <class U>
+  bool operator!=(const ArenaAllocator<U> &other) const noexcept { return arena != other.arena; }
+
+private:
+  template <class U>
+  friend class ArenaAllocator;
+  Arena *arena;
+};
+
+/**
+ * File or POSIX shared memory object mapped in memory, shared, so pixels written to a grid go straight to the file or
+ * to the other processes mapping the object. The storage holds the grid storage only, with no header: row major
+ * pixels for PackedRows. The extra pixel stays in memory.
+ * Mapping an existing file or object keeps its contents, so a grid can be reopened on it.
+ *
+ * @brief Backing of grids in files and shared memory
+ */
+class MappedStorage
+{
+public:
+  // Opens or creates the file
+  static std::shared_ptr<MappedStorage> file(const std::string &path);
+  // Opens or creates the shared memory object name, "/fgs-frame" style. With unlink set the object is removed when
+  // the storage is destroyed; processes that mapped it keep their mapping.
+  static std::shared_ptr<MappedStorage> sharedMemory(const std::string &name, bool unlink = false);
+  ~MappedStorage();
+  MappedStorage(const MappedStorage &) = delete;
+  MappedStorage &operator=(const MappedStorage &) = delete;
+
+  // Maps the first bytes of the storage, growing it if needed
+  void *map(std::size_t bytes);
+  void unmap(void *p, std::size_t bytes);
+  std::size_t size() const;
+
+private:
+  MappedStorage(int _fd, std::string _name, bool _unlink);
+  int fd;
+  std::string name;
+  bool unlinkOnClose;
+};
+
+// Allocator of grids on a MappedStorage. Default constructed allocators use the heap, and copies of mapped grids are
+// heap grids, so two grids never share a mapping by accident.
+template <class T>
+class MappedAllocator
+{
+public:
+  typedef T value_type;
+  typedef std::true_type propagate_on_container_move_assignment;
+  typedef std::true_type propagate_on_container_swap;
+  template <class U>
+  struct rebind
+  {
+    typedef MappedAllocator<U> other;
+  };
+
+  MappedAllocator() noexcept {}
+  explicit MappedAllocator(std::shared_ptr<MappedStorage> _storage) noexcept : storage(_storage) {}
+  template <class U>
+  MappedAllocator(const MappedAllocator<U> &other) noexcept : storage(other.storage) {}
+  MappedAllocator select_on_container_copy_construction() const { return MappedAllocator(); }
+
+  T *allocate(std::size_t n)
+  {
+    if (!storage)
+      return AlignedAllocator<T>().allocate(n);
+    return static_cast<T *>(storage->map(n * sizeof(T)));
+  }
+  void deallocate(T *p, std::size_t n) noexcept
+  {
+    if (!storage)
+      AlignedAllocator<T>().deallocate(p, n);
+    else
+      storage->unmap(p, n * sizeof(T));
+  }
+
+  // Mapped pixels are default initialised, so the contents of the storage are kept. New storage reads as zero.
+  template <class U>
+  void construct(U *p)
+  {
+    if (storage)
+      ::new ((void *)p) U;
+    else
+      ::new ((void *)p) U();
+  }
+  template <class U, class... Args>
+  void construct(U *p, Args &&...args)
+  {
+    ::new ((void *)p) U(std::forward<Args>(args)...);
+  }
+
+  template <class U>
+  bool operator==(const MappedAllocator<U> &other) const noexcept { return storage == other.storage; }
+  template <class U>
+  bool operator!=(const MappedAllocator<U> &other) const noexcept { return storage != other.storage; }
+
+private:
+  template <class U>
+  friend class MappedAllocator;
+  std::shared_ptr<MappedStorage> storage;
+};
+
+// Grids on the thread arena, and on mapped storage
+template <class T, class Layout = PackedRows>
+using ArenaGrid = Grid<T, Layout, DefaultAccess, ArenaAllocator<T>>;
+template <class T, class Layout = PackedRows>
+using MappedGrid = Grid<T, Layout, DefaultAccess, MappedAllocator<T>>;
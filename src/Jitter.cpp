@@ -0,0 +1,261 @@
+/**
+ * Twinkle FGS-Sim: Centroid recovery simulation
+ *
+ * @file Jitter.cpp
+ * @brief Pointing jitter time series from a power spectral density
+ * @author Claudio Arena
+ * @version 1.0.0 2026-10-18
+ * @description The series is built by giving each frequency bin of a Hermitian spectrum a random gaussian amplitude with variance
+ * PSD(f) df, and transforming back. The variance of the series is then the integral of the PSD up to the Nyquist frequency.
+ * The series is linearly interpolated between samples, and its running integral is stored, so the mean offset over any window
+ * costs two lookups.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+#include "Jitter.hpp"
+#include "FFT.hpp"
+
+/**
+ * Constructs a Jitter object, synthesising both axes.
+ *
+ * @param psdX Power spectral density of the x offsets, in arcsec^2/Hz
+ * @param psdY Power spectral density of the y offsets, in arcsec^2/Hz
+ * @param _sampleRate Samples per second
+ * @param _duration Minimum length of the series, in seconds. Rounded up to a power of two samples
+ * @param seed Seed for the random generator. 0 to seed from the clock
+ */
+Jitter::Jitter(PSD psdX, PSD psdY, double _sampleRate, double _duration, uint32_t seed) : fs(_sampleRate)
+{
+    if (fs <= 0 || _duration <= 0)
+    {
+        throw "Error! Jitter sample rate and duration must be positive";
+    }
+
+    if (seed == 0)
+    {
+        seed = std::chrono::system_clock::now().time_since_epoch().count();
+    }
+    std::mt19937 generator(seed);
+
+    n = fft::nextPowerOfTwo(std::max<uint32_t>(2, (uint32_t)std::ceil(_duration * fs)));
+    xSeries = synthesise(psdX, n, fs, generator);
+    ySeries = synthesise(psdY, n, fs, generator);
+    xIntegral = integrate(xSeries, fs);
+    yIntegral = integrate(ySeries, fs);
+}
+
+Jitter::~Jitter()
+{
+#ifdef DEBUG_MEMORY
+    std::cout << "Destroyed Jitter " << std::endl;
+#endif
+}
+
+/**
+ * White noise, flat up to the bandwidth
+ *
+ * @param rms RMS of the offsets, in arcsec
+ * @param bandwidth Frequency where the spectrum stops, in Hz. Usually the Nyquist frequency of the series
+ */
+Jitter::PSD Jitter::white(double rms, double bandwidth)
+{
+    double level = rms * rms / bandwidth;
+    return [level, bandwidth](double f) { return (f <= bandwidth) ? level : 0.0; };
+}
+
+/**
+ * Power law drift, amplitude * f^-index, flat below the minimum frequency
+ *
+ * @param amplitude PSD at 1 Hz, in arcsec^2/Hz
+ * @param index Spectral index. 1 for 1/f noise, 2 for a random walk
+ * @param minFrequency Frequency below which the spectrum is flat, in Hz
+ */
+Jitter::PSD Jitter::powerLaw(double amplitude, double index, double minFrequency)
+{
+    return [amplitude, index, minFrequency](double f) { return amplitude * pow(std::max(f, minFrequency), -index); };
+}
+
+/**
+ * Narrow line, e.g. a reaction wheel harmonic, with a gaussian profile
+ *
+ * @param frequency Centre of the line, in Hz
+ * @param rms RMS of the offsets due to the line, in arcsec
+ * @param width Standard deviation of the line profile, in Hz
+ */
+Jitter::PSD Jitter::harmonic(double frequency, double rms, double width)
+{
+    double A = rms * rms / (sqrt(2 * M_PI) * width);
+    return [A, frequency, width](double f) { return A * exp(-pow(f - frequency, 2) / (2 * width * width)); };
+}
+
+/**
+ * Tabulated spectrum, interpolated in log-log space and zero outside the table
+ *
+ * @param frequency Frequencies, in Hz, increasing and positive
+ * @param psd PSD at each frequency, in arcsec^2/Hz, positive
+ */
+Jitter::PSD Jitter::table(std::vector<double> frequency, std::vector<double> psd)
+{
+    if (frequency.size() != psd.size() || frequency.size() < 2)
+    {
+        throw "Error! Jitter PSD table needs matching frequency and PSD columns, with at least two rows";
+    }
+
+    return [frequency, psd](double f) {
+        if (f < frequency.front() || f > frequency.back())
+            return 0.0;
+        std::size_t i = std::upper_bound(frequency.begin(), frequency.end(), f) - frequency.begin();
+        i = std::min(std::max<std::size_t>(i, 1), frequency.size() - 1);
+        double a = log(f / frequency[i - 1]) / log(frequency[i] / frequency[i - 1]);
+        return exp(log(psd[i - 1]) * (1 - a) + log(psd[i]) * a);
+    };
+}
+
+Jitter::PSD Jitter::sum(std::vector<PSD> psds)
+{
+    return [psds](double f) {
+        double total = 0;
+        for (const PSD &psd : psds)
+        {
+            total += psd(f);
+        }
+        return total;
+    };
+}
+
+/**
+ * Offset at a given time, linearly interpolated between samples
+ *
+ * @param time Time, in seconds
+ * @return Offset in x and y, in arcsec
+ */
+pixel_coordinates Jitter::offset(double time) const
+{
+    return {interpolate(xSeries, time), interpolate(ySeries, time)};
+}
+
+/**
+ * Mean offset over a time window, e.g. an exposure or a sub-exposure slice
+ *
+ * @param startTime Start of the window, in seconds
+ * @param endTime End of the window, in seconds
+ * @return Mean offset in x and y, in arcsec
+ */
+pixel_coordinates Jitter::meanOffset(double startTime, double endTime) const
+{
+    if (endTime <= startTime)
+    {
+        return offset(startTime);
+    }
+    double dt = endTime - startTime;
+    return {(integral(xSeries, xIntegral, endTime) - integral(xSeries, xIntegral, startTime)) / dt,
+            (integral(ySeries, yIntegral, endTime) - integral(ySeries, yIntegral, startTime)) / dt};
+}
+
+/**
+ * Mean offsets over consecutive slices of equal length
+ *
+ * @param startTime Start of the first slice, in seconds
+ * @param sliceTime Length of each slice, in seconds
+ * @param nSlices Number of slices
+ * @param out Array of nSlices offsets, in arcsec
+ */
+void Jitter::meanOffsets(double startTime, double sliceTime, uint32_t nSlices, pixel_coordinates *out) const
+{
+    double previousX = integral(xSeries, xIntegral, startTime);
+    double previousY = integral(ySeries, yIntegral, startTime);
+    for (uint32_t i = 0; i < nSlices; i++)
+    {
+        double t = startTime + (i + 1) * sliceTime;
+        double currentX = integral(xSeries, xIntegral, t);
+        double currentY = integral(ySeries, yIntegral, t);
+        if (sliceTime > 0)
+        {
+            out[i] = {(currentX - previousX) / sliceTime, (currentY - previousY) / sliceTime};
+        }
+        else
+        {
+            out[i] = offset(t);
+        }
+        previousX = currentX;
+        previousY = currentY;
+    }
+}
+
+/**
+ * RMS of the series about zero, in arcsec
+ */
+pixel_coordinates Jitter::rms() const
+{
+    double sx = 0, sy = 0;
+    for (std::size_t i = 0; i < n; i++)
+    {
+        sx += xSeries[i] * xSeries[i];
+        sy += ySeries[i] * ySeries[i];
+    }
+    return {sqrt(sx / n), sqrt(sy / n)};
+}
+
+std::vector<double> Jitter::synthesise(PSD psd, std::size_t n, double fs, std::mt19937 &generator)
+{
+    std::normal_distribution<double> normal(0.0, 1.0);
+    std::vector<fft::complex> spectrum(n, fft::complex(0, 0));
+    const double df = fs / n;
+
+    for (std::size_t k = 1; k < n / 2; k++)
+    {
+        // Each bin and its mirror share the variance PSD(f) df
+        double amplitude = sqrt(std::max(psd(k * df), 0.0) * df / 4);
+        spectrum[k] = fft::complex(normal(generator) * amplitude, normal(generator) * amplitude);
+        spectrum[n - k] = std::conj(spectrum[k]);
+    }
+    spectrum[n / 2] = fft::complex(normal(generator) * sqrt(std::max(psd(fs / 2), 0.0) * df), 0);
+
+    fft::transform(spectrum, true);
+
+    std::vector<double> series(n);
+    for (std::size_t i = 0; i < n; i++)
+    {
+        series[i] = spectrum[i].real() * n;
+    }
+    return series;
+}
+
+std::vector<double> Jitter::integrate(const std::vector<double> &series, double fs)
+{
+    std::size_t n = series.size();
+    std::vector<double> prefix(n + 1, 0.0);
+    for (std::size_t i = 0; i < n; i++)
+    {
+        prefix[i + 1] = prefix[i] + (series[i] + series[(i + 1) % n]) / (2 * fs);
+    }
+    return prefix;
+}
+
+// Integral of the series from time 0, across as many periods as needed
+double Jitter::integral(const std::vector<double> &series, const std::vector<double> &prefix, double time) const
+{
+    double u = time * fs;
+    double periods = std::floor(u / n);
+    u -= periods * n;
+    std::size_t i = std::min<std::size_t>((std::size_t)u, n - 1);
+    double f = u - i;
+
+    double a = series[i];
+    double b = series[(i + 1) % n];
+    return periods * prefix[n] + prefix[i] + (a * f + (b - a) * f * f / 2) / fs;
+}
+
+double Jitter::interpolate(const std::vector<double> &series, double time) const
+{
+    double u = fmod(time * fs, (double)n);
+    if (u < 0)
+        u += n;
+    std::size_t i = std::min<std::size_t>((std::size_t)u, n - 1);
+    double f = u - i;
+    return series[i] * (1 - f) + series[(i + 1) % n] * f;
+}
@@ -0,0 +1,61 @@
+/**
+ * Twinkle FGS-Sim: Centroid recovery simulation
+ *
+ * @file Jitter.hpp
+ * @brief Header file for Jitter class
+ * @author Claudio Arena
+ * @version 1.0.0 2026-10-18
+ */
+#pragma once
+
+#include <functional>
+#include <random>
+#include <vector>
+
+#include "typedefs.h"
+
+/**
+ * Pointing jitter time series, synthesised in one go from a power spectral density.
+ * Offsets are in arcsec along the frame x and y axes. The series is periodic, so times past the duration wrap around.
+ * Frames and sub-exposure slices read the mean offset over any time window in constant time, from prefix sums.
+ *
+ * @brief Class holding a pointing jitter time series
+ */
+class Jitter
+{
+public:
+  // One sided power spectral density, in arcsec^2/Hz, as a function of frequency in Hz
+  typedef std::function<double(double)> PSD;
+
+  Jitter(PSD psdX, PSD psdY, double _sampleRate, double _duration, uint32_t seed = 0);
+  ~Jitter();
+
+  // Common spectra. Combine them with sum.
+  static PSD white(double rms, double bandwidth);
+  static PSD powerLaw(double amplitude, double index, double minFrequency);
+  static PSD harmonic(double frequency, double rms, double width);
+  static PSD table(std::vector<double> frequency, std::vector<double> psd);
+  static PSD sum(std::vector<PSD> psds);
+
+  pixel_coordinates offset(double time) const;
+  pixel_coordinates meanOffset(double startTime, double endTime) const;
+  void meanOffsets(double startTime, double sliceTime, uint32_t nSlices, pixel_coordinates *out) const;
+  pixel_coordinates rms() const;
+
+  double sampleRate() const { return fs; }
+  double duration() const { return n / fs; }
+  std::size_t size() const { return n; }
+  const double *x() const { return xSeries.data(); }
+  const double *y() const { return ySeries.data(); }
+
+private:
+  std::size_t n;
+  double fs;
+  std::vector<double> xSeries, ySeries;
+  std::vector<double> xIntegral, yIntegral; // n + 1 prefix sums of the linearly interpolated series, in arcsec * s
+
+  static std::vector<double> synthesise(PSD psd, std::size_t n, double fs, std::mt19937 &generator);
+  static std::vector<double> integrate(const std::vector<double> &series, double fs);
+  double integral(const std::vector<double> &series, const std::vector<double> &prefix, double time) const;
+  double interpolate(const std::vector<double> &series, double time) const;
+};
@@ -0,0 +1,168 @@
+/**
+ * Twinkle FGS-Sim: Centroid recovery simulation
+ *
+ * @file LightCurve.cpp
+ * @brief Transit, tabulated and sinusoidal light curves
+ * @author Claudio Arena
+ * @version 1.0.0 2026-10-18
+ * @description Distances are in stellar radii. The planet-star separation on a circular orbit is
+ * z = a sqrt(sin^2(phi) + cos^2(i) cos^2(phi)), with phi = 2 pi (t - t0) / P, and the planet is in front of the star when cos(phi) > 0.
+ * Limb darkening: I(mu) = 1 - u1 (1 - mu) - u2 (1 - mu)^2.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+#include "LightCurve.hpp"
+
+/**
+ * Constructs a transit light curve.
+ *
+ * @param _t0 Time of mid transit, in seconds
+ * @param _period Orbital period, in seconds
+ * @param _radiusRatio Planet radius over stellar radius
+ * @param _semiMajorAxis Semi major axis over stellar radius
+ * @param _inclination Orbital inclination, in degrees
+ * @param _u1 Linear limb darkening coefficient
+ * @param _u2 Quadratic limb darkening coefficient
+ * @param _annuli Number of annuli used to integrate over the stellar disc
+ */
+TransitLightCurve::TransitLightCurve(double _t0, double _period, double _radiusRatio, double _semiMajorAxis, double _inclination,
+                                     double _u1, double _u2, uint16_t _annuli)
+    : t0(_t0), period(_period), p(_radiusRatio), a(_semiMajorAxis), inclination(_inclination), u1(_u1), u2(_u2), annuli(std::max<uint16_t>(_annuli, 1))
+{
+    // Flux of the whole disc, with the same quadrature used for the occulted flux
+    totalFlux = 0;
+    const double dr = 1.0 / annuli;
+    for (uint16_t k = 0; k < annuli; k++)
+    {
+        double r = (k + 0.5) * dr;
+        totalFlux += intensity(r) * 2 * M_PI * r * dr;
+    }
+}
+
+double TransitLightCurve::flux(double time) const
+{
+    double phi = 2 * M_PI * (time - t0) / period;
+    if (cos(phi) <= 0)
+    {
+        return 1.0;
+    }
+    return 1.0 - occultedFraction(separation(time));
+}
+
+/**
+ * Sky projected distance between planet and star centres, in stellar radii
+ */
+double TransitLightCurve::separation(double time) const
+{
+    double phi = 2 * M_PI * (time - t0) / period;
+    double cosi = cos(inclination * M_PI / 180);
+    return a * sqrt(pow(sin(phi), 2) + pow(cosi * cos(phi), 2));
+}
+
+/**
+ * Fraction of the stellar flux blocked by the planet
+ *
+ * @param z Distance between planet and star centres, in stellar radii
+ */
+double TransitLightCurve::occultedFraction(double z) const
+{
+    if (z >= 1 + p)
+    {
+        return 0.0;
+    }
+
+    double blocked = 0;
+    const double dr = 1.0 / annuli;
+    for (uint16_t k = 0; k < annuli; k++)
+    {
+        double r = (k + 0.5) * dr;
+        if (r + z <= p)
+        {
+            blocked += intensity(r) * 2 * M_PI * r * dr; // annulus fully behind the planet
+        }
+        else if (r > z - p && r < z + p)
+        {
+            // Arc of the annulus inside the planet disc
+            double c = (r * r + z * z - p * p) / (2 * r * z);
+            blocked += intensity(r) * 2 * acos(std::min(std::max(c, -1.0), 1.0)) * r * dr;
+        }
+    }
+    return blocked / totalFlux;
+}
+
+double TransitLightCurve::intensity(double r) const
+{
+    double mu = sqrt(std::max(0.0, 1 - r * r));
+    return 1 - u1 * (1 - mu) - u2 * pow(1 - mu, 2);
+}
+
+/**
+ * Constructs a tabulated light curve.
+ *
+ * @param _times Times, in seconds, increasing
+ * @param _fluxes Relative flux at each time
+ * @param _period Period, in seconds, to fold the time on. 0 for a non periodic curve, held constant outside the table
+ */
+TabulatedLightCurve::TabulatedLightCurve(std::vector<double> _times, std::vector<double> _fluxes, double _period)
+    : times(_times), fluxes(_fluxes), period(_period)
+{
+    if (times.size() != fluxes.size() || times.empty())
+    {
+        throw "Error! Light curve table needs matching, non empty, time and flux columns";
+    }
+}
+
+/**
+ * Loads a light curve from a csv file with time, flux on each line. Lines that don't start with a number are skipped.
+ */
+TabulatedLightCurve TabulatedLightCurve::fromFile(std::string filename, double period)
+{
+    std::ifstream file(filename.c_str());
+    if (file.fail())
+    {
+        throw "Error! Could not open light curve file";
+    }
+
+    std::vector<double> times, fluxes;
+    std::string line;
+    while (getline(file, line))
+    {
+        double time, flux;
+        char separator;
+        std::stringstream linestream(line);
+        if (linestream >> time >> separator >> flux)
+        {
+            times.push_back(time);
+            fluxes.push_back(flux);
+        }
+    }
+    return TabulatedLightCurve(times, fluxes, period);
+}
+
+double TabulatedLightCurve::flux(double time) const
+{
+    if (period > 0)
+    {
+        time = times.front() + fmod(time - times.front(), period);
+        if (time < times.front())
+            time += period;
+    }
+
+    if (time <= times.front())
+        return fluxes.front();
+    if (time >= times.back())
+        return fluxes.back();
+
+    std::size_t i = std::upper_bound(times.begin(), times.end(), time) - times.begin();
+    double f = (time - times[i - 1]) / (times[i] - times[i - 1]);
+    return fluxes[i - 1] * (1 - f) + fluxes[i] * f;
+}
+
+double SinusoidalLightCurve::flux(double time) const
+{
+    return 1.0 + amplitude * sin(2 * M_PI * time / period + phase);
+}
@@ -0,0 +1,85 @@
+/**
+ * Twinkle FGS-Sim: Centroid recovery simulation
+ *
+ * @file LightCurve.hpp
+ * @brief Header file for LightCurve classes
+ * @author Claudio Arena
+ * @version 1.0.0 2026-10-18
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "typedefs.h"
+
+/**
+ * Relative flux of a source as a function of time. Frames scale the expected flux of the source by this value,
+ * evaluated at mid exposure, so the source distribution is built only once.
+ *
+ * @brief Base class for light curves
+ */
+class LightCurve
+{
+public:
+  virtual ~LightCurve() {}
+  virtual double flux(double time) const = 0;
+};
+
+/**
+ * Transit of a planet on a circular orbit, in front of a star with quadratic limb darkening.
+ * The occulted flux is integrated numerically over annuli of the stellar disc.
+ *
+ * @brief Analytic transit light curve
+ */
+class TransitLightCurve : public LightCurve
+{
+public:
+  TransitLightCurve(double _t0, double _period, double _radiusRatio, double _semiMajorAxis, double _inclination = 90.0,
+                    double _u1 = 0.0, double _u2 = 0.0, uint16_t _annuli = 200);
+
+  double flux(double time) const override;
+  double separation(double time) const;
+  double occultedFraction(double z) const;
+
+private:
+  double t0, period, p, a, inclination, u1, u2;
+  uint16_t annuli;
+  double totalFlux;
+
+  double intensity(double r) const;
+};
+
+/**
+ * Tabulated light curve, linearly interpolated. Optionally periodic, e.g. a folded variable star curve.
+ *
+ * @brief Light curve from a table
+ */
+class TabulatedLightCurve : public LightCurve
+{
+public:
+  TabulatedLightCurve(std::vector<double> _times, std::vector<double> _fluxes, double _period = 0);
+  static TabulatedLightCurve fromFile(std::string filename, double period = 0);
+
+  double flux(double time) const override;
+
+private:
+  std::vector<double> times, fluxes;
+  double period;
+};
+
+/**
+ * Sinusoidal variable star
+ *
+ * @brief Sinusoidal light curve
+ */
+class SinusoidalLightCurve : public LightCurve
+{
+public:
+  SinusoidalLightCurve(double _period, double _amplitude, double _phase = 0) : period(_period), amplitude(_amplitude), phase(_phase) {}
+
+  double flux(double time) const override;
+
+private:
+  double period, amplitude, phase;
+};
@@ -16,7 +16,9 @@
 #include "typedefs.h"
 #include "MonteCarlo.hpp"
 
+#include <algorithm>
 #include <chrono>
+#include <cmath>
 #include <fstream>
 #include <iostream>
 #include <vector>
@@ -25,8 +27,10 @@
 //#include "MonteCarlo.hpp"
 #include "Frame.hpp"
 #include "FrameProcessor.hpp"
+#include "CosmicRays.hpp"
 
 #include <memory>
+#include <random>
 #include <thread>
 
 //#include "unitTest.cpp"
@@ -146,7 +150,6 @@ void testFrameMultipleSources()
 	}
 
 	frame->generateFrame();
-	// frame->PrintSimelArray();
 	// frame->Print();
 	// frame->saveToBitmap("data.bmp");
 	frame->saveToFile("data/frame1.csv");
@@ -168,10 +171,119 @@ void testMonteCarlo()
 	mtc.run(mags, fwhm, coords, false);
 }
 
+// Times FrameProcessor fine centroiding of many stars on a large frame, with each grid layout, and the conversions from row major
+template <class Layout>
+void benchmarkLayout(const char *name, const Grid<uint32_t> &frame, const std::vector<pixel_coordinates> &stars, uint32_t windowSize)
+{
+	auto start = std::chrono::steady_clock::now();
+	Grid<uint32_t, Layout> grid(frame);
+	auto converted = std::chrono::steady_clock::now();
+
+	double check = 0;
+	for (uint16_t repeat = 0; repeat < 20; repeat++)
+	{
+		for (const pixel_coordinates &star : stars)
+		{
+			pixel_coordinates centroid = BasicFrameProcessor<uint32_t, Layout>::fine_momentum(&grid, std::lround(star.x), std::lround(star.y), windowSize, 3);
+			check += centroid.x - star.x;
+		}
+	}
+	auto centroided = std::chrono::steady_clock::now();
+
+	Grid<uint32_t> back(grid);
+	auto end = std::chrono::steady_clock::now();
+	printf("%-16s to layout %8.2f ms, centroids %8.2f ms, to rows %8.2f ms (mean error %+.4f)\n", name,
+		   std::chrono::duration<double, std::milli>(converted - start).count(),
+		   std::chrono::duration<double, std::milli>(centroided - converted).count(),
+		   std::chrono::duration<double, std::milli>(end - centroided).count(), check / (20.0 * stars.size()));
+}
+
+void benchmarkGridLayouts()
+{
+	// Random field on a 8k x 8k frame, noiseless so only the memory access differs
+	const uint32_t side = 8192, windowSize = 48;
+	Grid<uint32_t> frame(side, side);
+	std::mt19937 generator(1);
+	std::uniform_real_distribution<double> position(windowSize, side - windowSize);
+	std::vector<pixel_coordinates> stars(2000);
+	for (pixel_coordinates &star : stars)
+	{
+		star = {position(generator), position(generator)};
+	}
+	std::sort(stars.begin(), stars.end(), [](const pixel_coordinates &a, const pixel_coordinates &b) { return a.y < b.y; });
+	for (uint32_t i = 0; i < frame.size(); i++)
+	{
+		frame[i] = 100;
+	}
+	for (const pixel_coordinates &star : stars)
+	{
+		for (int32_t dy = -10; dy <= 10; dy++)
+		{
+			for (int32_t dx = -10; dx <= 10; dx++)
+			{
+				const uint32_t x = std::lround(star.x) + dx, y = std::lround(star.y) + dy;
+				frame(x, y) += 10000 * std::exp(-(std::pow(x - star.x, 2) + std::pow(y - star.y, 2)) / 8);
+			}
+		}
+	}
+
+	benchmarkLayout<PackedRows>("Packed rows", frame, stars, windowSize);
+	benchmarkLayout<PaddedRows<64>>("Padded rows", frame, stars, windowSize);
+	benchmarkLayout<TiledLayout<8>>("8x8 tiles", frame, stars, windowSize);
+	benchmarkLayout<TiledLayout<16>>("16x16 tiles", frame, stars, windowSize);
+	benchmarkLayout<MortonTiles<16>>("16x16 Z order", frame, stars, windowSize);
+}
+
+// Times cosmic ray tracks drawn on a Twinkle frame, and their rejection, against centroiding the same frame
+void benchmarkCosmicRays()
+{
+	const Telescope &telescope = Twinkle;
+	pixel_coordinates center = astroUtilities::frameCenter(telescope.FRAME_W, telescope.FRAME_H);
+	std::unique_ptr<Frame> frame = std::make_unique<Frame>(telescope, 1.0);
+	frame->addSource(center.x, center.y, 5.0, 5.0, 11.0);
+	frame->generateFrame(true);
+	const Grid<uint32_t> clean = *frame->get();
+
+	// Many more tracks than a frame gets in space, from spots to streaks 50 pixels long
+	std::mt19937 generator(3);
+	std::uniform_real_distribution<double> uniform(0.0, 1.0);
+	const std::size_t n = 2000;
+	std::vector<double> x0(n), y0(n), x1(n), y1(n), charge(n, 20000);
+	for (std::size_t i = 0; i < n; i++)
+	{
+		const double length = 50 * uniform(generator), azimuth = 2 * M_PI * uniform(generator);
+		x0[i] = uniform(generator) * telescope.FRAME_W;
+		y0[i] = uniform(generator) * telescope.FRAME_H;
+		x1[i] = x0[i] + length * cos(azimuth);
+		y1[i] = y0[i] + length * sin(azimuth);
+	}
+
+	double drawing = 0, rejecting = 0, centroiding = 0;
+	const uint16_t repeats = 20;
+	for (uint16_t repeat = 0; repeat < repeats; repeat++)
+	{
+		Grid<uint32_t> hit = clean;
+		auto start = std::chrono::steady_clock::now();
+		CosmicRays::drawTracks(n, x0.data(), y0.data(), x1.data(), y1.data(), charge.data(), hit);
+		auto drawn = std::chrono::steady_clock::now();
+		FrameProcessor::rejectCosmicRays(&hit, 5.0);
+		auto rejected = std::chrono::steady_clock::now();
+		FrameProcessor::multiple_guess_momentum(&hit, 20, 4, 2);
+		auto centroided = std::chrono::steady_clock::now();
+		drawing += std::chrono::duration<double, std::milli>(drawn - start).count();
+		rejecting += std::chrono::duration<double, std::milli>(rejected - drawn).count();
+		centroiding += std::chrono::duration<double, std::milli>(centroided - rejected).count();
+	}
+	printf("%zu tracks: drawn %8.3f ms, rejected %8.3f ms, centroid %8.3f ms per frame\n", n, drawing / repeats, rejecting / repeats,
+		   centroiding / repeats);
+}
+
 int main()
 {
 	//testFrame();
 	// testMonteCarlo();
+	// benchmarkGridLayouts();
+	// benchmarkCosmicRays();
 	testFrameMultipleSources();
 	return 0;
 }
\ No newline at end of file
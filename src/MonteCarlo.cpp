@@ -20,6 +20,7 @@
 #include "FrameProcessor.hpp"
 #include "typedefs.h"
 #include <thread>
+#include <limits>
 
 #define PRINT_INFO
 
@@ -167,6 +168,7 @@ void MonteCarlo::runThread(std::vector<FrameParameters> &params_v_in, std::vecto
 {
 	FrameParameters param;
 	std::size_t n;
+	Grid<uint16_t> output;
 
 	while (true)
 	{
@@ -196,15 +198,28 @@ void MonteCarlo::runThread(std::vector<FrameParameters> &params_v_in, std::vecto
 			printf(".");
 			//params_mutex.unlock();
 			pixel_coordinates center = param.input_coordinates.at(i);
+			// Scratch grids of the iteration come from the thread arena, which is rolled back at the end of it
+			Arena::Scope iteration;
 
 			frame->reset();
 			frame->addSource(center.x, center.y, param.star_fwhm_x, param.star_fwhm_y, magnitudes);
 			frame->generateFrame(true);
 
-			std::unique_ptr<FrameProcessor> fprocessor = std::make_unique<FrameProcessor>(frame->get());
-
 			//TODO: optimize / remove hard coded values
-			pixel_coordinates centroid = fprocessor->multiple_guess_momentum(30, 4, 2);
+			pixel_coordinates centroid;
+			if (tel.FGS_MAX_ADU <= std::numeric_limits<uint16_t>::max())
+			{
+				// Detector output fits in 16 bits: read it out once, into the grid kept across iterations, and centroid
+				// on it. The readout is a pass over the whole frame, so only the centroiding passes read half the bytes.
+				frame->get(output);
+				std::unique_ptr<BasicFrameProcessor<uint16_t>> fprocessor = std::make_unique<BasicFrameProcessor<uint16_t>>(&output);
+				centroid = fprocessor->multiple_guess_momentum(30, 4, 2);
+			}
+			else
+			{
+				std::unique_ptr<FrameProcessor> fprocessor = std::make_unique<FrameProcessor>(frame->get());
+				centroid = fprocessor->multiple_guess_momentum(30, 4, 2);
+			}
 			param.centroid_coordinates.at(i) = centroid;
 		}
 
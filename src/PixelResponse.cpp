@@ -0,0 +1,174 @@
+/**
+ * Twinkle FGS-Sim: Centroid recovery simulation
+ *
+ * @file PixelResponse.cpp
+ * @brief Intra-pixel response maps
+ * @author Claudio Arena
+ * @version 1.0.0 2026-10-18
+ * @description Simel weights are area weighted means of the cells each simel overlaps, so maps and simels need not share
+ * a resolution. The gaussian integral over a cell is a difference of normal cumulative functions, so the weighted pixel
+ * integral takes n + 1 erfc evaluations.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "PixelResponse.hpp"
+
+PixelResponse::PixelResponse(std::vector<double> _profileX, std::vector<double> _profileY)
+    : n(_profileX.size()), profileX(_profileX), profileY(_profileY)
+{
+    if (profileX.empty() || profileX.size() != profileY.size())
+    {
+        throw "Error! Pixel response profiles need the same, non zero, number of samples";
+    }
+    map.resize(n * n);
+    for (uint16_t y = 0; y < n; y++)
+    {
+        for (uint16_t x = 0; x < n; x++)
+        {
+            map[y * n + x] = profileX[x] * profileY[y];
+        }
+    }
+    checkMap();
+}
+
+/**
+ * Parabolic response, 1 - edgeLoss (2u)^2 along each axis, u from -1/2 to 1/2 across the pixel.
+ *
+ * @param edgeLoss Relative loss of sensitivity at the pixel edges
+ * @param samples Cells per side
+ */
+PixelResponse::PixelResponse(double edgeLoss, uint16_t samples) : n(samples)
+{
+    if (n == 0)
+    {
+        throw "Error! Pixel response needs at least one sample";
+    }
+    for (uint16_t i = 0; i < n; i++)
+    {
+        const double u = (i + 0.5) / n - 0.5;
+        profileX.push_back(1 - edgeLoss * 4 * u * u);
+    }
+    profileY = profileX;
+    map.resize(n * n);
+    for (uint16_t y = 0; y < n; y++)
+    {
+        for (uint16_t x = 0; x < n; x++)
+        {
+            map[y * n + x] = profileX[x] * profileY[y];
+        }
+    }
+    checkMap();
+}
+
+PixelResponse::PixelResponse(const Grid<double> &_map) : n(_map.width()), profileX(_map.width(), 0.0), profileY(_map.width(), 0.0)
+{
+    if (_map.width() != _map.height() || n == 0)
+    {
+        throw "Error! Pixel response maps must be square";
+    }
+    map.resize(n * n);
+    for (uint16_t y = 0; y < n; y++)
+    {
+        for (uint16_t x = 0; x < n; x++)
+        {
+            map[y * n + x] = _map[y * n + x];
+        }
+    }
+    checkMap();
+
+    // Marginal profiles, scaled so their product keeps the mean of the map
+    const double norm = sqrt(mean());
+    for (uint16_t y = 0; y < n; y++)
+    {
+        for (uint16_t x = 0; x < n; x++)
+        {
+            profileX[x] += map[y * n + x] / n;
+            profileY[y] += map[y * n + x] / n;
+        }
+    }
+    for (uint16_t i = 0; i < n; i++)
+    {
+        profileX[i] /= (norm > 0) ? norm : 1;
+        profileY[i] /= (norm > 0) ? norm : 1;
+    }
+}
+
+PixelResponse::~PixelResponse()
+{
+#ifdef DEBUG_MEMORY
+    std::cout << "Destroyed PixelResponse " << std::endl;
+#endif
+}
+
+void PixelResponse::checkMap() const
+{
+    for (double r : map)
+    {
+        if (r < 0 || r > 1)
+        {
+            throw "Error! Pixel response must be between 0 and 1";
+        }
+    }
+}
+
+double PixelResponse::mean() const
+{
+    double sum = 0;
+    for (double r : map)
+    {
+        sum += r;
+    }
+    return sum / map.size();
+}
+
+std::vector<double> PixelResponse::simelWeights(uint16_t simels) const
+{
+    // Overlap of simel i with cell k, as a fraction of the simel
+    std::vector<double> overlap(simels * n, 0.0);
+    for (uint16_t i = 0; i < simels; i++)
+    {
+        for (uint16_t k = 0; k < n; k++)
+        {
+            const double lo = std::max((double)i / simels, (double)k / n);
+            const double hi = std::min((double)(i + 1) / simels, (double)(k + 1) / n);
+            overlap[i * n + k] = std::max(hi - lo, 0.0) * simels;
+        }
+    }
+
+    std::vector<double> weights(simels * simels, 0.0);
+    for (uint16_t sy = 0; sy < simels; sy++)
+    {
+        for (uint16_t sx = 0; sx < simels; sx++)
+        {
+            double weight = 0;
+            for (uint16_t ky = 0; ky < n; ky++)
+            {
+                for (uint16_t kx = 0; kx < n; kx++)
+                {
+                    weight += map[ky * n + kx] * overlap[sx * n + kx] * overlap[sy * n + ky];
+                }
+            }
+            weights[sy * simels + sx] = weight;
+        }
+    }
+    return weights;
+}
+
+double PixelResponse::integrateGaussian(const std::vector<double> &profile, double offset, double sigma) const
+{
+    // Cumulative normal at the cell edges
+    const double scale = 1 / (sigma * M_SQRT2);
+    double previous = 0.5 * erfc(-(offset - 0.5) * scale);
+    double integral = 0;
+    for (uint16_t k = 0; k < n; k++)
+    {
+        const double edge = offset - 0.5 + (k + 1.0) / n;
+        const double cumulative = 0.5 * erfc(-edge * scale);
+        integral += profile[k] * (cumulative - previous);
+        previous = cumulative;
+    }
+    return integral;
+}
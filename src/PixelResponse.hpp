@@ -0,0 +1,54 @@
+/**
+ * Twinkle FGS-Sim: Centroid recovery simulation
+ *
+ * @file PixelResponse.hpp
+ * @brief Header file for PixelResponse class
+ * @author Claudio Arena
+ * @version 1.0.0 2026-10-18
+ */
+#pragma once
+
+#include <vector>
+
+#include "typedefs.h"
+#include "Grid.hpp"
+
+/**
+ * Sensitivity across a pixel, from 0 to 1, sampled on n x n equal cells. Detections are kept with the sensitivity of
+ * the point they land on, so a response falling at the edges moves the centroid of undersampled PSFs towards the
+ * pixel centres.
+ * Frames resample the map to simel weights and fold them in the source distributions when sources are added. The
+ * noiseless frame integrates gaussian sources over the separable response analytically.
+ *
+ * @brief Class holding an intra-pixel response map
+ */
+class PixelResponse
+{
+public:
+  // Separable response, product of the x and y profiles. Profiles are sampled on equal cells across the pixel.
+  PixelResponse(std::vector<double> profileX, std::vector<double> profileY);
+  // Parabolic profile on both axes, 1 at the centre and 1 - edgeLoss at the edges
+  PixelResponse(double edgeLoss, uint16_t samples = 16);
+  // Any map, n x n cells. Row and column means are used where a separable response is needed.
+  PixelResponse(const Grid<double> &_map);
+  ~PixelResponse();
+
+  uint16_t samples() const { return n; }
+  double response(uint16_t cellX, uint16_t cellY) const { return map[cellY * n + cellX]; }
+  double mean() const;
+
+  // Mean response over each of the simels x simels simels of a pixel, row major
+  std::vector<double> simelWeights(uint16_t simels) const;
+  // Integral of a unit gaussian of given sigma over the pixel weighted by the x (or y) profile. offset is the
+  // position of the pixel centre from the gaussian centre, in pixels.
+  double integrateGaussianX(double offset, double sigma) const { return integrateGaussian(profileX, offset, sigma); }
+  double integrateGaussianY(double offset, double sigma) const { return integrateGaussian(profileY, offset, sigma); }
+
+private:
+  uint16_t n;
+  std::vector<double> map;                // n x n, row major
+  std::vector<double> profileX, profileY; // column and row means of the map
+
+  void checkMap() const;
+  double integrateGaussian(const std::vector<double> &profile, double offset, double sigma) const;
+};
@@ -0,0 +1,252 @@
+/**
+ * Twinkle FGS-Sim: Centroid recovery simulation
+ *
+ * @file PolychromaticPSF.cpp
+ * @brief Per-band and broadband PSF stamps, cached by colour bin
+ * @author Claudio Arena
+ * @version 1.0.0 2026-10-18
+ * @description A diffraction limited PSF scales with wavelength, so the FWHM given for a source refers to the reference wavelength
+ * and is scaled by centerBand / referenceWavelength for each telescope filter.
+ * The broadband stamp is the sum of the band stamps, weighted by the photon flux of the source in each band.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "PolychromaticPSF.hpp"
+#include "astroUtilities.hpp"
+
+/**
+ * Bilinear interpolation of the stamp.
+ *
+ * @param dx Offset from the PSF centre, in simels, in x direction
+ * @param dy Offset from the PSF centre, in simels, in y direction
+ * @return Stamp value at the given offset. Zero outside the stamp.
+ */
+double PSFStamp::density(double dx, double dy) const
+{
+    double sx = centerX + dx * oversampling;
+    double sy = centerY + dy * oversampling;
+
+    if (sx < 0 || sy < 0 || sx > data.width() - 1 || sy > data.height() - 1)
+    {
+        return 0;
+    }
+
+    uint32_t x0 = (uint32_t)sx;
+    uint32_t y0 = (uint32_t)sy;
+    uint32_t x1 = (x0 + 1 < data.width()) ? x0 + 1 : x0;
+    uint32_t y1 = (y0 + 1 < data.height()) ? y0 + 1 : y0;
+    double fx = sx - x0;
+    double fy = sy - y0;
+
+    double top = data(x0, y0) * (1 - fx) + data(x1, y0) * fx;
+    double bottom = data(x0, y1) * (1 - fx) + data(x1, y1) * fx;
+    return top * (1 - fy) + bottom * fy;
+}
+
+/**
+ * Constructs a PolychromaticPSF object, which builds stamps for the filters of a telescope
+ *
+ * @param _tel Telescope. Its filter set and simels are used for the stamps
+ * @param _referenceWavelength Wavelength, in nm, at which the source FWHM is given
+ * @param _colourBinWidth Width of the colour bins, in magnitudes, used to cache broadband stamps
+ * @param _oversampling Stamp samples per simel, per side
+ */
+PolychromaticPSF::PolychromaticPSF(Telescope _tel, double _referenceWavelength, double _colourBinWidth, uint16_t _oversampling)
+    : tel(_tel), referenceWavelength(_referenceWavelength), colourBinWidth(_colourBinWidth), oversampling(_oversampling)
+{
+    if (tel.FGS_filter.size() == 0)
+    {
+        throw "Error! PolychromaticPSF needs a telescope with at least one filter";
+    }
+    if (oversampling == 0)
+    {
+        oversampling = 1;
+    }
+}
+
+PolychromaticPSF::~PolychromaticPSF()
+{
+#ifdef DEBUG_MEMORY
+    std::cout << "Destroyed PolychromaticPSF " << std::endl;
+#endif
+}
+
+/**
+ * Returns the stamp for a single telescope filter. Stamps are built once and then cached.
+ *
+ * @param band Index of the filter in the telescope filter set
+ * @param fwhm_x Source size at the reference wavelength, in pixels, in x direction.
+ * @param fwhm_y Source size at the reference wavelength, in pixels, in y direction.
+ * @return Normalised stamp for the band
+ */
+std::shared_ptr<const PSFStamp> PolychromaticPSF::bandStamp(uint16_t band, double fwhm_x, double fwhm_y)
+{
+    if (band >= tel.FGS_filter.size())
+    {
+        throw "Error! Requested band is not in the telescope filter set";
+    }
+
+    std::lock_guard<std::mutex> guard(cache_mutex);
+    auto key = std::make_tuple(fwhm_x, fwhm_y, band);
+    auto it = bandCache.find(key);
+    if (it != bandCache.end())
+    {
+        return it->second;
+    }
+
+    std::shared_ptr<const PSFStamp> stamp = makeBandStamp(band, fwhm_x, fwhm_y);
+    bandCache[key] = stamp;
+    return stamp;
+}
+
+/**
+ * Returns the broadband stamp for a source. The colour of the source is binned, and stamps are cached per colour bin.
+ *
+ * @param mags array with source magnitudes. Make sure to have matching magnitudes with your telescope filter set.
+ * @param fwhm_x Source size at the reference wavelength, in pixels, in x direction.
+ * @param fwhm_y Source size at the reference wavelength, in pixels, in y direction.
+ * @return Normalised broadband stamp
+ */
+std::shared_ptr<const PSFStamp> PolychromaticPSF::broadbandStamp(std::vector<double> mags, double fwhm_x, double fwhm_y)
+{
+    uint16_t nfilters = tel.FGS_filter.size();
+    if (mags.size() != nfilters)
+    {
+        throw "Error! Numbers of supplied mags doesn't match number of telescope filters";
+    }
+
+    std::vector<int32_t> bins = colourBins(mags);
+    auto key = std::make_tuple(fwhm_x, fwhm_y, bins);
+    {
+        std::lock_guard<std::mutex> guard(cache_mutex);
+        auto it = broadbandCache.find(key);
+        if (it != broadbandCache.end())
+        {
+            return it->second;
+        }
+    }
+
+    // Weights are calculated from the bin colour, so every source in the bin gets the same stamp
+    std::vector<double> binMags(nfilters, 0.0);
+    for (uint16_t i = 1; i < nfilters; i++)
+    {
+        binMags[i] = bins[i - 1] * colourBinWidth;
+    }
+    std::vector<double> weights = bandWeights(binMags);
+
+    std::shared_ptr<PSFStamp> stamp = std::make_shared<PSFStamp>();
+    for (uint16_t band = 0; band < nfilters; band++)
+    {
+        std::shared_ptr<const PSFStamp> bstamp = bandStamp(band, fwhm_x, fwhm_y);
+        if (band == 0)
+        {
+            stamp->data.resize(bstamp->data.width(), bstamp->data.height());
+            stamp->data.reset();
+            stamp->oversampling = bstamp->oversampling;
+            stamp->centerX = bstamp->centerX;
+            stamp->centerY = bstamp->centerY;
+        }
+
+        for (uint32_t i = 0; i < stamp->data.size(); i++)
+        {
+            stamp->data[i] += weights[band] * bstamp->data[i];
+        }
+    }
+
+    std::lock_guard<std::mutex> guard(cache_mutex);
+    broadbandCache[key] = stamp;
+    return stamp;
+}
+
+/**
+ * Relative photon flux of a source in each telescope band
+ *
+ * @param mags array with source magnitudes, one per telescope filter
+ * @return Band weights, normalised to unit sum
+ */
+std::vector<double> PolychromaticPSF::bandWeights(std::vector<double> mags) const
+{
+    std::vector<double> weights(mags.size());
+    double total = 0;
+    for (std::size_t i = 0; i < mags.size(); i++)
+    {
+        weights[i] = astroUtilities::photonsInBand(mags[i], tel.FGS_filter.at(i));
+        total += weights[i];
+    }
+
+    for (double &w : weights)
+    {
+        w /= total;
+    }
+    return weights;
+}
+
+std::size_t PolychromaticPSF::cachedStamps() const
+{
+    std::lock_guard<std::mutex> guard(cache_mutex);
+    return bandCache.size() + broadbandCache.size();
+}
+
+void PolychromaticPSF::clear()
+{
+    std::lock_guard<std::mutex> guard(cache_mutex);
+    bandCache.clear();
+    broadbandCache.clear();
+}
+
+// Colours are taken relative to the first band
+std::vector<int32_t> PolychromaticPSF::colourBins(const std::vector<double> &mags) const
+{
+    std::vector<int32_t> bins(mags.size() - 1);
+    for (std::size_t i = 1; i < mags.size(); i++)
+    {
+        bins[i - 1] = (int32_t)std::lround((mags[i] - mags[0]) / colourBinWidth);
+    }
+    return bins;
+}
+
+std::shared_ptr<const PSFStamp> PolychromaticPSF::makeBandStamp(uint16_t band, double fwhm_x, double fwhm_y) const
+{
+    // All bands share the same stamp size, set by the reddest filter
+    double maxScale = 0;
+    for (const filter &flt : tel.FGS_filter)
+    {
+        maxScale = std::max(maxScale, flt.centerBand / referenceWavelength);
+    }
+
+    double scale = tel.FGS_filter.at(band).centerBand / referenceWavelength;
+    double sigmax = (fwhm_x / 2.3585) * tel.SIMELS * scale * oversampling;
+    double sigmay = (fwhm_y / 2.3585) * tel.SIMELS * scale * oversampling;
+
+    uint16_t halfX = (uint16_t)std::ceil(5 * (fwhm_x / 2.3585) * tel.SIMELS * maxScale) * oversampling;
+    uint16_t halfY = (uint16_t)std::ceil(5 * (fwhm_y / 2.3585) * tel.SIMELS * maxScale) * oversampling;
+
+    std::shared_ptr<PSFStamp> stamp = std::make_shared<PSFStamp>();
+    stamp->oversampling = oversampling;
+    stamp->centerX = halfX;
+    stamp->centerY = halfY;
+    stamp->data.resize(2 * halfX + 1, 2 * halfY + 1);
+
+    double total = 0;
+    for (uint16_t y = 0; y < stamp->data.height(); y++)
+    {
+        double yTerm = pow(y - stamp->centerY, 2) / (2 * pow(sigmay, 2));
+        for (uint16_t x = 0; x < stamp->data.width(); x++)
+        {
+            double xTerm = pow(x - stamp->centerX, 2) / (2 * pow(sigmax, 2));
+            stamp->data(x, y) = exp(-(xTerm + yTerm));
+            total += stamp->data(x, y);
+        }
+    }
+
+    for (uint32_t i = 0; i < stamp->data.size(); i++)
+    {
+        stamp->data[i] /= total;
+    }
+    stamp->data.extraPixel() = 0;
+
+    return stamp;
+}
@@ -0,0 +1,70 @@
+/**
+ * Twinkle FGS-Sim: Centroid recovery simulation
+ *
+ * @file PolychromaticPSF.hpp
+ * @brief Header file for PSFStamp struct and PolychromaticPSF class
+ * @author Claudio Arena
+ * @version 1.0.0 2026-10-18
+ */
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
+#include "typedefs.h"
+#include "Grid.hpp"
+#include "telescopes.h"
+
+/**
+ * Oversampled PSF image, normalised to unit sum over its samples.
+ * Coordinates are in stamp samples; there are 'oversampling' samples per simel, per side.
+ */
+struct PSFStamp
+{
+  Grid<double> data;
+  uint16_t oversampling = 1;
+  double centerX = 0, centerY = 0; // stamp coordinates of the PSF centre
+
+  // Half size of the stamp, in simels. Used to find the footprint of a source on the simel array.
+  double halfWidth() const { return centerX / oversampling; }
+  double halfHeight() const { return centerY / oversampling; }
+
+  double density(double dx, double dy) const;
+};
+
+/**
+ * Builds per-band PSF stamps, scaling a diffraction limited FWHM with the filter wavelength, and synthesises
+ * broadband stamps weighted by the per-band photon fluxes of a source.
+ * Broadband stamps are cached by colour bin, so sources with similar colours share the same stamp.
+ *
+ * @brief Class to build and cache chromatic PSF stamps
+ */
+class PolychromaticPSF
+{
+public:
+  PolychromaticPSF(Telescope _tel, double _referenceWavelength = V_filter.centerBand, double _colourBinWidth = 0.05, uint16_t _oversampling = 4);
+  ~PolychromaticPSF();
+
+  std::shared_ptr<const PSFStamp> bandStamp(uint16_t band, double fwhm_x, double fwhm_y);
+  std::shared_ptr<const PSFStamp> broadbandStamp(std::vector<double> mags, double fwhm_x, double fwhm_y);
+  std::vector<double> bandWeights(std::vector<double> mags) const;
+
+  std::size_t cachedStamps() const;
+  void clear();
+
+private:
+  Telescope tel;
+  double referenceWavelength, colourBinWidth;
+  uint16_t oversampling;
+
+  // keys are (fwhm_x, fwhm_y, band) and (fwhm_x, fwhm_y, colour bins)
+  std::map<std::tuple<double, double, uint16_t>, std::shared_ptr<const PSFStamp>> bandCache;
+  std::map<std::tuple<double, double, std::vector<int32_t>>, std::shared_ptr<const PSFStamp>> broadbandCache;
+  mutable std::mutex cache_mutex; // protects the caches, so a PolychromaticPSF can be shared between threads
+
+  std::vector<int32_t> colourBins(const std::vector<double> &mags) const;
+  std::shared_ptr<const PSFStamp> makeBandStamp(uint16_t band, double fwhm_x, double fwhm_y) const;
+};
@@ -0,0 +1,334 @@
+/**
+ * Twinkle FGS-Sim: Centroid recovery simulation
+ *
+ * @file Projection.cpp
+ * @brief Sky to detector projection with field distortion
+ * @author Claudio Arena
+ * @version 1.0.0 2026-10-18
+ * @description Stars are unit vectors u in equatorial cartesian coordinates. The tangent plane coordinates are u.e / u.ez, with e the
+ * detector axis and ez the boresight. Stars more than 90 degrees from the boresight get NaN coordinates, and fall outside any frame.
+ * Distortion models are fitted by least squares, e.g. to the chief ray positions of the 17 Zemax fields
+ * (centre, and a ring of 8 fields at 1.5' and 2.9').
+ */
+
+#include <cmath>
+#include <iostream>
+#include <limits>
+
+#include "Projection.hpp"
+#include "astroUtilities.hpp"
+
+namespace
+{
+// Terms 1, u, v, u^2, uv, v^2, ... up to the given order
+void polynomialTerms(double u, double v, uint16_t order, double *terms)
+{
+    uint16_t k = 0;
+    for (uint16_t degree = 0; degree <= order; degree++)
+    {
+        for (uint16_t j = 0; j <= degree; j++)
+        {
+            terms[k++] = pow(u, degree - j) * pow(v, j);
+        }
+    }
+}
+
+// Solves the square system A x = b in place, with partial pivoting
+std::vector<double> solve(std::vector<double> A, std::vector<double> b)
+{
+    const std::size_t n = b.size();
+    for (std::size_t col = 0; col < n; col++)
+    {
+        std::size_t pivot = col;
+        for (std::size_t row = col + 1; row < n; row++)
+        {
+            if (fabs(A[row * n + col]) > fabs(A[pivot * n + col]))
+                pivot = row;
+        }
+        if (fabs(A[pivot * n + col]) < 1e-300)
+        {
+            throw "Error! Distortion fit is singular. Use more fields or a lower order";
+        }
+        for (std::size_t k = 0; k < n; k++)
+        {
+            std::swap(A[col * n + k], A[pivot * n + k]);
+        }
+        std::swap(b[col], b[pivot]);
+
+        for (std::size_t row = col + 1; row < n; row++)
+        {
+            double factor = A[row * n + col] / A[col * n + col];
+            for (std::size_t k = col; k < n; k++)
+            {
+                A[row * n + k] -= factor * A[col * n + k];
+            }
+            b[row] -= factor * b[col];
+        }
+    }
+
+    std::vector<double> x(n);
+    for (std::size_t row = n; row-- > 0;)
+    {
+        double sum = b[row];
+        for (std::size_t k = row + 1; k < n; k++)
+        {
+            sum -= A[row * n + k] * x[k];
+        }
+        x[row] = sum / A[row * n + row];
+    }
+    return x;
+}
+} // namespace
+
+/**
+ * Shift due to distortion at an ideal position
+ *
+ * @param u Ideal x position relative to the frame centre, in pixels
+ * @param v Ideal y position relative to the frame centre, in pixels
+ * @param shiftX Shift in x, in pixels
+ * @param shiftY Shift in y, in pixels
+ */
+void DistortionModel::apply(double u, double v, double &shiftX, double &shiftY) const
+{
+    shiftX = 0;
+    shiftY = 0;
+    u /= radius;
+    v /= radius;
+
+    double uPowers[MAX_ORDER + 1], vPowers[MAX_ORDER + 1];
+    uPowers[0] = 1;
+    vPowers[0] = 1;
+    for (uint16_t i = 1; i <= order; i++)
+    {
+        uPowers[i] = uPowers[i - 1] * u;
+        vPowers[i] = vPowers[i - 1] * v;
+    }
+
+    std::size_t k = 0;
+    for (uint16_t degree = 0; degree <= order; degree++)
+    {
+        for (uint16_t j = 0; j <= degree; j++)
+        {
+            double term = uPowers[degree - j] * vPowers[j];
+            shiftX += dx[k] * term;
+            shiftY += dy[k] * term;
+            k++;
+        }
+    }
+}
+
+/**
+ * Least squares fit of a distortion model
+ *
+ * @param ideal Undistorted positions, relative to the frame centre, in pixels
+ * @param measured Measured positions, e.g. Zemax chief rays, relative to the frame centre, in pixels
+ * @param radius Normalisation radius, in pixels. Usually Projection::distortionRadius
+ * @param order Polynomial order
+ * @return Fitted model
+ */
+DistortionModel DistortionModel::fit(const std::vector<pixel_coordinates> &ideal, const std::vector<pixel_coordinates> &measured, double radius, uint16_t order)
+{
+    const uint16_t K = nTerms(order);
+    if (order > MAX_ORDER)
+    {
+        throw "Error! Distortion polynomial order is too high";
+    }
+    if (ideal.size() != measured.size() || ideal.size() < K)
+    {
+        throw "Error! Distortion fit needs matching positions, at least as many as the polynomial terms";
+    }
+
+    std::vector<double> normal(K * K, 0.0), rhsX(K, 0.0), rhsY(K, 0.0), terms(K);
+    for (std::size_t i = 0; i < ideal.size(); i++)
+    {
+        polynomialTerms(ideal[i].x / radius, ideal[i].y / radius, order, terms.data());
+        for (uint16_t a = 0; a < K; a++)
+        {
+            for (uint16_t b = 0; b < K; b++)
+            {
+                normal[a * K + b] += terms[a] * terms[b];
+            }
+            rhsX[a] += terms[a] * (measured[i].x - ideal[i].x);
+            rhsY[a] += terms[a] * (measured[i].y - ideal[i].y);
+        }
+    }
+
+    DistortionModel model;
+    model.order = order;
+    model.radius = radius;
+    model.dx = solve(normal, rhsX);
+    model.dy = solve(normal, rhsY);
+    return model;
+}
+
+/**
+ * Constructs a Projection object.
+ *
+ * @param _tel Telescope. Frame size, focal length and pixel size are used
+ * @param _pointing Boresight, in degrees
+ * @param _roll Angle from the tangent plane xi axis to the detector x axis, anticlockwise, in degrees
+ */
+Projection::Projection(Telescope _tel, sky_coordinates _pointing, double _roll)
+    : tel(_tel), scale(astroUtilities::plateScale(_tel)), frameCentre(astroUtilities::frameCenter(_tel.FRAME_W, _tel.FRAME_H))
+{
+    setPointing(_pointing, _roll);
+}
+
+Projection::~Projection()
+{
+#ifdef DEBUG_MEMORY
+    std::cout << "Destroyed Projection " << std::endl;
+#endif
+}
+
+void Projection::setPointing(sky_coordinates _pointing, double _roll)
+{
+    centre = _pointing;
+    roll = _roll;
+
+    const double toRad = M_PI / 180;
+    double ra = centre.ra * toRad, dec = centre.dec * toRad, r = roll * toRad;
+    double xi[3] = {-sin(ra), cos(ra), 0};
+    double eta[3] = {-sin(dec) * cos(ra), -sin(dec) * sin(ra), cos(dec)};
+    double bore[3] = {cos(dec) * cos(ra), cos(dec) * sin(ra), sin(dec)};
+
+    // Detector axes, scaled so that u.e / u.ez is in pixels
+    const double pixelsPerRad = (180 / M_PI) * 3600 / scale;
+    for (uint16_t i = 0; i < 3; i++)
+    {
+        ex[i] = (cos(r) * xi[i] + sin(r) * eta[i]) * pixelsPerRad;
+        ey[i] = (-sin(r) * xi[i] + cos(r) * eta[i]) * pixelsPerRad;
+        ez[i] = bore[i];
+    }
+}
+
+/**
+ * Shifts all projected positions, e.g. by the pointing jitter of a frame
+ *
+ * @param _offsetX Shift in x, in pixels
+ * @param _offsetY Shift in y, in pixels
+ */
+void Projection::setPointingOffset(double _offsetX, double _offsetY)
+{
+    offsetX = _offsetX;
+    offsetY = _offsetY;
+}
+
+// Half diagonal of the frame, in pixels
+double Projection::distortionRadius() const
+{
+    return sqrt(pow(tel.FRAME_W / 2.0, 2) + pow(tel.FRAME_H / 2.0, 2));
+}
+
+pixel_coordinates Projection::project(sky_coordinates star) const
+{
+    pixel_coordinates position;
+    project(1, &star.ra, &star.dec, &position.x, &position.y);
+    return position;
+}
+
+/**
+ * Projects arrays of sky positions
+ *
+ * @param n Number of stars
+ * @param ra Right ascensions, in degrees
+ * @param dec Declinations, in degrees
+ * @param x Output x positions, in pixels
+ * @param y Output y positions, in pixels
+ */
+void Projection::project(std::size_t n, const double *ra, const double *dec, double *x, double *y) const
+{
+    const std::size_t block = 256;
+    double ux[block], uy[block], uz[block];
+    for (std::size_t start = 0; start < n; start += block)
+    {
+        std::size_t count = std::min(block, n - start);
+        unitVectors(count, ra + start, dec + start, ux, uy, uz);
+        project(count, ux, uy, uz, x + start, y + start);
+    }
+}
+
+/**
+ * Projects arrays of unit vectors, as made by unitVectors. No trigonometry is needed.
+ *
+ * @param n Number of stars
+ * @param ux, uy, uz Unit vectors of the stars
+ * @param x Output x positions, in pixels
+ * @param y Output y positions, in pixels
+ */
+void Projection::project(std::size_t n, const double *__restrict ux, const double *__restrict uy, const double *__restrict uz, double *__restrict x, double *__restrict y) const
+{
+    const double ex0 = ex[0], ex1 = ex[1], ex2 = ex[2];
+    const double ey0 = ey[0], ey1 = ey[1], ey2 = ey[2];
+    const double ez0 = ez[0], ez1 = ez[1], ez2 = ez[2];
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+
+    // Ideal positions relative to the frame centre
+    for (std::size_t i = 0; i < n; i++)
+    {
+        double w = ux[i] * ez0 + uy[i] * ez1 + uz[i] * ez2;
+        double inverse = (w > 0) ? 1 / w : nan;
+        x[i] = (ux[i] * ex0 + uy[i] * ex1 + uz[i] * ex2) * inverse;
+        y[i] = (ux[i] * ey0 + uy[i] * ey1 + uz[i] * ey2) * inverse;
+    }
+
+    if (!distortion.empty())
+    {
+        for (std::size_t i = 0; i < n; i++)
+        {
+            double shiftX, shiftY;
+            distortion.apply(x[i], y[i], shiftX, shiftY);
+            x[i] += shiftX;
+            y[i] += shiftY;
+        }
+    }
+
+    const double cx = frameCentre.x + offsetX;
+    const double cy = frameCentre.y + offsetY;
+    for (std::size_t i = 0; i < n; i++)
+    {
+        x[i] += cx;
+        y[i] += cy;
+    }
+}
+
+/**
+ * Unit vectors of sky positions, in equatorial cartesian coordinates
+ */
+void Projection::unitVectors(std::size_t n, const double *__restrict ra, const double *__restrict dec, double *__restrict ux, double *__restrict uy, double *__restrict uz)
+{
+    const double toRad = M_PI / 180;
+    for (std::size_t i = 0; i < n; i++)
+    {
+        double cosDec = cos(dec[i] * toRad);
+        ux[i] = cosDec * cos(ra[i] * toRad);
+        uy[i] = cosDec * sin(ra[i] * toRad);
+        uz[i] = sin(dec[i] * toRad);
+    }
+}
+
+/**
+ * Field angles of the Zemax field grid: the centre, and rings of 8 fields at the inner and outer distance.
+ *
+ * @param inner Inner field offset, in arcsec
+ * @param outer Outer field offset, in arcsec
+ * @return Field angles along the detector axes, in arcsec
+ */
+std::vector<pixel_coordinates> Projection::fieldGrid(double inner, double outer)
+{
+    std::vector<pixel_coordinates> fields = {{0, 0}};
+    for (double offset : {inner, outer})
+    {
+        for (int16_t j = -1; j <= 1; j++)
+        {
+            for (int16_t i = -1; i <= 1; i++)
+            {
+                if (i != 0 || j != 0)
+                {
+                    fields.push_back({i * offset, j * offset});
+                }
+            }
+        }
+    }
+    return fields;
+}
@@ -0,0 +1,74 @@
+/**
+ * Twinkle FGS-Sim: Centroid recovery simulation
+ *
+ * @file Projection.hpp
+ * @brief Header file for DistortionModel struct and Projection class
+ * @author Claudio Arena
+ * @version 1.0.0 2026-10-18
+ */
+#pragma once
+
+#include <vector>
+
+#include "typedefs.h"
+#include "telescopes.h"
+
+/**
+ * Field distortion as a 2D polynomial of the ideal position, giving the shift in pixels.
+ * Positions are relative to the frame centre and normalised by the half diagonal of the frame.
+ * Terms are ordered by degree: 1, u, v, u^2, uv, v^2, u^3, ...
+ */
+struct DistortionModel
+{
+  static const uint16_t MAX_ORDER = 7;
+
+  uint16_t order = 0;
+  double radius = 1; // normalisation, in pixels
+  std::vector<double> dx, dy;
+
+  static uint16_t nTerms(uint16_t order) { return (order + 1) * (order + 2) / 2; }
+  bool empty() const { return dx.empty(); }
+  void apply(double u, double v, double &shiftX, double &shiftY) const;
+
+  static DistortionModel fit(const std::vector<pixel_coordinates> &ideal, const std::vector<pixel_coordinates> &measured, double radius, uint16_t order = 3);
+};
+
+/**
+ * Gnomonic projection of sky positions on the frame, for a given pointing and roll.
+ * x grows with the tangent plane coordinate xi (towards increasing RA) and y with eta (towards the north pole), at zero roll.
+ * Plate scale comes from the telescope focal length and pixel size. An optional distortion model is applied after the projection.
+ * Bulk versions run over plain arrays in tight loops, and a set of stars can be turned into unit vectors once, so that
+ * re-projecting it for each frame of a slewing or jittering sequence needs no trigonometry.
+ *
+ * @brief Class to place sky positions on the detector
+ */
+class Projection
+{
+public:
+  Projection(Telescope _tel, sky_coordinates _pointing = {0, 0}, double _roll = 0);
+  ~Projection();
+
+  void setPointing(sky_coordinates _pointing, double _roll = 0);
+  void setPointingOffset(double offsetX, double offsetY);
+  void setDistortion(DistortionModel model) { distortion = model; }
+
+  sky_coordinates pointing() const { return centre; }
+  double plateScale() const { return scale; }
+  double distortionRadius() const;
+
+  pixel_coordinates project(sky_coordinates star) const;
+  void project(std::size_t n, const double *ra, const double *dec, double *x, double *y) const;
+  void project(std::size_t n, const double *ux, const double *uy, const double *uz, double *x, double *y) const;
+
+  static void unitVectors(std::size_t n, const double *ra, const double *dec, double *ux, double *uy, double *uz);
+  static std::vector<pixel_coordinates> fieldGrid(double inner = 90, double outer = 174);
+
+private:
+  Telescope tel;
+  sky_coordinates centre;
+  double roll, scale;
+  double offsetX = 0, offsetY = 0; // pixels, e.g. from jitter
+  pixel_coordinates frameCentre;
+  double ex[3], ey[3], ez[3]; // detector x, detector y and boresight axes, in equatorial cartesian coordinates
+  DistortionModel distortion;
+};
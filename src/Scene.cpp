@@ -0,0 +1,246 @@
+/**
+ * Twinkle FGS-Sim: Centroid recovery simulation
+ *
+ * @file Scene.cpp
+ * @brief Star field with a uniform grid spatial index
+ * @author Claudio Arena
+ * @version 1.0.0 2026-10-18
+ * @description Star positions follow the Frame convention: x.0 is the centre of a pixel. A star is visible in a region if the
+ * square footprint of its PSF overlaps it. The index is a counting sort of the stars by cell, rebuilt lazily after ingestion.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "Scene.hpp"
+
+/**
+ * Constructs an empty Scene.
+ *
+ * @param _tel Telescope. Frame size and simels are used
+ * @param _cellSize Size of the index cells, in pixels
+ */
+Scene::Scene(Telescope _tel, uint16_t _cellSize) : tel(_tel), cellSize(std::max<uint16_t>(_cellSize, 1)), bandMags(_tel.FGS_filter.size())
+{
+    cellsX = (tel.FRAME_W + cellSize - 1) / cellSize;
+    cellsY = (tel.FRAME_H + cellSize - 1) / cellSize;
+}
+
+Scene::~Scene()
+{
+#ifdef DEBUG_MEMORY
+    std::cout << "Destroyed Scene " << std::endl;
+#endif
+}
+
+/**
+ * Adds a PSF shared by stars of the scene.
+ *
+ * @param stamp Normalised PSF stamp
+ * @return Id of the PSF, to be used when adding stars
+ */
+uint32_t Scene::addPSF(std::shared_ptr<const PSFStamp> stamp)
+{
+    std::lock_guard<std::mutex> guard(index_mutex);
+    psfs.push_back(stamp);
+    psfReach.push_back(std::max(stamp->halfWidth(), stamp->halfHeight()) / tel.SIMELS + 1);
+    maxReach = std::max(maxReach, psfReach.back());
+    indexed = false;
+    return psfs.size() - 1;
+}
+
+/**
+ * Adds many stars at once.
+ *
+ * @param n Number of stars
+ * @param x Star x coordinates, in pixels
+ * @param y Star y coordinates, in pixels
+ * @param mags nBands() magnitudes per star, star after star
+ * @param psfIds PSF id of each star, as returned by addPSF
+ */
+void Scene::addStars(std::size_t n, const double *x, const double *y, const double *mags, const uint32_t *psfIds_)
+{
+    std::lock_guard<std::mutex> guard(index_mutex);
+    for (std::size_t i = 0; i < n; i++)
+    {
+        if (psfIds_[i] >= psfs.size())
+        {
+            throw "Error! Scene star uses a PSF id that was not added";
+        }
+    }
+
+    xs.insert(xs.end(), x, x + n);
+    ys.insert(ys.end(), y, y + n);
+    psfIds.insert(psfIds.end(), psfIds_, psfIds_ + n);
+
+    const uint16_t bands = bandMags.size();
+    for (uint16_t band = 0; band < bands; band++)
+    {
+        std::vector<double> &column = bandMags[band];
+        std::size_t start = column.size();
+        column.resize(start + n);
+        for (std::size_t i = 0; i < n; i++)
+        {
+            column[start + i] = mags[i * bands + band];
+        }
+    }
+    indexed = false;
+}
+
+void Scene::addStars(const std::vector<double> &x, const std::vector<double> &y, const std::vector<double> &mags, const std::vector<uint32_t> &psfIds_)
+{
+    if (y.size() != x.size() || psfIds_.size() != x.size() || mags.size() != x.size() * nBands())
+    {
+        throw "Error! Scene star arrays have mismatched sizes";
+    }
+    addStars(x.size(), x.data(), y.data(), mags.data(), psfIds_.data());
+}
+
+/**
+ * Adds the stars of a catalog query, placed on the frame by a projection. All stars share one PSF.
+ *
+ * @param batch Catalog stars. Must have one magnitude per telescope filter
+ * @param projection Sky to frame projection
+ * @param psfId PSF id of the stars, as returned by addPSF
+ */
+void Scene::addStars(const catalog_batch &batch, const Projection &projection, uint32_t psfId)
+{
+    if (batch.nBands != nBands())
+    {
+        throw "Error! Catalog bands don't match the telescope filters";
+    }
+
+    std::vector<double> x(batch.size()), y(batch.size());
+    projection.project(batch.size(), batch.ra.data(), batch.dec.data(), x.data(), y.data());
+    std::vector<uint32_t> ids(batch.size(), psfId);
+    addStars(batch.size(), x.data(), y.data(), batch.mags.data(), ids.data());
+}
+
+void Scene::addStar(double x, double y, std::vector<double> mags, uint32_t psfId)
+{
+    if (mags.size() != nBands())
+    {
+        double refMag = mags.at(0);
+        mags.assign(nBands(), refMag);
+    }
+    addStars(1, &x, &y, mags.data(), &psfId);
+}
+
+void Scene::clear()
+{
+    std::lock_guard<std::mutex> guard(index_mutex);
+    xs.clear();
+    ys.clear();
+    psfIds.clear();
+    for (std::vector<double> &column : bandMags)
+    {
+        column.clear();
+    }
+    indexed = false;
+}
+
+std::vector<double> Scene::starMags(uint32_t id) const
+{
+    std::vector<double> mags(nBands());
+    for (uint16_t band = 0; band < nBands(); band++)
+    {
+        mags[band] = bandMags[band].at(id);
+    }
+    return mags;
+}
+
+/**
+ * Stars whose PSF footprint overlaps the frame or any of the given regions.
+ *
+ * @param rois Regions of interest, in pixels. Empty for the whole frame
+ * @return Ids of the visible stars, in increasing order
+ */
+std::vector<uint32_t> Scene::visible(const std::vector<pixel_window> &rois) const
+{
+    std::lock_guard<std::mutex> guard(index_mutex);
+    if (!indexed)
+    {
+        buildIndex();
+    }
+
+    std::vector<pixel_window> regions = rois;
+    if (regions.empty())
+    {
+        regions.push_back({0, 0, tel.FRAME_W, tel.FRAME_H});
+    }
+
+    std::vector<uint32_t> ids;
+    for (const pixel_window &roi : regions)
+    {
+        int32_t minCellX = std::max<int32_t>(0, (int32_t)std::floor((roi.x - maxReach) / cellSize));
+        int32_t minCellY = std::max<int32_t>(0, (int32_t)std::floor((roi.y - maxReach) / cellSize));
+        int32_t maxCellX = std::min<int32_t>(cellsX - 1, (int32_t)std::floor((roi.x + roi.width + maxReach) / cellSize));
+        int32_t maxCellY = std::min<int32_t>(cellsY - 1, (int32_t)std::floor((roi.y + roi.height + maxReach) / cellSize));
+
+        for (int32_t cy = minCellY; cy <= maxCellY; cy++)
+        {
+            for (int32_t cx = minCellX; cx <= maxCellX; cx++)
+            {
+                uint32_t cell = cy * cellsX + cx;
+                for (uint32_t k = cellStart[cell]; k < cellStart[cell + 1]; k++)
+                {
+                    if (touches(cellStars[k], roi))
+                    {
+                        ids.push_back(cellStars[k]);
+                    }
+                }
+            }
+        }
+    }
+
+    // Regions may overlap
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    return ids;
+}
+
+// Pixel x covers x - 0.5 to x + 0.5
+bool Scene::touches(uint32_t id, const pixel_window &roi) const
+{
+    double reach = psfReach[psfIds[id]];
+    return xs[id] + reach >= roi.x - 0.5 && xs[id] - reach <= roi.x + roi.width - 0.5 &&
+           ys[id] + reach >= roi.y - 0.5 && ys[id] - reach <= roi.y + roi.height - 0.5;
+}
+
+void Scene::buildIndex() const
+{
+    const pixel_window frame = {0, 0, tel.FRAME_W, tel.FRAME_H};
+    const uint32_t nCells = (uint32_t)cellsX * cellsY;
+    std::vector<uint32_t> starCell(size(), nCells);
+    cellStart.assign(nCells + 2, 0);
+
+    // Stars off the frame are indexed in the nearest border cell, as long as their footprint reaches the frame
+    for (uint32_t id = 0; id < size(); id++)
+    {
+        if (!touches(id, frame))
+        {
+            continue;
+        }
+        int32_t cx = std::min<int32_t>(std::max<int32_t>((int32_t)std::floor((xs[id] + 0.5) / cellSize), 0), cellsX - 1);
+        int32_t cy = std::min<int32_t>(std::max<int32_t>((int32_t)std::floor((ys[id] + 0.5) / cellSize), 0), cellsY - 1);
+        starCell[id] = cy * cellsX + cx;
+        cellStart[starCell[id] + 2]++;
+    }
+
+    for (uint32_t c = 2; c < nCells + 2; c++)
+    {
+        cellStart[c] += cellStart[c - 1];
+    }
+
+    cellStars.resize(cellStart[nCells + 1]);
+    for (uint32_t id = 0; id < size(); id++)
+    {
+        if (starCell[id] < nCells)
+        {
+            cellStars[cellStart[starCell[id] + 1]++] = id;
+        }
+    }
+    cellStart.pop_back();
+    indexed = true;
+}
@@ -0,0 +1,74 @@
+/**
+ * Twinkle FGS-Sim: Centroid recovery simulation
+ *
+ * @file Scene.hpp
+ * @brief Header file for Scene class
+ * @author Claudio Arena
+ * @version 1.0.0 2026-10-18
+ */
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "typedefs.h"
+#include "telescopes.h"
+#include "PolychromaticPSF.hpp"
+#include "Catalog.hpp"
+#include "Projection.hpp"
+
+/**
+ * A field of stars in frame pixel coordinates, shared between frames.
+ * Stars are stored as a structure of arrays: positions, one magnitude array per telescope filter and a PSF id.
+ * A uniform grid of cells over the frame indexes the stars whose PSF footprint touches the frame, so only the
+ * stars near the requested regions are looked at when a frame is rendered.
+ *
+ * @brief Class holding a star field with a spatial index
+ */
+class Scene
+{
+public:
+  Scene(Telescope _tel, uint16_t _cellSize = 32);
+  ~Scene();
+
+  uint32_t addPSF(std::shared_ptr<const PSFStamp> stamp);
+
+  // Bulk ingestion. mags holds nBands() magnitudes per star, star after star.
+  void addStars(std::size_t n, const double *x, const double *y, const double *mags, const uint32_t *psfIds);
+  void addStars(const std::vector<double> &x, const std::vector<double> &y, const std::vector<double> &mags, const std::vector<uint32_t> &psfIds);
+  void addStars(const catalog_batch &batch, const Projection &projection, uint32_t psfId = 0);
+  void addStar(double x, double y, std::vector<double> mags, uint32_t psfId = 0);
+  void clear();
+
+  std::vector<uint32_t> visible(const std::vector<pixel_window> &rois = {}) const;
+
+  std::size_t size() const { return xs.size(); }
+  uint16_t nBands() const { return bandMags.size(); }
+  const double *x() const { return xs.data(); }
+  const double *y() const { return ys.data(); }
+  const double *mags(uint16_t band) const { return bandMags.at(band).data(); }
+  std::vector<double> starMags(uint32_t id) const;
+  uint32_t psfId(uint32_t id) const { return psfIds.at(id); }
+  std::shared_ptr<const PSFStamp> psf(uint32_t id) const { return psfs.at(id); }
+
+private:
+  Telescope tel;
+  uint16_t cellSize, cellsX, cellsY;
+
+  std::vector<double> xs, ys;
+  std::vector<std::vector<double>> bandMags;
+  std::vector<uint32_t> psfIds;
+  std::vector<std::shared_ptr<const PSFStamp>> psfs;
+  std::vector<double> psfReach; // PSF half size, in pixels
+  double maxReach = 0;
+
+  // Stars touching the frame, sorted by cell. Stars of cell c are cellStars[cellStart[c]] to cellStars[cellStart[c + 1] - 1].
+  // Built on first use after stars are added.
+  mutable std::vector<uint32_t> cellStart, cellStars;
+  mutable bool indexed = false;
+  mutable std::mutex index_mutex;
+
+  void buildIndex() const;
+  bool touches(uint32_t id, const pixel_window &roi) const;
+};
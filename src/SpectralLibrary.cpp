@@ -0,0 +1,456 @@
+/**
+ * Twinkle FGS-Sim: Centroid recovery simulation
+ *
+ * @file SpectralLibrary.cpp
+ * @brief Filter curves, stellar SEDs and cached band integrals
+ * @author Claudio Arena
+ * @version 1.0.0 2026-10-18
+ * @description A star is described by its magnitude in the reference band and by an SED. The flux in each telescope band is
+ * the reference band flux, scaled by the ratio of the SED integrals through the band and through the reference filter.
+ * Integrals are computed once per (SED, filter, telescope) and cached, together with the telescope throughput, as ADU/s at magnitude 0.
+ * Stellar spectral types are approximated by blackbodies at the effective temperature of the type.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+
+#include "SpectralLibrary.hpp"
+#include "astroUtilities.hpp"
+#include "parameters.h"
+
+// Same magnitude scale used by astroUtilities::photonsInBand
+const double MAG_BASE_LOG = log(2.512);
+
+namespace
+{
+// Linear interpolation on a tabulated curve. Zero outside the table.
+double interpolate(const std::vector<double> &x, const std::vector<double> &y, double at)
+{
+    if (x.empty() || at < x.front() || at > x.back())
+    {
+        return 0;
+    }
+
+    std::size_t i = std::upper_bound(x.begin(), x.end(), at) - x.begin();
+    if (i >= x.size())
+    {
+        return y.back();
+    }
+    if (i == 0)
+    {
+        return y.front();
+    }
+
+    double f = (at - x[i - 1]) / (x[i] - x[i - 1]);
+    return y[i - 1] * (1 - f) + y[i] * f;
+}
+
+// Reads two whitespace separated columns. Lines starting with # are comments.
+void readColumns(std::string filename, std::vector<double> &x, std::vector<double> &y)
+{
+    std::ifstream file(filename);
+    if (file.fail())
+    {
+        throw "Error! Could not open spectral table file";
+    }
+
+    std::string line;
+    while (getline(file, line))
+    {
+        if (line.empty() || line[0] == '#')
+        {
+            continue;
+        }
+        std::stringstream linestream(line);
+        double a, b;
+        if (linestream >> a >> b)
+        {
+            x.push_back(a);
+            y.push_back(b);
+        }
+    }
+}
+} // namespace
+
+/**
+ * Builds a top-hat curve from a filter struct. Edges are 1e-3 nm wide.
+ *
+ * @param name Name of the filter
+ * @param flt Filter struct: B, V, R.
+ * @return Filter curve
+ */
+FilterCurve FilterCurve::topHat(std::string name, struct filter flt)
+{
+    double lo = flt.centerBand - flt.bandWidth / 2.0;
+    double hi = flt.centerBand + flt.bandWidth / 2.0;
+    FilterCurve curve;
+    curve.name = name;
+    curve.wavelength = {lo - 1e-3, lo, hi, hi + 1e-3};
+    curve.transmission = {0, 1, 1, 0};
+    return curve;
+}
+
+/**
+ * Loads a filter curve from a text file with two columns: wavelength in nm, transmission from 0 to 1.
+ */
+FilterCurve FilterCurve::fromFile(std::string name, std::string filename)
+{
+    FilterCurve curve;
+    curve.name = name;
+    readColumns(filename, curve.wavelength, curve.transmission);
+    return curve;
+}
+
+double FilterCurve::at(double lambda) const
+{
+    return interpolate(wavelength, transmission, lambda);
+}
+
+/**
+ * Builds a blackbody SED, as photon flux density.
+ *
+ * @param temperature Temperature in K
+ * @param minWavelength Shortest wavelength of the table, in nm
+ * @param maxWavelength Longest wavelength of the table, in nm
+ * @param step Table step, in nm
+ * @return Blackbody SED
+ */
+SED SED::blackbody(double temperature, double minWavelength, double maxWavelength, double step)
+{
+    SED sed;
+    sed.name = "BB" + std::to_string((int)std::round(temperature));
+
+    for (double lambda = minWavelength; lambda <= maxWavelength; lambda += step)
+    {
+        double l = lambda * 1E-9;
+        // Planck law divided by photon energy: photons per unit wavelength
+        double photons = pow(l, -4) / (exp((PLANCK * LIGHT_SPEED) / (l * BOLTZMANN * temperature)) - 1);
+        sed.wavelength.push_back(lambda);
+        sed.flux.push_back(photons);
+    }
+    return sed;
+}
+
+/**
+ * Loads an SED from a text file with two columns: wavelength in nm, photon flux density in arbitrary units.
+ */
+SED SED::fromFile(std::string name, std::string filename)
+{
+    SED sed;
+    sed.name = name;
+    readColumns(filename, sed.wavelength, sed.flux);
+    return sed;
+}
+
+double SED::at(double lambda) const
+{
+    return interpolate(wavelength, flux, lambda);
+}
+
+/**
+ * Constructs a SpectralLibrary object.
+ *
+ * @param _referenceBand Band in which star magnitudes are given
+ */
+SpectralLibrary::SpectralLibrary(struct filter _referenceBand)
+    : referenceCurve(FilterCurve::topHat("reference", _referenceBand)), referenceBand(_referenceBand)
+{
+}
+
+SpectralLibrary::~SpectralLibrary()
+{
+#ifdef DEBUG_MEMORY
+    std::cout << "Destroyed SpectralLibrary " << std::endl;
+#endif
+}
+
+/**
+ * Adds an SED to the library.
+ *
+ * @return Id of the SED, to be used in flux calculations
+ */
+uint16_t SpectralLibrary::addSED(SED sed)
+{
+    std::lock_guard<std::mutex> guard(library_mutex);
+    if (seds.size() >= std::numeric_limits<uint16_t>::max())
+    {
+        throw "Error! Too many SEDs in spectral library";
+    }
+    if (integrate(sed, referenceCurve) <= 0)
+    {
+        throw "Error! SED has no flux in the reference band";
+    }
+
+    seds.push_back(sed);
+    return seds.size() - 1;
+}
+
+/**
+ * Returns the id of a blackbody SED at the given temperature, adding it to the library the first time it is requested.
+ */
+uint16_t SpectralLibrary::blackbodySED(double temperature)
+{
+    {
+        std::lock_guard<std::mutex> guard(library_mutex);
+        auto it = blackbodies.find(temperature);
+        if (it != blackbodies.end())
+        {
+            return it->second;
+        }
+    }
+
+    uint16_t id = addSED(SED::blackbody(temperature));
+    std::lock_guard<std::mutex> guard(library_mutex);
+    blackbodies[temperature] = id;
+    return id;
+}
+
+/**
+ * Returns the id of the SED for a stellar spectral type, e.g. "G2V". Luminosity class is ignored.
+ */
+uint16_t SpectralLibrary::spectralTypeSED(std::string spectralType)
+{
+    return blackbodySED(spectralTypeTemperature(spectralType));
+}
+
+std::size_t SpectralLibrary::nSEDs() const
+{
+    std::lock_guard<std::mutex> guard(library_mutex);
+    return seds.size();
+}
+
+/**
+ * Replaces the top-hat filters of a telescope with tabulated curves. Cached integrals for the telescope are dropped.
+ *
+ * @param tel Telescope
+ * @param curves One curve per telescope filter, in the same order as tel.FGS_filter
+ */
+void SpectralLibrary::setTelescopeFilters(const Telescope &tel, std::vector<FilterCurve> curves)
+{
+    if (curves.size() != tel.FGS_filter.size())
+    {
+        throw "Error! Number of filter curves must match number of telescope filters";
+    }
+
+    const std::string telescope = astroUtilities::telescopeKey(tel);
+    std::lock_guard<std::mutex> guard(library_mutex);
+    telescopeFilters[telescope] = curves;
+    sedCoefficients.erase(telescope);
+    for (auto it = integrals.begin(); it != integrals.end();)
+    {
+        if (std::get<2>(it->first) == telescope)
+        {
+            it = integrals.erase(it);
+        }
+        else
+        {
+            it++;
+        }
+    }
+}
+
+/**
+ * ADUs per second received from a star of magnitude 0 with the given SED, through one telescope band.
+ *
+ * @param sedId Id of the SED
+ * @param band Index of the filter in the telescope filter set
+ * @param tel Telescope
+ * @return ADU/s at magnitude 0
+ */
+double SpectralLibrary::bandIntegral(uint16_t sedId, uint16_t band, const Telescope &tel)
+{
+    std::lock_guard<std::mutex> guard(library_mutex);
+    return integral(sedId, band, tel);
+}
+
+/**
+ * Magnitudes of a star in each telescope band, in the photometric system used by astroUtilities::photonsInBand.
+ * These can be passed to Frame::addSource, so the star gets the colour of its SED.
+ *
+ * @param mag Magnitude in the reference band
+ * @param sedId Id of the SED
+ * @param tel Telescope
+ * @return One magnitude per telescope filter
+ */
+std::vector<double> SpectralLibrary::bandMagnitudes(double mag, uint16_t sedId, const Telescope &tel)
+{
+    std::vector<double> mags(tel.FGS_filter.size());
+    for (uint16_t band = 0; band < mags.size(); band++)
+    {
+        double zeroPoint = astroUtilities::meanReceivedADUs(std::vector<double>{0.0}, std::vector<filter>{tel.FGS_filter[band]}, 1.0, tel);
+        mags[band] = mag - log(bandIntegral(sedId, band, tel) / zeroPoint) / MAG_BASE_LOG;
+    }
+    return mags;
+}
+
+double SpectralLibrary::meanReceivedADUs(double mag, uint16_t sedId, double expT, const Telescope &tel)
+{
+    double adus;
+    meanReceivedADUs(&mag, &sedId, 1, expT, tel, &adus);
+    return adus;
+}
+
+/**
+ * Vectorised version of astroUtilities::meanReceivedADUs, for arrays of stars.
+ *
+ * @param mags Reference band magnitude of each star
+ * @param sedIds SED id of each star
+ * @param expT Exposure time, in seconds
+ * @param tel Telescope
+ * @return Mean number of ADUs received from each star
+ */
+std::vector<double> SpectralLibrary::meanReceivedADUs(const std::vector<double> &mags, const std::vector<uint16_t> &sedIds, double expT, const Telescope &tel)
+{
+    if (mags.size() != sedIds.size())
+    {
+        throw "Error! Number of magnitudes and SED ids must match";
+    }
+
+    std::vector<double> adus(mags.size());
+    meanReceivedADUs(mags.data(), sedIds.data(), mags.size(), expT, tel, adus.data());
+    return adus;
+}
+
+// Same as above, writing into a caller owned buffer of n elements
+void SpectralLibrary::meanReceivedADUs(const double *mags, const uint16_t *sedIds, std::size_t n, double expT, const Telescope &tel, double *adus)
+{
+    std::vector<double> coeffs;
+    {
+        std::lock_guard<std::mutex> guard(library_mutex);
+        coeffs = coefficients(tel);
+    }
+
+    for (std::size_t i = 0; i < n; i++)
+    {
+        if (sedIds[i] >= coeffs.size())
+        {
+            throw "Error! Unknown SED id";
+        }
+    }
+
+    const double *c = coeffs.data();
+    for (std::size_t i = 0; i < n; i++)
+    {
+        adus[i] = c[sedIds[i]] * expT * exp(-MAG_BASE_LOG * mags[i]);
+    }
+}
+
+/**
+ * Effective temperature for a stellar spectral type, e.g. "G2V" or "M5". Interpolated between tabulated main sequence values.
+ *
+ * @param spectralType Spectral type. First character is the class (OBAFGKM), then the subclass digit.
+ * @return Temperature in K
+ */
+double SpectralLibrary::spectralTypeTemperature(std::string spectralType)
+{
+    // Type code is class index * 10 + subclass
+    static const std::vector<double> typeCode{5, 10, 15, 20, 25, 30, 35, 40, 45, 50, 55, 60, 65, 69};
+    static const std::vector<double> typeTemperature{42000, 30000, 15200, 9790, 8180, 7300, 6650, 5940, 5560, 5150, 4410, 3840, 3170, 2400};
+    static const std::string classes = "OBAFGKM";
+
+    if (spectralType.empty() || classes.find(toupper(spectralType[0])) == std::string::npos)
+    {
+        throw "Error! Unknown spectral type";
+    }
+
+    double code = classes.find(toupper(spectralType[0])) * 10;
+    if (spectralType.size() > 1 && isdigit(spectralType[1]))
+    {
+        code += spectralType[1] - '0';
+    }
+
+    code = std::min(std::max(code, typeCode.front()), typeCode.back());
+    return interpolate(typeCode, typeTemperature, code);
+}
+
+// Filter curves of a telescope. Top-hats from the telescope filter structs unless set with setTelescopeFilters.
+const std::vector<FilterCurve> &SpectralLibrary::filters(const Telescope &tel)
+{
+    const std::string telescope = astroUtilities::telescopeKey(tel);
+    auto it = telescopeFilters.find(telescope);
+    if (it == telescopeFilters.end())
+    {
+        std::vector<FilterCurve> curves;
+        for (std::size_t i = 0; i < tel.FGS_filter.size(); i++)
+        {
+            curves.push_back(FilterCurve::topHat(tel.NAME + "_" + std::to_string(i), tel.FGS_filter[i]));
+        }
+        it = telescopeFilters.emplace(telescope, curves).first;
+    }
+    return it->second;
+}
+
+double SpectralLibrary::integral(uint16_t sedId, uint16_t band, const Telescope &tel)
+{
+    if (sedId >= seds.size())
+    {
+        throw "Error! Unknown SED id";
+    }
+
+    auto key = std::make_tuple(sedId, band, astroUtilities::telescopeKey(tel));
+    auto it = integrals.find(key);
+    if (it != integrals.end())
+    {
+        return it->second;
+    }
+
+    const FilterCurve &curve = filters(tel).at(band);
+    double referenceADUs = astroUtilities::meanReceivedADUs(std::vector<double>{0.0}, std::vector<filter>{referenceBand}, 1.0, tel);
+    double value = referenceADUs * integrate(seds[sedId], curve) / integrate(seds[sedId], referenceCurve);
+    integrals[key] = value;
+    return value;
+}
+
+// Sum over the telescope bands, for each SED. Extended when SEDs are added to the library.
+std::vector<double> SpectralLibrary::coefficients(const Telescope &tel)
+{
+    std::vector<double> &coeffs = sedCoefficients[astroUtilities::telescopeKey(tel)];
+    for (uint16_t sedId = coeffs.size(); sedId < seds.size(); sedId++)
+    {
+        double total = 0;
+        for (uint16_t band = 0; band < tel.FGS_filter.size(); band++)
+        {
+            total += integral(sedId, band, tel);
+        }
+        coeffs.push_back(total);
+    }
+    return coeffs;
+}
+
+// Trapezoid integration of SED x transmission, on the union of both tables and a 1 nm grid
+double SpectralLibrary::integrate(const SED &sed, const FilterCurve &curve)
+{
+    if (curve.wavelength.size() < 2)
+    {
+        return 0;
+    }
+
+    double lo = curve.wavelength.front();
+    double hi = curve.wavelength.back();
+    std::vector<double> points(curve.wavelength);
+    for (double lambda : sed.wavelength)
+    {
+        if (lambda > lo && lambda < hi)
+        {
+            points.push_back(lambda);
+        }
+    }
+    for (double lambda = std::ceil(lo); lambda < hi; lambda += 1.0)
+    {
+        points.push_back(lambda);
+    }
+    std::sort(points.begin(), points.end());
+
+    double total = 0;
+    for (std::size_t i = 1; i < points.size(); i++)
+    {
+        double a = sed.at(points[i - 1]) * curve.at(points[i - 1]);
+        double b = sed.at(points[i]) * curve.at(points[i]);
+        total += 0.5 * (a + b) * (points[i] - points[i - 1]);
+    }
+    return total;
+}
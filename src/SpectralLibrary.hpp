@@ -0,0 +1,92 @@
+/**
+ * Twinkle FGS-Sim: Centroid recovery simulation
+ *
+ * @file SpectralLibrary.hpp
+ * @brief Header file for FilterCurve and SED structs, and SpectralLibrary class
+ * @author Claudio Arena
+ * @version 1.0.0 2026-10-18
+ */
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "typedefs.h"
+#include "telescopes.h"
+
+/**
+ * Tabulated filter transmission curve. Wavelengths in nm, increasing. Transmission from 0 to 1.
+ */
+struct FilterCurve
+{
+  std::string name;
+  std::vector<double> wavelength, transmission;
+
+  static FilterCurve topHat(std::string name, struct filter flt);
+  static FilterCurve fromFile(std::string name, std::string filename);
+  double at(double lambda) const;
+};
+
+/**
+ * Tabulated spectral energy distribution, as photon flux density in arbitrary units. Wavelengths in nm, increasing.
+ */
+struct SED
+{
+  std::string name;
+  std::vector<double> wavelength, flux;
+
+  static SED blackbody(double temperature, double minWavelength = 300, double maxWavelength = 1100, double step = 1);
+  static SED fromFile(std::string name, std::string filename);
+  double at(double lambda) const;
+};
+
+/**
+ * Holds filter curves and stellar SEDs, and caches the band integral of each (SED, filter, telescope) combination.
+ * Magnitudes are given in the reference band (Johnson V top-hat by default); fluxes in the other bands follow from the SED.
+ *
+ * @brief Class to compute fluxes of stars with a given SED through tabulated filters
+ */
+class SpectralLibrary
+{
+public:
+  SpectralLibrary(struct filter _referenceBand = V_filter);
+  ~SpectralLibrary();
+
+  uint16_t addSED(SED sed);
+  uint16_t blackbodySED(double temperature);
+  uint16_t spectralTypeSED(std::string spectralType);
+  std::size_t nSEDs() const;
+
+  void setTelescopeFilters(const Telescope &tel, std::vector<FilterCurve> curves);
+
+  double bandIntegral(uint16_t sedId, uint16_t band, const Telescope &tel);
+  std::vector<double> bandMagnitudes(double mag, uint16_t sedId, const Telescope &tel);
+
+  double meanReceivedADUs(double mag, uint16_t sedId, double expT, const Telescope &tel);
+  std::vector<double> meanReceivedADUs(const std::vector<double> &mags, const std::vector<uint16_t> &sedIds, double expT, const Telescope &tel);
+  void meanReceivedADUs(const double *mags, const uint16_t *sedIds, std::size_t n, double expT, const Telescope &tel, double *adus);
+
+  static double spectralTypeTemperature(std::string spectralType);
+
+private:
+  FilterCurve referenceCurve;
+  struct filter referenceBand;
+
+  std::vector<SED> seds;
+  std::map<double, uint16_t> blackbodies;
+  std::map<std::string, std::vector<FilterCurve>> telescopeFilters;
+
+  // ADU/s at magnitude 0, keyed by (SED, band, telescope key). Per telescope, also the sum over bands for each SED.
+  // Telescope keys hold all the parameters, see astroUtilities::telescopeKey.
+  std::map<std::tuple<uint16_t, uint16_t, std::string>, double> integrals;
+  std::map<std::string, std::vector<double>> sedCoefficients;
+  mutable std::mutex library_mutex;
+
+  const std::vector<FilterCurve> &filters(const Telescope &tel);
+  double integral(uint16_t sedId, uint16_t band, const Telescope &tel);
+  std::vector<double> coefficients(const Telescope &tel);
+  static double integrate(const SED &sed, const FilterCurve &curve);
+};
@@ -8,9 +8,12 @@
  * @version 1.0.0 2019-04-02
  */
 #include <cmath>
+#include <sstream>
 #include <vector>
 
 #include "astroUtilities.hpp"
+#include "SpectralLibrary.hpp"
+#include "parameters.h"
 #include "telescopes.h"
 #include "typedefs.h" //used for definition of PI
 
@@ -92,6 +95,19 @@ double meanReceivedADUs(std::vector<double> mags, std::vector<filter> fltrs, dou
     return meanReceivedPhotons(mags, fltrs, expT, tel) / tel.GAIN;
 }
 
+/**
+ * function to find the number of ADUs received from many stars, each with its own SED. Band integrals are cached by the library.
+ * @brief Finds the number of ADUs for arrays of stars
+ * @param mags Reference band magnitude of each star
+ * @param sedIds SED id of each star, from the spectral library
+ * @param library Spectral library holding the SEDs and filter curves
+ * @return Mean number of ADUs received from each star
+ */
+std::vector<double> meanReceivedADUs(const std::vector<double> &mags, const std::vector<uint16_t> &sedIds, double expT, const Telescope &tel, SpectralLibrary &library)
+{
+    return library.meanReceivedADUs(mags, sedIds, expT, tel);
+}
+
 /**
  * function to find the number of photons per second in the sum of multiple bands.
  * @brief Finds the number of photons per second for a given band combination and magnitude. 
@@ -139,16 +155,35 @@ double photonsInBand(double mag, struct filter flt)
     return photons;
 }
 
-/*
-double zodiacalNoise()
+/**
+ * function to find the zodiacal light signal collected by a single pixel.
+ *
+ * @brief Finds the zodiacal light signal per pixel
+ * @param tel Telescope used for calculation. Filters, throughput and plate scale are used
+ * @param surfaceBrightness Zodiacal light surface brightness, in mag/arcsec^2, one value per telescope filter
+ * @return Zodiacal light signal, given as ADU/sec/pixel
+ */
+double zodiacalSignal(Telescope tel, std::vector<double> surfaceBrightness)
 {
+    double pixelArea = pow(plateScale(tel), 2); // arcsec^2
+    return meanReceivedADUs(surfaceBrightness, tel.FGS_filter, 1.0, tel) * pixelArea;
+}
 
-    int zodiacalPhotons = 0;
-    if (zodiacal == true)
-        zodiacalPhotons += (180. / this->horizPixels) * (180. / this->vertPixels) * (astroUtilities::photonsInBand(22.37, B_filter) + astroUtilities::photonsInBand(21.89, V_filter)); // Background photons from zodiacal light. See line 84 of ../README.md.
-                                                                                                                                                                                       //float dark = darkSignal * exp(5E-7 * 6.63E-34 * ((1./248)-(1./temperature)) / 1.38E-23); // Dark current variance for 500nm from Meyer-Neidel
+/**
+ * function to find the ecliptic latitude of a pointing
+ *
+ * @brief Finds the ecliptic latitude of equatorial coordinates
+ * @param pointing Right ascension and declination, in degrees
+ * @return Ecliptic latitude, in degrees
+ */
+double eclipticLatitude(sky_coordinates pointing)
+{
+    const double obliquity = 23.4393 * (M_PI / 180);
+    double ra = pointing.ra * (M_PI / 180);
+    double dec = pointing.dec * (M_PI / 180);
+    double sinBeta = sin(dec) * cos(obliquity) - cos(dec) * sin(obliquity) * sin(ra);
+    return asin(sinBeta) * (180 / M_PI);
 }
-*/
 
 /**
  * Utility function to calculate the dark signal at the operating temperature given the 0 C dark noise specified by the telescope
@@ -166,21 +201,46 @@ double darkSignal(Telescope tel)
 }
 
 /**
- * Static function to calculate the number of infrared photons emitted by the mirrors through thermal emission.
+ * function to find the thermal emission of the mirrors, as seen by a single pixel within the telescope filters.
+ * Each mirror is treated as a grey body at MIRROR_TEMP with emissivity emiss, filling the beam of the camera.
  *
- * @brief Calculates noise from mirror infrared emission
- * @param tel Telescope used for calculation. Area of primary mirror and its temperature will be used
- * @return Number of infrared photons emitted from mirror per second
+ * @brief Calculates signal from mirror thermal emission
+ * @param tel Telescope used for calculation. Mirror temperature, emissivity, focal ratio and pixel size will be used
+ * @return Thermal signal, given as ADU/sec/pixel
  */
-/* 
-int mirrorThermalNoise(Telescope tel)
+double mirrorThermalSignal(Telescope tel)
 {
+    double pixelArea = pow(tel.PIXEL_SIZE * 1E-6, 2); // m^2
+    double focalRatio = tel.FOCAL_LENGTH / tel.DIAMETER;
+    double beamSolidAngle = M_PI / (4 * pow(focalRatio, 2)); // sr
+    double temperature = tel.MIRROR_TEMP;
+
+    double photons = 0; // photons / s / m^2 / sr, summed over filters
+    for (const filter &flt : tel.FGS_filter)
+    {
+        for (double lambda = flt.centerBand - flt.bandWidth / 2.0; lambda < flt.centerBand + flt.bandWidth / 2.0; lambda += 1.0)
+        {
+            double l = (lambda + 0.5) * 1E-9;
+            double radiance = (2 * LIGHT_SPEED / pow(l, 4)) / (exp((PLANCK * LIGHT_SPEED) / (l * BOLTZMANN * temperature)) - 1);
+            photons += radiance * 1E-9;
+        }
+    }
+
+    double emitted = photons * tel.emiss * tel.N_MIRRORS_TO_CAMERA * pixelArea * beamSolidAngle;
+    return emitted * tel.CCD_EFFICIENCY / tel.GAIN;
+}
 
-    float power = area * Twinkle.emiss * SB_CONST * pow(temperature, 4);
-    float wavelength = WIEN / temperature;
-    return power / (PLANCK * 3E8 / wavelength);
+/**
+ * function returning the plate scale of the telescope
+ *
+ * @brief Finds the angular size of a pixel
+ * @param tel Telescope used for calculation. Focal length and pixel size are used
+ * @return Plate scale, in arcsec/pixel
+ */
+double plateScale(Telescope tel)
+{
+    return (tel.PIXEL_SIZE * 1E-3 / tel.FOCAL_LENGTH) * (180 / M_PI) * 3600;
 }
-*/
 
 /**
  * function returning the coordinates of the center of the frame.
@@ -190,7 +250,7 @@ int mirrorThermalNoise(Telescope tel)
  * @param width The Width of the frame
  * @return Coordinates of the center of the frame, returned as a pixel_coordinates struct
  */
-pixel_coordinates frameCenter(uint16_t width, uint16_t heigth)
+pixel_coordinates frameCenter(uint32_t width, uint32_t heigth)
 {
     pixel_coordinates center = {(width / 2.0) - 0.5, (heigth / 2.0) - 0.5};
     return center;
@@ -241,4 +301,28 @@ bool vectorSizes(std::vector<std::size_t> sizes)
     return true;
 }
 
+/**
+ * Key of a telescope for caches of quantities derived from it. Holds the name and every parameter, so telescopes sharing
+ * a name but not their optics, detector or temperatures get different keys.
+ *
+ * @brief Finds the cache key of a telescope
+ * @param tel Telescope
+ * @return Key made of all the parameters of the telescope
+ */
+std::string telescopeKey(const Telescope &tel)
+{
+    std::ostringstream key;
+    key << std::hexfloat << tel.NAME << '|' << tel.SOURCE_TYPE << '|' << tel.SIMELS << '|' << tel.DIAMETER << '|'
+        << tel.EXTINCTION_COEFFICIENT << '|' << tel.N_MIRRORS_TO_CAMERA << '|' << tel.COATING_REFLECTIVITY << '|'
+        << tel.SECONDARY_DIAMETER << '|' << tel.FOCAL_LENGTH << '|' << tel.CCD_EFFICIENCY << '|' << tel.GAIN << '|'
+        << tel.FRAME_W << '|' << tel.FRAME_H << '|' << tel.PIXEL_SIZE << '|' << tel.FGS_BITS << '|' << tel.FGS_MAX_ADU << '|'
+        << tel.DARK_NOISE << '|' << tel.READOUT_NOISE << '|' << tel.OFFSET << '|' << tel.FGS_CCD_TEMP << '|'
+        << tel.IR_CCD_TEMP << '|' << tel.emiss << '|' << tel.MIRROR_TEMP;
+    for (const filter &flt : tel.FGS_filter)
+    {
+        key << '|' << flt.centerBand << ',' << flt.bandWidth << ',' << flt.zero_point_Jy;
+    }
+    return key.str();
+}
+
 } // namespace astroUtilities
\ No newline at end of file
@@ -12,21 +12,28 @@
 #include "telescopes.h"
 #include "typedefs.h"
 
+class SpectralLibrary;
+
 namespace astroUtilities
 {
 
 double meanReceivedPhotons(std::vector<double> mags, std::vector<filter> fltrs, double expT, Telescope tel);
 double meanReceivedADUs(std::vector<double> mags, std::vector<filter> fltrs, double expT, Telescope tel);
+std::vector<double> meanReceivedADUs(const std::vector<double> &mags, const std::vector<uint16_t> &sedIds, double expT, const Telescope &tel, SpectralLibrary &library);
 double photonsInBand(std::vector<double> mags, std::vector<filter> fltrs);
 double photonsInBand(double mag, struct filter flt);
 
 double darkSignal(Telescope tel);
+double zodiacalSignal(Telescope tel, std::vector<double> surfaceBrightness);
+double mirrorThermalSignal(Telescope tel);
+double plateScale(Telescope tel);
+double eclipticLatitude(sky_coordinates pointing);
 
 double airmass(double alt);
 double extinctionInMags(double alt, double extinction_coefficient);
 double extinctionInPercentage(double alt, double extinction_coefficient);
 
-pixel_coordinates frameCenter(uint16_t width, uint16_t heigth);
+pixel_coordinates frameCenter(uint32_t width, uint32_t heigth);
 double obstructionPercentage(double telescopeDiameter, double secondaryDiameter);
 double reflectionEfficiency(double coatingReflectivity, uint8_t NMirrors);
 //TODO: non obsctructed percentage
@@ -35,6 +42,9 @@ double reflectionEfficiency(double coatingReflectivity, uint8_t NMirrors);
 //Check if many vectors have same size
 bool vectorSizes(std::vector<std::size_t> sizes);
 
+//Key of all the parameters of a telescope, for caches depending on them
+std::string telescopeKey(const Telescope &tel);
+
 /**
  * Template utiliy method to calculate average of a vector
  * @brief Calculates the average of numbers held in a vector
@@ -4,4 +4,6 @@
 
 const float SB_CONST = 5.67E-8; // Stefan-Boltzmann constant
 const float WIEN = 2.9E-3;      // Wien's displacement constant
-const float PLANCK = 6.63E-34;  // Planck's constant
\ No newline at end of file
+const float PLANCK = 6.63E-34;  // Planck's constant
+const float LIGHT_SPEED = 3E8;   // Speed of light, m/s
+const float BOLTZMANN = 1.38E-23; // Boltzmann constant
\ No newline at end of file
@@ -28,11 +28,13 @@ struct Telescope
     const double N_MIRRORS_TO_CAMERA;    // M1, M2, fold, M3, FGS_M
     const double COATING_REFLECTIVITY;   // Al
     const double SECONDARY_DIAMETER;     // mm
+    const double FOCAL_LENGTH;           // mm
     const double CCD_EFFICIENCY;         // Average in bandpass
     const double GAIN;                   // e- / ADU
 
-    const uint16_t FRAME_W;
-    const uint16_t FRAME_H;
+    const uint32_t FRAME_W;
+    const uint32_t FRAME_H;
+    const double PIXEL_SIZE; // um
     //#define SOURCE_TYPE GAUSSIAN
     //#define SOURCE_TYPE PSF
     //#define FGS_BITS 8
@@ -44,6 +46,7 @@ struct Telescope
     double FGS_CCD_TEMP;        // in K
     double IR_CCD_TEMP;         // in K
     const double emiss;         // Mirror emissivity
+    const double MIRROR_TEMP;   // in K
     const std::vector<filter> FGS_filter;
 };
 
@@ -56,10 +59,12 @@ static Telescope Twinkle = {
     .N_MIRRORS_TO_CAMERA = 5.0,    // M1, M2, fold, M3, FGS_M
     .COATING_REFLECTIVITY = 0.94,  // Al
     .SECONDARY_DIAMETER = 85.0,    // mm
+    .FOCAL_LENGTH = 8800.0,        // mm. 6 arcmin across the CCD
     .CCD_EFFICIENCY = 0.65,        // Average in bandpass
     .GAIN = 1.0,                   // e- / ADU
     .FRAME_W = 1024,
     .FRAME_H = 1024,
+    .PIXEL_SIZE = 15.0, // e2v CCD230-42
     .FGS_BITS = 16,
     .FGS_MAX_ADU = (uint32_t)pow(2, Twinkle.FGS_BITS) - 1,
     .DARK_NOISE = 2.8761, // e- / pixel / sec. At 0C, derived from datasheet E2V CCD230-42. Note that this is a rough value.
@@ -68,6 +73,7 @@ static Telescope Twinkle = {
     .FGS_CCD_TEMP = 250, // Kelvin
     .IR_CCD_TEMP = 70,   // Kelvin
     .emiss = 0.02,       // Mirror emissivity
+    .MIRROR_TEMP = 250,  // Kelvin
     .FGS_filter = {B_filter, V_filter, R_filter},
 };
 
@@ -80,10 +86,12 @@ static Telescope TwentyCm = {
     .N_MIRRORS_TO_CAMERA = 2.0,     // M1, M2, fold, M3, FGS_M
     .COATING_REFLECTIVITY = 0.94,   // Al
     .SECONDARY_DIAMETER = 63.0,     // mm
+    .FOCAL_LENGTH = 1000.0,         // mm. Nominal
     .CCD_EFFICIENCY = 0.5,          // Average in bandpass
     .GAIN = 0.267,                  // e- / ADU
     .FRAME_W = 1280,
     .FRAME_H = 1024,
+    .PIXEL_SIZE = 5.2, // Nominal
     .FGS_BITS = 16,
     .FGS_MAX_ADU = (uint32_t)pow(2, TwentyCm.FGS_BITS) - 1,
     .DARK_NOISE = 0.1,
@@ -93,6 +101,7 @@ static Telescope TwentyCm = {
     .IR_CCD_TEMP = 273,
     //.FGS_BITS = 8,
     .emiss = 0.02, // Mirror emissivity
+    .MIRROR_TEMP = 283,
     .FGS_filter = {B_filter, V_filter, R_filter},
 };
 /*
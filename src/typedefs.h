@@ -18,6 +18,18 @@ struct pixel_coordinates
     double x, y;
 };
 
+// Rectangular region of a frame, in pixels
+struct pixel_window
+{
+    uint32_t x, y, width, height;
+};
+
+// Equatorial coordinates, in degrees
+struct sky_coordinates
+{
+    double ra, dec;
+};
+
 inline pixel_coordinates operator-(const pixel_coordinates &lhs, const pixel_coordinates &rhs)
 {
     pixel_coordinates result;
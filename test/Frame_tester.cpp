@@ -4,8 +4,31 @@
 #include "Frame.hpp"
 #include "FrameProcessor.hpp"
 #include "astroUtilities.hpp"
+#include "PolychromaticPSF.hpp"
+#include "SpectralLibrary.hpp"
+#include "Background.hpp"
+#include "Atmosphere.hpp"
+#include "Jitter.hpp"
+#include "Scene.hpp"
+#include "Catalog.hpp"
+#include "Projection.hpp"
+#include "LightCurve.hpp"
+#include "CosmicRays.hpp"
+#include "EMCCD.hpp"
+#include "CTI.hpp"
+#include "DetectorMTF.hpp"
+#include "DetectorSignature.hpp"
+#include "ADC.hpp"
+#include "PixelResponse.hpp"
+#include "GridStorage.hpp"
 
+#include <fstream>
 #include <memory>
+#include <numeric>
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+#include <unistd.h>
 #include "gtest/gtest.h"
 
 Telescope tel = Twinkle;
@@ -13,6 +36,37 @@ double expTime = 1.0; //sec
 double star_fwhm = 5.0;
 double star_mag = 13.0;
 
+// Twinkle with another name, frame size and simel count. Telescope fields are const, so variants are built whole.
+Telescope twinkleVariant(const std::string &name, uint32_t width, uint32_t height, uint16_t simels, uint16_t bits = Twinkle.FGS_BITS)
+{
+    return {
+        .NAME = name,
+        .SOURCE_TYPE = Twinkle.SOURCE_TYPE,
+        .SIMELS = simels,
+        .DIAMETER = Twinkle.DIAMETER,
+        .EXTINCTION_COEFFICIENT = Twinkle.EXTINCTION_COEFFICIENT,
+        .N_MIRRORS_TO_CAMERA = Twinkle.N_MIRRORS_TO_CAMERA,
+        .COATING_REFLECTIVITY = Twinkle.COATING_REFLECTIVITY,
+        .SECONDARY_DIAMETER = Twinkle.SECONDARY_DIAMETER,
+        .FOCAL_LENGTH = Twinkle.FOCAL_LENGTH,
+        .CCD_EFFICIENCY = Twinkle.CCD_EFFICIENCY,
+        .GAIN = Twinkle.GAIN,
+        .FRAME_W = width,
+        .FRAME_H = height,
+        .PIXEL_SIZE = Twinkle.PIXEL_SIZE,
+        .FGS_BITS = bits,
+        .FGS_MAX_ADU = (uint32_t)((1ull << bits) - 1),
+        .DARK_NOISE = Twinkle.DARK_NOISE,
+        .READOUT_NOISE = Twinkle.READOUT_NOISE,
+        .OFFSET = Twinkle.OFFSET,
+        .FGS_CCD_TEMP = Twinkle.FGS_CCD_TEMP,
+        .IR_CCD_TEMP = Twinkle.IR_CCD_TEMP,
+        .emiss = Twinkle.emiss,
+        .MIRROR_TEMP = Twinkle.MIRROR_TEMP,
+        .FGS_filter = Twinkle.FGS_filter,
+    };
+}
+
 //TODO: Test generation of small array. Check print, reset, setall
 //TODO: Check all utilities
 //TODO: check utility for center of frame:
@@ -123,6 +177,55 @@ TEST(FrameProcessor, centroid_statistical)
     EXPECT_NEAR(momentum.y, y, maxErr);
 }
 
+double stampSigmaX(const PSFStamp &stamp)
+{
+    double var = 0;
+    for (uint16_t y = 0; y < stamp.data.height(); y++)
+    {
+        for (uint16_t x = 0; x < stamp.data.width(); x++)
+        {
+            var += stamp.data(x, y) * pow(x - stamp.centerX, 2);
+        }
+    }
+    return sqrt(var) / stamp.oversampling;
+}
+
+TEST(PolychromaticPSF, colourCache)
+{
+    PolychromaticPSF psf(tel);
+    std::vector<double> blue{12.0, 13.0, 14.0};
+    std::vector<double> blue_fainter{12.5, 13.5, 14.5};
+    std::vector<double> red{14.0, 13.0, 12.0};
+
+    std::shared_ptr<const PSFStamp> blueStamp = psf.broadbandStamp(blue, star_fwhm, star_fwhm);
+    std::shared_ptr<const PSFStamp> redStamp = psf.broadbandStamp(red, star_fwhm, star_fwhm);
+
+    // Same colour, same stamp
+    EXPECT_EQ(blueStamp, psf.broadbandStamp(blue_fainter, star_fwhm, star_fwhm));
+    EXPECT_NEAR(std::accumulate(blueStamp->data.begin(), blueStamp->data.end(), 0.0), 1.0, 1e-9);
+    EXPECT_GT(stampSigmaX(*redStamp), stampSigmaX(*blueStamp));
+
+    // Reference band has the requested fwhm
+    std::shared_ptr<const PSFStamp> vStamp = psf.bandStamp(1, star_fwhm, star_fwhm);
+    EXPECT_NEAR(stampSigmaX(*vStamp), star_fwhm / 2.3585, 0.01);
+}
+
+TEST(FrameProcessor, centroid_chromatic)
+{
+    std::unique_ptr<Frame> frame = std::make_unique<Frame>(tel, expTime);
+    frame->setChromaticPSF(std::make_shared<PolychromaticPSF>(tel));
+
+    double x = 100.3;
+    double y = 300.8;
+    frame->addSource(x, y, star_fwhm, star_fwhm, std::vector<double>{11.0, 10.0, 9.5});
+    frame->generateFrame(true);
+
+    std::unique_ptr<FrameProcessor> fprocessor = std::make_unique<FrameProcessor>(frame->get());
+    pixel_coordinates momentum = fprocessor->multiple_guess_momentum(30, 4, 2);
+    EXPECT_NEAR(momentum.x, x, 0.1);
+    EXPECT_NEAR(momentum.y, y, 0.1);
+}
+
 TEST(astroUtilities, airMass)
 {
     EXPECT_NEAR(astroUtilities::airmass(5), 10.334, 0.001);
@@ -223,6 +326,1274 @@ TEST(astroUtilities, dark)
     EXPECT_NEAR(dark, 31.023, 0.001);
 }
 
+TEST(SpectralLibrary, bandIntegrals)
+{
+    SpectralLibrary library;
+    uint16_t hot = library.blackbodySED(10000);
+    uint16_t cool = library.spectralTypeSED("M0V");
+    EXPECT_EQ(hot, library.blackbodySED(10000));
+    EXPECT_NEAR(SpectralLibrary::spectralTypeTemperature("G2V"), 5788, 1);
+
+    // Reference band flux only depends on the magnitude
+    std::vector<double> hotMags = library.bandMagnitudes(12.0, hot, tel);
+    std::vector<double> coolMags = library.bandMagnitudes(12.0, cool, tel);
+    EXPECT_NEAR(hotMags[1], 12.0, 1e-3);
+    EXPECT_NEAR(coolMags[1], 12.0, 1e-3);
+    EXPECT_LT(hotMags[0] - hotMags[2], coolMags[0] - coolMags[2] - 1);
+
+    // Vectorised flux matches the per-band calculation
+    std::vector<double> mags{12.0, 14.5};
+    std::vector<uint16_t> seds{hot, cool};
+    std::vector<double> adus = astroUtilities::meanReceivedADUs(mags, seds, expTime, tel, library);
+    EXPECT_NEAR(adus[0], astroUtilities::meanReceivedADUs(hotMags, tel.FGS_filter, expTime, tel), adus[0] * 1e-6);
+    EXPECT_NEAR(adus[1], astroUtilities::meanReceivedADUs(library.bandMagnitudes(14.5, cool, tel), tel.FGS_filter, expTime, tel), adus[1] * 1e-6);
+
+    // Custom curves replace the top hats, and drop the cached integrals of the telescope
+    Telescope narrow = tel;
+    narrow.FGS_CCD_TEMP -= 20;
+    std::vector<double> before = library.bandMagnitudes(12.0, cool, narrow);
+    struct filter blue = {400, 20, B_filter.zero_point_Jy};
+    library.setTelescopeFilters(narrow, {FilterCurve::topHat("blue", blue), FilterCurve::topHat("V", V_filter), FilterCurve::topHat("R", R_filter)});
+    std::vector<double> after = library.bandMagnitudes(12.0, cool, narrow);
+    EXPECT_GT(std::abs(after[0] - before[0]), 0.1);
+    EXPECT_NEAR(after[2], before[2], 1e-9);
+    // Other parameters are other telescopes, with their own filters
+    EXPECT_NEAR(library.bandMagnitudes(12.0, cool, tel)[0], coolMags[0], 1e-9);
+}
+
+TEST(Background, cachedMap)
+{
+    Background background;
+    background.setThermal(false);
+    sky_coordinates pole = {270.0, 66.56};
+    sky_coordinates ecliptic = {0.0, 0.0};
+
+    EXPECT_NEAR(astroUtilities::eclipticLatitude(pole), 90.0, 0.01);
+    EXPECT_NEAR(background.rate(tel, ecliptic), 2 * background.rate(tel, pole), 1e-9);
+
+    std::shared_ptr<const Grid<double>> map = background.map(tel, 10.0, pole);
+    EXPECT_EQ(map, background.map(tel, 10.0, pole));
+    EXPECT_NE(map, background.map(tel, 20.0, pole));
+    // Same name, other parameters: the map is rebuilt
+    Telescope cold = tel;
+    cold.FGS_CCD_TEMP -= 20;
+    map = background.map(tel, 10.0, pole);
+    EXPECT_NE(map, background.map(cold, 10.0, pole));
+    EXPECT_NEAR((*map)(0, 0), background.rate(tel, pole) * 10.0, 1e-9);
+
+    background.setGradient(0.5, 0.0);
+    map = background.map(tel, 10.0, pole);
+    EXPECT_GT((*map)(tel.FRAME_W - 1, 0), (*map)(0, 0));
+}
+
+TEST(Atmosphere, seeingAndScintillation)
+{
+    Atmosphere atmosphere(TwentyCm, 0.1, 25.0, 10.0, 0.0, 90.0, 0.0, 512, 42);
+    EXPECT_NEAR(atmosphere.seeingFWHM(500.0), 1.011, 0.001);
+    EXPECT_NEAR(atmosphere.scintillationIndex(1.0), 1E-5 * pow(0.2, -4.0 / 3.0), 1e-9);
+
+    std::shared_ptr<const PSFStamp> stamp = atmosphere.shortExposurePSF(0.0, 1.0);
+    double total = 0, cx = 0;
+    for (uint16_t y = 0; y < stamp->data.height(); y++)
+    {
+        for (uint16_t x = 0; x < stamp->data.width(); x++)
+        {
+            total += stamp->data(x, y);
+            cx += stamp->data(x, y) * (x - stamp->centerX);
+        }
+    }
+    EXPECT_NEAR(total, 1.0, 1e-9);
+    EXPECT_LT(fabs(cx / stamp->oversampling), 0.5);
+    EXPECT_NE(stamp->data(stamp->centerX, stamp->centerY), atmosphere.shortExposurePSF(5.0, 1.0)->data(stamp->centerX, stamp->centerY));
+}
+
+TEST(Jitter, spectrumAndWindows)
+{
+    // Reaction wheel line plus slow drift
+    Jitter::PSD psd = Jitter::sum({Jitter::harmonic(20.0, 0.3, 0.5), Jitter::powerLaw(1E-3, 2.0, 0.01)});
+    Jitter jitter(psd, Jitter::harmonic(20.0, 0.3, 0.5), 200.0, 600.0, 7);
+
+    EXPECT_EQ(jitter.size(), 131072u);
+    EXPECT_NEAR(jitter.rms().y, 0.3, 0.03);
+
+    // Window means match a brute force average of the interpolated series, also across the wrap
+    const double windows[3][2] = {{1.0, 1.37}, {10.002, 12.5}, {jitter.duration() - 0.2, jitter.duration() + 0.3}};
+    for (const auto &window : windows)
+    {
+        double sum = 0;
+        const uint32_t steps = 20000;
+        for (uint32_t i = 0; i < steps; i++)
+        {
+            sum += jitter.offset(window[0] + (i + 0.5) * (window[1] - window[0]) / steps).x;
+        }
+        EXPECT_NEAR(jitter.meanOffset(window[0], window[1]).x, sum / steps, 1e-4);
+    }
+
+    pixel_coordinates slices[4];
+    jitter.meanOffsets(3.0, 0.25, 4, slices);
+    EXPECT_NEAR((slices[0].x + slices[1].x + slices[2].x + slices[3].x) / 4, jitter.meanOffset(3.0, 4.0).x, 1e-9);
+}
+
+TEST(FrameProcessor, centroid_jitter)
+{
+    // Slow drift only, so the frame centroid follows the mean offset over the exposure
+    std::shared_ptr<Jitter> jitter = std::make_shared<Jitter>(Jitter::powerLaw(2E-3, 2.0, 0.01), Jitter::powerLaw(2E-3, 2.0, 0.01), 100.0, 100.0, 3);
+    pixel_coordinates center = astroUtilities::frameCenter(Twinkle.FRAME_W, Twinkle.FRAME_H);
+    const double pixelScale = astroUtilities::plateScale(Twinkle);
+
+    std::unique_ptr<Frame> jitterFrame = std::make_unique<Frame>(Twinkle, expTime);
+    jitterFrame->setJitter(jitter, 10);
+    jitterFrame->setStartTime(20.0);
+    jitterFrame->addSource(center.x, center.y, star_fwhm, star_fwhm, 10.0);
+    jitterFrame->generateFrame(true);
+    EXPECT_DOUBLE_EQ(jitterFrame->getStartTime(), 20.0 + expTime);
+
+    pixel_coordinates mean = jitter->meanOffset(20.0, 20.0 + expTime);
+    std::unique_ptr<FrameProcessor> fprocessor = std::make_unique<FrameProcessor>(jitterFrame->get());
+    fprocessor->backgroundLevel(fprocessor->Random_Global);
+    pixel_coordinates centroid = fprocessor->multiple_guess_momentum(30, 4, 2);
+    EXPECT_NEAR(centroid.x, center.x + mean.x / pixelScale, 0.1);
+    EXPECT_NEAR(centroid.y, center.y + mean.y / pixelScale, 0.1);
+}
+
+TEST(Scene, culling)
+{
+    PolychromaticPSF psf(tel);
+    Scene scene(tel, 32);
+    uint32_t narrow = scene.addPSF(psf.bandStamp(1, 2.0, 2.0));
+    uint32_t wide = scene.addPSF(psf.bandStamp(1, 8.0, 8.0));
+
+    // Dense field, three times wider than the frame
+    std::mt19937 generator(5);
+    std::uniform_real_distribution<double> position(-1024.0, 2048.0);
+    const std::size_t n = 20000;
+    std::vector<double> x(n), y(n), mags(n * scene.nBands(), 14.0);
+    std::vector<uint32_t> psfIds(n);
+    for (std::size_t i = 0; i < n; i++)
+    {
+        x[i] = position(generator);
+        y[i] = position(generator);
+        psfIds[i] = (i % 2) ? narrow : wide;
+    }
+    scene.addStars(x, y, mags, psfIds);
+    EXPECT_EQ(scene.size(), n);
+
+    std::vector<pixel_window> rois = {{100, 100, 64, 64}, {130, 130, 64, 64}, {900, 20, 50, 50}};
+    std::vector<uint32_t> visible = scene.visible(rois);
+
+    // Brute force check of the footprint overlap
+    std::vector<uint32_t> expected;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        const PSFStamp &stamp = *scene.psf(psfIds[i]);
+        double reach = std::max(stamp.halfWidth(), stamp.halfHeight()) / tel.SIMELS + 1;
+        for (const pixel_window &roi : rois)
+        {
+            if (x[i] + reach >= roi.x - 0.5 && x[i] - reach <= roi.x + roi.width - 0.5 && y[i] + reach >= roi.y - 0.5 && y[i] - reach <= roi.y + roi.height - 0.5)
+            {
+                expected.push_back(i);
+                break;
+            }
+        }
+    }
+    EXPECT_EQ(visible, expected);
+    EXPECT_GT(visible.size(), 0u);
+}
+
+TEST(FrameProcessor, centroid_scene)
+{
+    PolychromaticPSF psf(tel);
+    Scene scene(tel);
+    uint32_t id = scene.addPSF(psf.bandStamp(1, star_fwhm, star_fwhm));
+    scene.addStar(100.3, 300.8, {10.0}, id);
+    scene.addStar(-200.0, 300.0, {8.0}, id);
+    scene.addStar(700.0, 700.0, {8.0}, id);
+
+    std::unique_ptr<Frame> sceneFrame = std::make_unique<Frame>(tel, expTime);
+    EXPECT_EQ(sceneFrame->addScene(scene, {{50, 250, 100, 100}}), 1u);
+    sceneFrame->generateFrame(true);
+
+    std::unique_ptr<FrameProcessor> fprocessor = std::make_unique<FrameProcessor>(sceneFrame->get());
+    pixel_coordinates momentum = fprocessor->multiple_guess_momentum(30, 4, 2);
+    EXPECT_NEAR(momentum.x, 100.3, 0.1);
+    EXPECT_NEAR(momentum.y, 300.8, 0.1);
+}
+
+TEST(Catalog, queries)
+{
+    // Stars spread uniformly on the sphere
+    std::mt19937 generator(11);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    const std::size_t n = 50000;
+    std::vector<double> ra(n), dec(n);
+    std::ofstream csv("catalog_test.csv");
+    csv << "ra,dec,B,V,R" << std::endl;
+    for (std::size_t i = 0; i < n; i++)
+    {
+        ra[i] = 360.0 * uniform(generator);
+        dec[i] = asin(2 * uniform(generator) - 1) * 180 / M_PI;
+        csv << ra[i] << "," << dec[i] << "," << 12.0 << "," << 11.0 << "," << 10.0 + i % 5 << std::endl;
+    }
+    csv.close();
+
+    EXPECT_EQ(Catalog::convertCSV("catalog_test.csv", "catalog_test.bin", 2.0), n);
+    Catalog catalog("catalog_test.bin");
+    EXPECT_EQ(catalog.size(), n);
+    EXPECT_EQ(catalog.nBands(), 3);
+
+    // Compare with brute force, using the values as written to the csv
+    std::ifstream written("catalog_test.csv");
+    std::string line;
+    getline(written, line);
+    for (std::size_t i = 0; i < n && getline(written, line); i++)
+    {
+        sscanf(line.c_str(), "%lf,%lf", &ra[i], &dec[i]);
+    }
+
+    const sky_coordinates centers[3] = {{359.5, 10.0}, {120.0, 88.5}, {45.0, -30.0}};
+    for (const sky_coordinates &center : centers)
+    {
+        const double radius = 3.0;
+        std::size_t expected = 0;
+        for (std::size_t i = 0; i < n; i++)
+        {
+            double cosDistance = sin(center.dec * M_PI / 180) * sin(dec[i] * M_PI / 180) +
+                                 cos(center.dec * M_PI / 180) * cos(dec[i] * M_PI / 180) * cos((ra[i] - center.ra) * M_PI / 180);
+            expected += (cosDistance >= cos(radius * M_PI / 180));
+        }
+        catalog_batch batch = catalog.cone(center, radius);
+        EXPECT_EQ(batch.size(), expected);
+        EXPECT_EQ(batch.mags.size(), batch.size() * 3);
+    }
+
+    std::size_t expected = 0;
+    for (std::size_t i = 0; i < n; i++)
+    {
+        expected += ((ra[i] >= 355.0 || ra[i] <= 5.0) && dec[i] >= -5.0 && dec[i] <= 5.0);
+    }
+    catalog_batch box = catalog.rectangle(355.0, 5.0, -5.0, 5.0);
+    EXPECT_EQ(box.size(), expected);
+    for (std::size_t i = 0; i < box.size(); i++)
+    {
+        EXPECT_FLOAT_EQ(box.mags[i * 3 + 1], 11.0);
+    }
+    std::remove("catalog_test.csv");
+    std::remove("catalog_test.bin");
+}
+
+TEST(Projection, gnomonicAndDistortion)
+{
+    sky_coordinates pointing = {150.0, 30.0};
+    Projection projection(Twinkle, pointing);
+    pixel_coordinates center = astroUtilities::frameCenter(Twinkle.FRAME_W, Twinkle.FRAME_H);
+    const double scale = astroUtilities::plateScale(Twinkle);
+
+    pixel_coordinates p = projection.project(pointing);
+    EXPECT_NEAR(p.x, center.x, 1e-9);
+    EXPECT_NEAR(p.y, center.y, 1e-9);
+    p = projection.project({pointing.ra, pointing.dec + 100.0 / 3600});
+    EXPECT_NEAR(p.x, center.x, 1e-6);
+    EXPECT_NEAR(p.y, center.y + 100.0 / scale, 1e-3);
+
+    // Rolled by 90 degrees, the detector x axis points north
+    Projection rolled(Twinkle, pointing, 90.0);
+    p = rolled.project({pointing.ra, pointing.dec + 100.0 / 3600});
+    EXPECT_NEAR(p.x, center.x + 100.0 / scale, 1e-3);
+
+    // Fit a known distortion on the 17 field grid, then check it between the fields
+    auto distort = [](pixel_coordinates ideal) {
+        double r2 = (ideal.x * ideal.x + ideal.y * ideal.y) / 1E6;
+        return pixel_coordinates{ideal.x * (1 + 0.002 * r2) + 0.5, ideal.y * (1 + 0.002 * r2) - 0.3};
+    };
+    std::vector<pixel_coordinates> ideal, measured;
+    for (pixel_coordinates field : Projection::fieldGrid())
+    {
+        ideal.push_back({field.x / scale, field.y / scale});
+        measured.push_back(distort(ideal.back()));
+    }
+    projection.setDistortion(DistortionModel::fit(ideal, measured, projection.distortionRadius(), 3));
+
+    std::vector<double> ra = {pointing.ra + 0.02, pointing.ra - 0.03, pointing.ra};
+    std::vector<double> dec = {pointing.dec + 0.01, pointing.dec - 0.02, pointing.dec + 0.035};
+    std::vector<double> x(3), y(3), ux(3), uy(3), uz(3), xv(3), yv(3);
+    projection.project(3, ra.data(), dec.data(), x.data(), y.data());
+    Projection::unitVectors(3, ra.data(), dec.data(), ux.data(), uy.data(), uz.data());
+    projection.project(3, ux.data(), uy.data(), uz.data(), xv.data(), yv.data());
+
+    Projection undistorted(Twinkle, pointing);
+    for (uint16_t i = 0; i < 3; i++)
+    {
+        pixel_coordinates q = undistorted.project({ra[i], dec[i]});
+        pixel_coordinates expected = distort({q.x - center.x, q.y - center.y});
+        EXPECT_NEAR(x[i], center.x + expected.x, 0.01);
+        EXPECT_NEAR(y[i], center.y + expected.y, 0.01);
+        EXPECT_DOUBLE_EQ(x[i], xv[i]);
+        EXPECT_DOUBLE_EQ(y[i], yv[i]);
+    }
+}
+
+TEST(LightCurve, transit)
+{
+    // Hot Jupiter: 3 day period, Rp/Rs = 0.1, a/Rs = 8
+    const double day = 86400.0;
+    TransitLightCurve uniform(day, 3 * day, 0.1, 8.0);
+    EXPECT_NEAR(uniform.flux(day), 1 - 0.01, 1e-4);
+    EXPECT_DOUBLE_EQ(uniform.flux(day + 0.3 * day), 1.0);
+    EXPECT_DOUBLE_EQ(uniform.flux(day + 1.5 * day), 1.0); // secondary eclipse not modelled
+
+    // Limb darkening makes the centre of the transit deeper
+    TransitLightCurve darkened(day, 3 * day, 0.1, 8.0, 90.0, 0.4, 0.25);
+    EXPECT_LT(darkened.flux(day), uniform.flux(day));
+    EXPECT_GT(darkened.flux(day + 0.05 * day), darkened.flux(day));
+
+    TabulatedLightCurve table({0.0, 10.0, 20.0}, {1.0, 0.5, 1.0}, 20.0);
+    EXPECT_DOUBLE_EQ(table.flux(5.0), 0.75);
+    EXPECT_DOUBLE_EQ(table.flux(45.0), 0.75);
+}
+
+double windowSignal(const Frame &fr, uint16_t cx, uint16_t cy, uint16_t half)
+{
+    double signal = 0, background = 0;
+    for (uint16_t y = cy - half; y <= cy + half; y++)
+    {
+        for (uint16_t x = cx - half; x <= cx + half; x++)
+        {
+            signal += fr(x, y);
+            background += fr(x + 4 * half, y);
+        }
+    }
+    return signal - background;
+}
+
+TEST(Frame, lightCurve)
+{
+    pixel_coordinates center = astroUtilities::frameCenter(Twinkle.FRAME_W, Twinkle.FRAME_H);
+    std::unique_ptr<Frame> sequence = std::make_unique<Frame>(Twinkle, expTime);
+    sequence->addSource(center.x, center.y, star_fwhm, star_fwhm, 11.0);
+    sequence->setLightCurve(std::make_shared<TabulatedLightCurve>(std::vector<double>{0.0, 2.0}, std::vector<double>{1.0, 0.5}));
+
+    // Mid exposure of the first frame is at 0.5 s, of the second at 1.5 s. No setup between frames.
+    sequence->generateFrame(true);
+    double first = windowSignal(*sequence, center.x, center.y, 15);
+    sequence->generateFrame(true);
+    double second = windowSignal(*sequence, center.x, center.y, 15);
+
+    EXPECT_NEAR(second / first, 0.625 / 0.875, 0.02);
+}
+
+TEST(FrameProcessor, centroid_events)
+{
+    pixel_coordinates center = astroUtilities::frameCenter(Twinkle.FRAME_W, Twinkle.FRAME_H);
+    std::unique_ptr<Frame> sparse = std::make_unique<Frame>(Twinkle, expTime);
+    sparse->addSource(center.x + 20.3, center.y - 40.6, star_fwhm, star_fwhm, 13.0);
+
+    EventList events = sparse->generateEvents(true);
+    EXPECT_LT(events.bytes(), Twinkle.FRAME_W * Twinkle.FRAME_H * sizeof(uint32_t) / 10);
+
+    uint64_t detections = 0;
+    for (const pixel_event &event : events.events)
+    {
+        detections += event.count;
+    }
+    EXPECT_EQ(events.photons.size(), detections);
+    for (const photon_event &photon : events.photons)
+    {
+        EXPECT_GE(photon.time, 0.0);
+        EXPECT_LT(photon.time, expTime);
+    }
+
+    pixel_coordinates guess = FrameProcessor::initial_guess_momentum(&events, 4);
+    pixel_coordinates centroid = FrameProcessor::fine_momentum(&events, guess.x, guess.y, 30, 2);
+    EXPECT_NEAR(centroid.x, center.x + 20.3, 0.1);
+    EXPECT_NEAR(centroid.y, center.y - 40.6, 0.1);
+
+    // Same answer from the dense version of the same frame
+    Grid<uint32_t> dense = events.densify();
+    pixel_coordinates denseCentroid = FrameProcessor::fine_momentum(&dense, guess.x, guess.y, 31, 2);
+    EXPECT_NEAR(denseCentroid.x, centroid.x, 0.05);
+    EXPECT_NEAR(denseCentroid.y, centroid.y, 0.05);
+
+    // Nothing above the threshold: the window centre, not NaN
+    EventList faint(64, 48);
+    faint.setBackground(100.0);
+    std::vector<uint64_t> pixels = {10 * 64 + 20, 10 * 64 + 20};
+    faint.build(pixels);
+    pixel_coordinates empty = FrameProcessor::momentum(&faint, 1000);
+    EXPECT_DOUBLE_EQ(empty.x, 31.5);
+    EXPECT_DOUBLE_EQ(empty.y, 23.5);
+    EXPECT_EQ(FrameProcessor::total(&faint, 1000), 0u);
+    empty = FrameProcessor::fine_momentum(&faint, 40.0, 30.0, 10, 4);
+    EXPECT_DOUBLE_EQ(empty.x, 40.0);
+    EXPECT_DOUBLE_EQ(empty.y, 30.0);
+
+    // Past 2^32 pixels, indices and the arithmetic on them are 64 bit. The list is sparse, so nothing this big is
+    // allocated.
+    EventList huge(100000, 100000);
+    std::vector<uint64_t> far(3, (uint64_t)90000 * 100000 + 500);
+    huge.build(far);
+    ASSERT_EQ(huge.events.size(), 1u);
+    EXPECT_EQ(huge.events[0].pixel, (uint64_t)9000000500);
+    EXPECT_EQ(huge.events[0].count, 3u);
+    pixel_coordinates farCentroid = FrameProcessor::momentum(&huge);
+    EXPECT_DOUBLE_EQ(farCentroid.x, 500.0);
+    EXPECT_DOUBLE_EQ(farCentroid.y, 90000.0);
+}
+
+TEST(Frame, manySources)
+{
+    // More stars than 16 bit source indices hold. Only the last one is bright.
+    PolychromaticPSF psf(tel);
+    Scene scene(tel, 32);
+    uint32_t stamp = scene.addPSF(psf.bandStamp(1, 2.0, 2.0));
+    const std::size_t n = 70000;
+    std::vector<double> x(n), y(n), mags(n * scene.nBands(), 25.0);
+    std::vector<uint32_t> psfIds(n, stamp);
+    for (std::size_t i = 0; i < n; i++)
+    {
+        x[i] = 10 + i % 1000;
+        y[i] = 10 + (i / 1000) * 10;
+    }
+    std::fill(mags.end() - scene.nBands(), mags.end(), 9.0);
+    scene.addStars(x, y, mags, psfIds);
+
+    std::unique_ptr<Frame> frame = std::make_unique<Frame>(tel, expTime);
+    EXPECT_EQ(frame->addScene(scene), n);
+    EventList events = frame->generateEvents(true);
+    uint64_t last = 0;
+    for (const photon_event &photon : events.photons)
+    {
+        ASSERT_LT(photon.source, n);
+        if (photon.source == n - 1)
+        {
+            last++;
+            EXPECT_NEAR(photon.pixel % tel.FRAME_W, x[n - 1], 5);
+            EXPECT_NEAR(photon.pixel / tel.FRAME_W, y[n - 1], 5);
+        }
+    }
+    EXPECT_GT(last, 1000u);
+}
+
+TEST(CosmicRays, injectionAndRejection)
+{
+    // Tracks keep their charge, up to rounding
+    Grid<uint32_t> empty(64, 64);
+    double x0 = 10.2, y0 = 12.7, x1 = 40.9, y1 = 30.1, charge = 50000;
+    CosmicRays::drawTracks(1, &x0, &y0, &x1, &y1, &charge, empty);
+    uint64_t deposited = FrameProcessor::total(&empty);
+    EXPECT_NEAR(deposited, charge, charge * 0.01);
+    EXPECT_GT(FrameProcessor::rejectCosmicRays(&empty, star_fwhm), 0u);
+    EXPECT_LT(FrameProcessor::total(&empty), charge * 0.01);
+
+    pixel_coordinates center = astroUtilities::frameCenter(Twinkle.FRAME_W, Twinkle.FRAME_H);
+    std::unique_ptr<Frame> clean = std::make_unique<Frame>(Twinkle, expTime);
+    clean->addSource(center.x + 3.4, center.y - 7.2, star_fwhm, star_fwhm, 11.0);
+    clean->generateFrame(true);
+    Grid<uint32_t> cleanFrame = *clean->get();
+    EXPECT_LT(FrameProcessor::rejectCosmicRays(&cleanFrame, star_fwhm), 5u);
+
+    // Ten times the flux at L2
+    std::shared_ptr<CosmicRays> rays = std::make_shared<CosmicRays>(50.0, 16.0, 80.0, 7);
+    EXPECT_NEAR(rays->expectedHits(Twinkle, expTime), 50.0 * pow(1024 * 15E-4, 2), 1E-6);
+    clean->setCosmicRays(rays);
+    std::vector<Grid<uint32_t>> sequence;
+    for (uint16_t k = 0; k < 5; k++)
+    {
+        clean->generateFrame(true);
+        sequence.push_back(*clean->get());
+    }
+
+    // Random hits only
+    Grid<uint32_t> single = sequence[1];
+    EXPECT_GT(FrameProcessor::rejectCosmicRays(&single, star_fwhm), 100u);
+    pixel_coordinates guess = FrameProcessor::initial_guess_momentum(&single, 4);
+    pixel_coordinates centroid = FrameProcessor::fine_momentum(&single, guess.x, guess.y, 30, 2);
+    EXPECT_NEAR(centroid.x, center.x + 3.4, 0.1);
+    EXPECT_NEAR(centroid.y, center.y - 7.2, 0.1);
+
+    // A bright track through the wing of the star pulls the centroid by more than a pixel. Rejection has to bridge it.
+    double sx = center.x - 20, sy = center.y - 14, ex = center.x + 25, ey = center.y - 10, q = 60000;
+    CosmicRays::drawTracks(1, &sx, &sy, &ex, &ey, &q, sequence[0]);
+    single = sequence[0];
+    pixel_coordinates hit = FrameProcessor::fine_momentum(&single, guess.x, guess.y, 30, 2);
+    FrameProcessor::rejectCosmicRays(&single, star_fwhm);
+    centroid = FrameProcessor::fine_momentum(&single, guess.x, guess.y, 30, 2);
+    EXPECT_GT(std::abs(hit.y - (center.y - 7.2)), 1.0);
+    EXPECT_NEAR(centroid.x, center.x + 3.4, 0.2);
+    EXPECT_NEAR(centroid.y, center.y - 7.2, 0.2);
+
+    // The sequence is clipped against the other frames
+    std::vector<Grid<uint32_t> *> frames;
+    for (Grid<uint32_t> &grid : sequence)
+    {
+        frames.push_back(&grid);
+    }
+    EXPECT_GT(FrameProcessor::rejectCosmicRays(frames), 100u);
+    centroid = FrameProcessor::fine_momentum(&sequence[0], guess.x, guess.y, 30, 2);
+    EXPECT_NEAR(centroid.x, center.x + 3.4, 0.1);
+    EXPECT_NEAR(centroid.y, center.y - 7.2, 0.1);
+}
+
+TEST(EMCCD, gammaGain)
+{
+    // Erlang and Marsaglia-Tsang routes: mean n g, variance n g^2
+    EMCCD em(300, 0.01);
+    std::mt19937 generator(11);
+    for (uint32_t k : {3u, 120u})
+    {
+        std::vector<uint32_t> electrons(100000, k);
+        std::vector<double> out(electrons.size());
+        em.multiply(electrons.data(), out.data(), out.size(), generator);
+        double mean = std::accumulate(out.begin(), out.end(), 0.0) / out.size();
+        double var = 0;
+        for (double value : out)
+        {
+            var += pow(value - mean, 2);
+        }
+        var /= out.size();
+        EXPECT_NEAR(mean / (k * em.gain()), 1.0, 0.01);
+        EXPECT_NEAR(var / (k * pow(em.gain(), 2)), 1.0, 0.03);
+    }
+
+    // Short exposure at high EM gain. Clock induced charge makes spikes of about the EM gain in ADUs.
+    pixel_coordinates center = astroUtilities::frameCenter(Twinkle.FRAME_W, Twinkle.FRAME_H);
+    std::unique_ptr<Frame> faint = std::make_unique<Frame>(Twinkle, 0.1);
+    faint->addSource(center.x - 11.3, center.y + 4.6, star_fwhm, star_fwhm, 11.0);
+    faint->setEMCCD(std::make_shared<EMCCD>(100, 0.01));
+    faint->generateFrame(true);
+    EXPECT_FALSE(faint->isSaturated());
+
+    pixel_coordinates guess = FrameProcessor::initial_guess_momentum(faint->get(), 4);
+    pixel_coordinates centroid = FrameProcessor::fine_momentum(faint->get(), guess.x, guess.y, 30, 2);
+    EXPECT_NEAR(centroid.x, center.x - 11.3, 0.2);
+    EXPECT_NEAR(centroid.y, center.y + 4.6, 0.2);
+}
+
+TEST(CTI, trailsAndCentroidBias)
+{
+    // A column of point sources read through 150 pixels, fast and exact models
+    std::vector<trap_species> traps{{0.5, 2.0}, {0.2, 15.0}};
+    Grid<uint32_t> fast(16, 200), exact(16, 200);
+    for (uint16_t x = 0; x < 16; x++)
+    {
+        fast(x, 150) = exact(x, 150) = 5000;
+    }
+    CTI fastModel(traps), exactModel(traps, 1E5, 0.58, true);
+    fastModel.apply(fast);
+    exactModel.apply(exact);
+
+    double fastTrail = 0, exactTrail = 0;
+    for (uint16_t y = 151; y < 200; y++)
+    {
+        fastTrail += fast(3, y);
+        exactTrail += exact(3, y);
+    }
+    EXPECT_GT(5000 - (double)exact(3, 150), 10.0);
+    EXPECT_NEAR(5000 - (double)fast(3, 150), 5000 - (double)exact(3, 150), 0.3 * (5000 - (double)exact(3, 150)));
+    EXPECT_GT(exactTrail, 0.5 * (5000 - (double)exact(3, 150)));
+    EXPECT_GT(fastTrail, 0.5 * (5000 - (double)fast(3, 150)));
+    EXPECT_LE(FrameProcessor::total(&exact), 16 * 5000u);
+
+    // Trails pull centroids away from the readout register, i.e. towards larger y. Heavily damaged detector.
+    pixel_coordinates center = astroUtilities::frameCenter(Twinkle.FRAME_W, Twinkle.FRAME_H);
+    std::unique_ptr<Frame> damaged = std::make_unique<Frame>(Twinkle, expTime);
+    damaged->addSource(center.x, center.y + 300, star_fwhm, star_fwhm, 11.0);
+    damaged->setCTI(std::make_shared<CTI>(std::vector<trap_species>{{4.0, 3.0}, {2.0, 30.0}}));
+    damaged->generateFrame(true);
+    pixel_coordinates guess = FrameProcessor::initial_guess_momentum(damaged->get(), 4);
+    pixel_coordinates centroid = FrameProcessor::fine_momentum(damaged->get(), guess.x, guess.y, 30, 2);
+    EXPECT_NEAR(centroid.x, center.x, 0.1);
+    EXPECT_GT(centroid.y - (center.y + 300), 0.2);
+}
+
+TEST(Frame, rollingShutter)
+{
+    // Slow readout and fast, wide jitter: each row sees the star where the pointing was while it was open
+    const double lineTime = 5E-3, exposure = 0.05;
+    const double plateScale = astroUtilities::plateScale(Twinkle);
+    pixel_coordinates center = astroUtilities::frameCenter(Twinkle.FRAME_W, Twinkle.FRAME_H);
+    std::shared_ptr<Jitter> jitter = std::make_shared<Jitter>(Jitter::harmonic(0.5, 2.0, 0.05), Jitter::harmonic(0.5, 0.01, 0.05), 200.0, 20.0, 5);
+
+    std::unique_ptr<Frame> rolling = std::make_unique<Frame>(Twinkle, exposure);
+    rolling->addSource(center.x, center.y, star_fwhm, star_fwhm, 8.0);
+    rolling->setJitter(jitter, 10);
+    rolling->setRollingShutter(lineTime);
+    rolling->generateFrame(true);
+
+    // Expected: rows weighted by the star profile, each shifted by the mean jitter over its window
+    double sigma = star_fwhm / 2.3548, weights = 0, expectedX = 0;
+    for (int32_t row = center.y - 15; row <= center.y + 15; row++)
+    {
+        double weight = exp(-pow(row - center.y, 2) / (2 * sigma * sigma));
+        pixel_coordinates offset = jitter->meanOffset(row * lineTime, row * lineTime + exposure);
+        expectedX += weight * (center.x + offset.x / plateScale);
+        weights += weight;
+    }
+    expectedX /= weights;
+    double globalX = center.x + jitter->meanOffset(0, exposure).x / plateScale;
+    ASSERT_GT(std::abs(expectedX - globalX), 1.0);
+
+    pixel_coordinates guess = FrameProcessor::initial_guess_momentum(rolling->get(), 4);
+    pixel_coordinates centroid = FrameProcessor::fine_momentum(rolling->get(), guess.x, guess.y, 30, 2);
+    EXPECT_NEAR(centroid.x, expectedX, 0.15);
+    EXPECT_NEAR(centroid.y, center.y, 0.15);
+}
+
+TEST(Frame, rollingShutterKeepsDetections)
+{
+    // Jitter of several pixels along the columns: rows far from the star still keep what the jitter brings them, so a
+    // rolling shutter frame holds as many detections as a global shutter one
+    const double plateScale = astroUtilities::plateScale(Twinkle);
+    pixel_coordinates center = astroUtilities::frameCenter(Twinkle.FRAME_W, Twinkle.FRAME_H);
+    std::shared_ptr<Jitter> jitter =
+        std::make_shared<Jitter>(Jitter::harmonic(0.5, 0.01, 0.05), Jitter::harmonic(3.0, 8 * plateScale, 0.5), 200.0, 20.0, 7);
+
+    std::unique_ptr<Frame> rolling = std::make_unique<Frame>(Twinkle, 0.2);
+    rolling->addSource(center.x, center.y, star_fwhm, star_fwhm, 9.0);
+    rolling->setJitter(jitter, 40);
+    rolling->setRollingShutter(1E-3);
+    rolling->generateFrame(false);
+    std::unique_ptr<Frame> global = std::make_unique<Frame>(Twinkle, 0.2);
+    global->addSource(center.x, center.y, star_fwhm, star_fwhm, 9.0);
+    global->setJitter(jitter, 40);
+    global->generateFrame(false);
+
+    const double expected = FrameProcessor::total(global->get());
+    ASSERT_GT(expected, 1E5);
+    EXPECT_NEAR(FrameProcessor::total(rolling->get()), expected, 5 * sqrt(expected));
+}
+
+TEST(Frame, binning)
+{
+    pixel_coordinates center = astroUtilities::frameCenter(Twinkle.FRAME_W, Twinkle.FRAME_H);
+    std::unique_ptr<Frame> binnedFrame = std::make_unique<Frame>(Twinkle, expTime);
+    binnedFrame->addSource(center.x + 7.3, center.y - 2.8, star_fwhm, star_fwhm, 11.0);
+    binnedFrame->setBinning(2);
+    binnedFrame->generateFrame(true);
+    ASSERT_EQ(binnedFrame->get()->width(), Twinkle.FRAME_W / 2);
+    ASSERT_EQ(binnedFrame->get()->height(), Twinkle.FRAME_H / 2);
+
+    // One read noise per superpixel: the background scatter is the one of 4 pixels of dark current plus a single read
+    const Grid<uint32_t> *fr = binnedFrame->get();
+    double mean = 0, var = 0;
+    for (uint16_t x = 0; x < 100; x++)
+    {
+        mean += (*fr)(x, 10);
+    }
+    mean /= 100;
+    for (uint16_t x = 0; x < 100; x++)
+    {
+        var += pow((*fr)(x, 10) - mean, 2);
+    }
+    var /= 99;
+    double dark = pow(Twinkle.DARK_NOISE / Twinkle.GAIN * expTime, 2);
+    EXPECT_NEAR(mean, 4 * dark + Twinkle.OFFSET / Twinkle.GAIN, 2.0);
+    EXPECT_NEAR(sqrt(var), sqrt(4 * dark + pow(Twinkle.READOUT_NOISE / Twinkle.GAIN, 2)), 1.5);
+
+    FrameProcessor processor(fr, binnedFrame->getBinning());
+    pixel_coordinates guess = processor.initial_guess_momentum(4);
+    pixel_coordinates centroid = processor.fine_momentum(guess.x, guess.y, 15, 2);
+    EXPECT_NEAR(centroid.x, center.x + 7.3, 0.1);
+    EXPECT_NEAR(centroid.y, center.y - 2.8, 0.1);
+
+    // Back to full frames
+    binnedFrame->setBinning(1);
+    binnedFrame->generateFrame(true);
+    EXPECT_EQ(binnedFrame->get()->width(), Twinkle.FRAME_W);
+}
+
+TEST(DetectorMTF, diffusion)
+{
+    // Point source: the separable, FFT and 2-D paths give the same gaussian
+    std::vector<float> point(64 * 64, 0.0f), wide(64 * 64, 0.0f), square(64 * 64, 0.0f);
+    point[32 * 64 + 30] = wide[32 * 64 + 30] = square[32 * 64 + 30] = 1000.0f;
+    DetectorMTF(0.8).convolve(point, 64, 64);
+    DetectorMTF(7.0).convolve(wide, 64, 64);
+    Grid<double> kernel(5, 5);
+    for (int32_t y = -2; y <= 2; y++)
+    {
+        for (int32_t x = -2; x <= 2; x++)
+        {
+            kernel(x + 2, y + 2) = exp(-(x * x + y * y) / (2 * 0.8 * 0.8));
+        }
+    }
+    double norm = kernel.total();
+    for (uint32_t i = 0; i < 25; i++)
+    {
+        kernel[i] /= norm;
+    }
+    DetectorMTF(kernel).convolve(square, 64, 64);
+
+    EXPECT_GE(DetectorMTF(7.0).radius(), DetectorMTF::FFT_RADIUS);
+    double sum = 0, wideSum = 0, sumX2 = 0, wideX2 = 0;
+    for (uint32_t i = 0; i < 64 * 64; i++)
+    {
+        double dx = (int32_t)(i % 64) - 30;
+        sum += point[i];
+        wideSum += wide[i];
+        sumX2 += point[i] * dx * dx;
+        wideX2 += wide[i] * dx * dx;
+        if (std::abs(dx) <= 2 && std::abs((int32_t)(i / 64) - 32) <= 2)
+        {
+            EXPECT_NEAR(square[i], point[i], 0.01 * point[i]);
+        }
+    }
+    EXPECT_NEAR(sum, 1000, 0.1);
+    EXPECT_NEAR(wideSum, 1000, 1.0);
+    EXPECT_NEAR(sqrt(sumX2 / sum), 0.8, 0.02);
+    EXPECT_NEAR(sqrt(wideX2 / wideSum), 7.0, 0.05);
+
+    // Diffusion widens the star and keeps its centroid
+    pixel_coordinates center = astroUtilities::frameCenter(Twinkle.FRAME_W, Twinkle.FRAME_H);
+    std::unique_ptr<Frame> blurred = std::make_unique<Frame>(Twinkle, expTime);
+    blurred->addSource(center.x + 0.3, center.y + 0.2, 2.0, 2.0, 11.0);
+    blurred->setDetectorMTF(std::make_shared<DetectorMTF>(1.0));
+    blurred->generateFrame(true);
+    pixel_coordinates guess = FrameProcessor::initial_guess_momentum(blurred->get(), 4);
+    pixel_coordinates centroid = FrameProcessor::fine_momentum(blurred->get(), guess.x, guess.y, 20, 2);
+    EXPECT_NEAR(centroid.x, center.x + 0.3, 0.1);
+    EXPECT_NEAR(centroid.y, center.y + 0.2, 0.1);
+
+    double peak = (*blurred->get())(std::round(center.x + 0.3), std::round(center.y + 0.2));
+    std::unique_ptr<Frame> sharp = std::make_unique<Frame>(Twinkle, expTime);
+    sharp->addSource(center.x + 0.3, center.y + 0.2, 2.0, 2.0, 11.0);
+    sharp->generateFrame(true);
+    EXPECT_LT(peak, 0.7 * (*sharp->get())(std::round(center.x + 0.3), std::round(center.y + 0.2)));
+}
+
+TEST(DetectorSignature, fixedPattern)
+{
+    signature_parameters parameters;
+    parameters.prnu = 0.02;
+    parameters.hotFraction = 1E-3;
+    parameters.deadColumns = 1;
+    parameters.columnBiasRMS = 3.0;
+    std::shared_ptr<DetectorSignature> signature = std::make_shared<DetectorSignature>(Twinkle.FRAME_W, Twinkle.FRAME_H, parameters, 7);
+
+    // Map statistics, away from the dead column
+    uint32_t n = Twinkle.FRAME_W * Twinkle.FRAME_H, hot = 0, dead = 0;
+    uint16_t deadColumn = 0;
+    double mean = 0, var = 0;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        if (signature->gain(i) == 0)
+        {
+            dead++;
+            deadColumn = i % Twinkle.FRAME_W;
+            continue;
+        }
+        mean += signature->gain(i);
+        var += pow(signature->gain(i) - 1, 2);
+        hot += (signature->darkFactor(i) == parameters.hotDarkFactor);
+    }
+    mean /= n - dead;
+    EXPECT_EQ(dead, Twinkle.FRAME_H);
+    EXPECT_NEAR(mean, 1.0, 1E-3);
+    EXPECT_NEAR(sqrt(var / (n - dead)), parameters.prnu, 1E-3);
+    EXPECT_NEAR(hot, 1E-3 * n, 5 * sqrt(1E-3 * n));
+
+    // Same seed, same detector. Saved maps load back unchanged.
+    DetectorSignature twin(Twinkle.FRAME_W, Twinkle.FRAME_H, parameters, 7);
+    signature->save("signature.bin");
+    DetectorSignature loaded("signature.bin");
+    std::remove("signature.bin");
+    ASSERT_EQ(loaded.width(), signature->width());
+    ASSERT_EQ(loaded.height(), signature->height());
+    EXPECT_TRUE(std::equal(signature->gains(), signature->gains() + n, loaded.gains()));
+    EXPECT_TRUE(std::equal(signature->darkFactors(), signature->darkFactors() + n, loaded.darkFactors()));
+    EXPECT_TRUE(std::equal(signature->columnBiases(), signature->columnBiases() + Twinkle.FRAME_W, loaded.columnBiases()));
+    EXPECT_TRUE(std::equal(signature->gains(), signature->gains() + n, twin.gains()));
+    EXPECT_THROW(std::make_shared<Frame>(Twinkle, expTime)->setDetectorSignature(std::make_shared<DetectorSignature>(10, 10)), const char *);
+
+    // A star on the dead column loses it, hot pixels stand out of the dark frame
+    std::unique_ptr<Frame> frame = std::make_unique<Frame>(Twinkle, expTime);
+    pixel_coordinates center = astroUtilities::frameCenter(Twinkle.FRAME_W, Twinkle.FRAME_H);
+    frame->addSource(deadColumn, center.y, star_fwhm, star_fwhm, 11.0);
+    frame->setDetectorSignature(signature);
+    frame->generateFrame(true);
+    const Grid<uint32_t> *fr = frame->get();
+    EXPECT_LT((*fr)(deadColumn, center.y), Twinkle.OFFSET / Twinkle.GAIN + 20);
+    EXPECT_GT((*fr)(deadColumn + 1, center.y), 10 * (*fr)(deadColumn, center.y));
+
+    double dark = pow(Twinkle.DARK_NOISE / Twinkle.GAIN * expTime, 2);
+    double hotMean = 0, coldMean = 0;
+    uint32_t hotCount = 0, coldCount = 0;
+    for (uint32_t y = 0; y < 20; y++)
+    {
+        for (uint32_t x = 0; x < Twinkle.FRAME_W; x++)
+        {
+            uint32_t i = y * Twinkle.FRAME_W + x;
+            if (signature->gain(i) == 0)
+            {
+                continue;
+            }
+            double value = (*fr)[i] - signature->columnBias(x);
+            if (signature->darkFactor(i) == parameters.hotDarkFactor)
+            {
+                hotMean += value;
+                hotCount++;
+            }
+            else
+            {
+                coldMean += value;
+                coldCount++;
+            }
+        }
+    }
+    ASSERT_GT(hotCount, 0u);
+    EXPECT_NEAR(hotMean / hotCount, parameters.hotDarkFactor * dark + Twinkle.OFFSET / Twinkle.GAIN, 0.2 * parameters.hotDarkFactor * dark);
+    EXPECT_NEAR(coldMean / coldCount, dark + Twinkle.OFFSET / Twinkle.GAIN, 1.0);
+}
+
+TEST(ADC, transferFunction)
+{
+    // Ideal converters: 16 bits at full scale 65535 is the identity, 8 bits keep one code in 257 ADUs
+    ADC linear16(16, 65535), linear8(8, 65535), linear12(12, 65535), linear14(14, 65535);
+    for (uint32_t input : {0u, 1u, 1000u, 32768u, 65535u})
+    {
+        EXPECT_EQ(linear16.code(input), input);
+        EXPECT_NEAR(linear8.code(input), input / 257.0, 0.5);
+        EXPECT_NEAR(linear12.code(input), input * 4095.0 / 65535, 0.5);
+        EXPECT_NEAR(linear14.code(input), input * 16383.0 / 65535, 0.5);
+    }
+    EXPECT_EQ(linear8.code(1000000), 255);
+    std::vector<uint32_t> ramp(70000);
+    std::iota(ramp.begin(), ramp.end(), 0);
+    std::vector<uint8_t> codes8(ramp.size());
+    linear8.convert(ramp.data(), codes8.data(), ramp.size());
+    EXPECT_EQ(codes8.back(), 255);
+    EXPECT_TRUE(std::is_sorted(codes8.begin(), codes8.end()));
+
+    // Compressive nonlinearity: 5% low at full scale, and monotonic
+    ADC compressed(16, 65535, {-0.05});
+    EXPECT_NEAR(compressed.code(65535), 0.95 * 65535, 1);
+    EXPECT_NEAR(compressed.code(32768), 32768 * (1 - 0.025), 1);
+    std::vector<uint16_t> codes16(ramp.size());
+    compressed.convert(ramp.data(), codes16.data(), ramp.size());
+    EXPECT_TRUE(std::is_sorted(codes16.begin(), codes16.end()));
+
+    // Differential nonlinearity: code widths scatter by the given rms, the top code stays in place
+    ADC noisy(12, 65535, {}, 0.2, 3);
+    std::vector<uint32_t> widths(noisy.maxCode() + 1, 0);
+    for (uint32_t input = 0; input <= 65535; input++)
+    {
+        widths[noisy.code(input)]++;
+    }
+    double mean = 65536.0 / 4096, var = 0;
+    for (uint32_t k = 1; k < noisy.maxCode(); k++)
+    {
+        var += pow(widths[k] / mean - 1, 2);
+    }
+    EXPECT_NEAR(sqrt(var / (noisy.maxCode() - 1)), 0.2, 0.02);
+    EXPECT_EQ(noisy.code(65535), noisy.maxCode());
+    EXPECT_THROW(ADC(17, 65535), const char *);
+
+    // Frames come out in codes
+    pixel_coordinates center = astroUtilities::frameCenter(Twinkle.FRAME_W, Twinkle.FRAME_H);
+    std::unique_ptr<Frame> frame = std::make_unique<Frame>(Twinkle, expTime);
+    frame->addSource(center.x + 0.3, center.y - 0.4, star_fwhm, star_fwhm, 8.0);
+    frame->setADC(std::make_shared<ADC>(12, Twinkle.FGS_MAX_ADU));
+    frame->generateFrame(true);
+    const Grid<uint32_t> *fr = frame->get();
+    EXPECT_LE(*std::max_element(&(*fr)[0], &(*fr)[0] + Twinkle.FRAME_W * Twinkle.FRAME_H), 4095u);
+    pixel_coordinates guess = FrameProcessor::initial_guess_momentum(fr, 4);
+    pixel_coordinates centroid = FrameProcessor::fine_momentum(fr, guess.x, guess.y, 20, 2);
+    EXPECT_NEAR(centroid.x, center.x + 0.3, 0.1);
+    EXPECT_NEAR(centroid.y, center.y - 0.4, 0.1);
+}
+
+TEST(PixelResponse, pixelPhase)
+{
+    // Eight simels per pixel, so the response of a pixel is seen by the sampler
+    static Telescope Oversampled = twinkleVariant("Oversampled", 64, 64, 8, 24);
+
+    // Simel weights are the cell means; a separable map keeps its profiles
+    PixelResponse response(0.5, 8);
+    std::vector<double> weights = response.simelWeights(4);
+    EXPECT_NEAR(std::accumulate(weights.begin(), weights.end(), 0.0) / 16, response.mean(), 1E-12);
+    EXPECT_NEAR(response.mean(), pow(1 - 0.5 / 3 + 0.5 / (3 * 64), 2), 1E-9);
+    EXPECT_LT(weights[0], weights[5]);
+    EXPECT_NEAR(response.integrateGaussianX(0, 100), response.integrateGaussianY(0, 100), 1E-12);
+    EXPECT_NEAR(response.integrateGaussianX(0, 100) * sqrt(2 * M_PI) * 100, sqrt(response.mean()), 1E-4);
+    EXPECT_THROW(PixelResponse(Grid<double>(2, 3)), const char *);
+
+    // First moment over a 7 x 7 window, above the level of the frame corner
+    auto centroid = [](const Grid<uint32_t> *fr, double cx, double cy, double &flux) {
+        double level = 0;
+        for (uint16_t y = 0; y < 16; y++)
+        {
+            for (uint16_t x = 0; x < 16; x++)
+            {
+                level += (*fr)(x, y) / 256.0;
+            }
+        }
+        double sx = 0, sy = 0;
+        flux = 0;
+        for (int32_t y = (int32_t)std::round(cy) - 3; y <= (int32_t)std::round(cy) + 3; y++)
+        {
+            for (int32_t x = (int32_t)std::round(cx) - 3; x <= (int32_t)std::round(cx) + 3; x++)
+            {
+                double v = (*fr)(x, y) - level;
+                flux += v;
+                sx += v * x;
+                sy += v * y;
+            }
+        }
+        return pixel_coordinates{sx / flux, sy / flux};
+    };
+
+    // Pixels of an undersampled star off the pixel centre give a centroid biased towards it, and edge loss changes the
+    // bias. The analytic noiseless frames show the same centroids. The star is bright, so photon noise moves the sampled
+    // effect by less than 0.0005 px.
+    const double cx = 32.3, cy = 31.75, fwhm = 0.7;
+    auto render = [&](std::shared_ptr<const PixelResponse> response, bool statistical, double &flux) {
+        std::unique_ptr<Frame> frame = std::make_unique<Frame>(Oversampled, 1.0);
+        frame->setPixelResponse(response);
+        frame->addSource(cx, cy, fwhm, fwhm, 5.5);
+        frame->generateFrame(statistical);
+        EXPECT_THROW(frame->setPixelResponse(nullptr), const char *);
+        return centroid(frame->get(), cx, cy, flux);
+    };
+    std::shared_ptr<const PixelResponse> uniform = std::make_shared<PixelResponse>(0.0, 1);
+    std::shared_ptr<const PixelResponse> edgeLoss = std::make_shared<PixelResponse>(0.6, 16);
+
+    double flatFlux, edgeFlux, expectedFlux;
+    pixel_coordinates flat = render(nullptr, true, flatFlux);
+    pixel_coordinates edge = render(edgeLoss, true, edgeFlux);
+    pixel_coordinates flatExpected = render(uniform, false, expectedFlux);
+    pixel_coordinates edgeExpected = render(edgeLoss, false, expectedFlux);
+
+    // Simel sampling of the gaussian leaves a 0.01 px difference with the exact integral; the response effect matches closer
+    EXPECT_NEAR(flat.x, flatExpected.x, 0.01);
+    EXPECT_NEAR(flat.y, flatExpected.y, 0.01);
+    EXPECT_NEAR(edge.x - flat.x, edgeExpected.x - flatExpected.x, 0.003);
+    EXPECT_NEAR(edge.y - flat.y, edgeExpected.y - flatExpected.y, 0.003);
+    EXPECT_LT(flat.x, cx - 0.03);
+    EXPECT_GT(flat.y, cy + 0.03);
+    EXPECT_GT(std::abs(edge.x - flat.x), 0.006);
+    EXPECT_GT(std::abs(edge.y - flat.y), 0.006);
+    EXPECT_LT(edgeFlux, 0.95 * flatFlux);
+}
+
+// Heap allocations of the test binary, counted in allocations.cpp
+uint64_t heapAllocations();
+
+TEST(GridView, windows)
+{
+    // Windows of windows match the copies made by subGrid, and keep the original coordinates
+    Grid<uint32_t> grid(40, 30);
+    for (uint32_t i = 0; i < 40 * 30; i++)
+    {
+        grid[i] = i;
+    }
+    for (std::array<uint16_t, 4> window : {std::array<uint16_t, 4>{20, 15, 10, 8}, {2, 3, 9, 9}, {38, 28, 12, 6}})
+    {
+        uint32_t offsetX = 0, offsetY = 0;
+        Grid<uint32_t> copy = grid.subGrid(window[0], window[1], window[2], window[3], &offsetX, &offsetY);
+        GridView<const uint32_t> view = grid.view().subView(window[0], window[1], window[2], window[3]);
+        ASSERT_EQ(view.width(), copy.width());
+        ASSERT_EQ(view.height(), copy.height());
+        EXPECT_EQ(view.originX(), offsetX);
+        EXPECT_EQ(view.originY(), offsetY);
+        for (uint16_t y = 0; y < copy.height(); y++)
+        {
+            for (uint16_t x = 0; x < copy.width(); x++)
+            {
+                EXPECT_EQ(view(x, y), copy(x, y));
+            }
+        }
+        GridView<const uint32_t> inner = view.subView(2, 2, 3, 3);
+        EXPECT_EQ(inner(0, 0), grid(inner.originX(), inner.originY()));
+    }
+
+    // Same centroids as before, without allocating
+    pixel_coordinates center = astroUtilities::frameCenter(Twinkle.FRAME_W, Twinkle.FRAME_H);
+    std::unique_ptr<Frame> frame = std::make_unique<Frame>(Twinkle, expTime);
+    frame->addSource(center.x + 12.3, center.y - 4.6, star_fwhm, star_fwhm, 10.0);
+    frame->generateFrame(true);
+    const Grid<uint32_t> *fr = frame->get();
+    GridView<const uint32_t> whole = fr->view();
+    std::vector<uint64_t> rows = FrameProcessor::sumVertical(fr), columns = FrameProcessor::sumHorizontal(fr);
+    uint64_t sumX = 0, sumY = 0;
+    for (uint32_t i = 0; i < rows.size(); i++)
+    {
+        sumY += rows[i] * i;
+        sumX += columns[i] * i;
+    }
+    EXPECT_NEAR(FrameProcessor::momentum(fr).x, (double)sumX / FrameProcessor::total(fr), 1E-9);
+    EXPECT_NEAR(FrameProcessor::momentum(fr).y, (double)sumY / FrameProcessor::total(fr), 1E-9);
+
+    // Grids allocate through the aligned operator new, which is counted too
+    uint64_t before = heapAllocations();
+    Grid<uint32_t> counted(8, 8);
+    EXPECT_EQ(heapAllocations() - before, 1u);
+
+    before = heapAllocations();
+    pixel_coordinates guess = FrameProcessor::initial_guess_momentum(whole, 4, FrameProcessor::Border);
+    pixel_coordinates fine = FrameProcessor::fine_momentum(whole, guess.x, guess.y, 20, 2);
+    pixel_coordinates multiple = FrameProcessor::multiple_guess_momentum(whole, 20, 4, 2);
+    EXPECT_EQ(heapAllocations() - before, 0u);
+    EXPECT_NEAR(fine.x, center.x + 12.3, 0.1);
+    EXPECT_NEAR(fine.y, center.y - 4.6, 0.1);
+    EXPECT_NEAR(multiple.x, center.x + 12.3, 0.1);
+    EXPECT_NEAR(multiple.y, center.y - 4.6, 0.1);
+
+    // Positions on a window are in the window. The search may stop on a window one pixel apart.
+    GridView<const uint32_t> window = whole.subView(center.x + 12, center.y - 5, 41, 41);
+    pixel_coordinates local = FrameProcessor::fine_momentum(window, 20, 20, 20, 2);
+    EXPECT_NEAR(local.x + window.originX(), fine.x, 0.02);
+    EXPECT_NEAR(local.y + window.originY(), fine.y, 0.02);
+}
+
+TEST(GridStorage, policies)
+{
+    // Padded rows start on cache lines, and the linear index skips the padding
+    Grid<uint32_t, PaddedRows<64>, CheckedAccess> padded(37, 5);
+    Grid<uint32_t, PackedRows, CheckedAccess> packed(37, 5);
+    EXPECT_EQ(padded.stride(), 48u);
+    EXPECT_EQ(packed.stride(), 37u);
+    for (uint32_t i = 0; i < padded.size(); i++)
+    {
+        padded[i] = i + 1;
+        packed[i] = i + 1;
+    }
+    for (uint16_t y = 0; y < 5; y++)
+    {
+        EXPECT_EQ((uintptr_t)padded.row(y) % 64, 0u);
+        EXPECT_EQ(padded(36, y), packed(36, y));
+        EXPECT_EQ(padded.row(y)[0], y * 37u + 1);
+    }
+    EXPECT_EQ(padded.total(), packed.total());
+    EXPECT_EQ(padded.min(), 1u);
+    EXPECT_EQ(padded.max(), 37u * 5);
+
+    // The extra pixel is apart from the rows
+    padded.extraPixel() = 1000;
+    EXPECT_EQ(padded.total(), packed.total());
+    Grid<uint32_t, PaddedRows<64>, CheckedAccess> window = padded.subGrid(18, 2, 9, 3);
+    EXPECT_EQ(window(0, 0), padded(14, 1));
+    EXPECT_EQ(window.view().stride(), 16u);
+
+    // Checked access throws past the last pixel, unchecked access is a plain load
+    EXPECT_THROW(packed[37 * 5], std::out_of_range);
+    EXPECT_THROW(padded(37, 0), std::out_of_range);
+    Grid<uint32_t, PaddedRows<64>, UncheckedAccess> unchecked(37, 5);
+    EXPECT_EQ(&unchecked(37, 0), unchecked.row(0) + 37);
+}
+
+TEST(GridStorage, tiledLayouts)
+{
+    // Any layout gives the same pixels through the accessors, and converts back to the same rows
+    Grid<uint32_t, PackedRows, CheckedAccess> rows(37, 21);
+    for (uint32_t i = 0; i < rows.size(); i++)
+    {
+        rows[i] = i * 7 + 3;
+    }
+    rows.extraPixel() = 5;
+    Grid<uint32_t, TiledLayout<8>, CheckedAccess> tiled(rows);
+    Grid<uint32_t, MortonTiles<16>, CheckedAccess> morton(rows);
+    EXPECT_EQ(tiled.stride(), 40u);
+    EXPECT_EQ(morton.stride(), 48u);
+    for (uint32_t y = 0; y < 21; y++)
+    {
+        for (uint32_t x = 0; x < 37; x++)
+        {
+            EXPECT_EQ(tiled(x, y), rows(x, y));
+            EXPECT_EQ(morton(x, y), rows(x, y));
+        }
+    }
+    EXPECT_EQ(tiled[36 + 20 * 37], rows(36, 20));
+    EXPECT_EQ(morton.extraPixel(), 5u);
+    EXPECT_EQ(tiled.total(), rows.total());
+    EXPECT_EQ(morton.max(), rows.max());
+    EXPECT_EQ(morton.min(), rows.min());
+
+    // Blocks are contiguous: a tile row, and 2x2 squares in Z order
+    EXPECT_EQ(&tiled(7, 3) - &tiled(0, 3), 7);
+    EXPECT_EQ(&tiled(8, 0) - &tiled(0, 0), 64);
+    EXPECT_EQ(&morton(1, 1) - &morton(0, 0), 3);
+    EXPECT_EQ(&morton(2, 0) - &morton(0, 0), 4);
+
+    Grid<uint32_t, PackedRows, CheckedAccess> back(morton);
+    Grid<uint32_t, PaddedRows<64>, CheckedAccess> padded(tiled);
+    std::vector<uint32_t> row(37);
+    tiled.getRow(20, row.data());
+    for (uint32_t y = 0; y < 21; y++)
+    {
+        EXPECT_TRUE(std::equal(back.row(y), back.row(y) + 37, rows.row(y)));
+        EXPECT_TRUE(std::equal(padded.row(y), padded.row(y) + 37, rows.row(y)));
+    }
+    EXPECT_TRUE(std::equal(row.begin(), row.end(), rows.row(20)));
+    EXPECT_THROW(tiled(37, 0), std::out_of_range);
+
+    // Views of tiled grids address pixels by their position in the grid
+    GridView<const uint32_t, MortonTiles<16>> window = morton.view().subView(20, 10, 9, 5);
+    EXPECT_EQ(window.originX(), 16u);
+    EXPECT_EQ(window(3, 2), rows(19, 10));
+
+    // FrameProcessor reads tiled frames through the accessors, with the same centroids as on rows
+    pixel_coordinates center = astroUtilities::frameCenter(Twinkle.FRAME_W, Twinkle.FRAME_H);
+    std::unique_ptr<Frame> frame = std::make_unique<Frame>(Twinkle, expTime);
+    frame->addSource(center.x + 3.3, center.y - 2.6, star_fwhm, star_fwhm, 10.0);
+    frame->generateFrame(true);
+    const Grid<uint32_t> *fr = frame->get();
+    Grid<uint32_t, TiledLayout<8>> tiledFrame(*fr);
+    Grid<uint32_t, MortonTiles<16>> mortonFrame(*fr);
+    pixel_coordinates expected = FrameProcessor::fine_momentum(fr, center.x, center.y, 20, 2);
+    pixel_coordinates onTiles = BasicFrameProcessor<uint32_t, TiledLayout<8>>::fine_momentum(&tiledFrame, center.x, center.y, 20, 2);
+    pixel_coordinates onMorton = BasicFrameProcessor<uint32_t, MortonTiles<16>>::multiple_guess_momentum(&mortonFrame, 20, 4, 2);
+    EXPECT_DOUBLE_EQ(onTiles.x, expected.x);
+    EXPECT_DOUBLE_EQ(onTiles.y, expected.y);
+    EXPECT_NEAR(onMorton.x, center.x + 3.3, 0.1);
+    EXPECT_NEAR(onMorton.y, center.y - 2.6, 0.1);
+    EXPECT_EQ((BasicFrameProcessor<uint32_t, MortonTiles<16>>::sumHorizontal(&mortonFrame, 100)), FrameProcessor::sumHorizontal(fr, 100));
+    std::vector<pixel_coordinates> tiledCentroids = BasicFrameProcessor<uint32_t, TiledLayout<8>>::tiled_momentum(tiledFrame.view(), {expected}, 256, 20, 2);
+    EXPECT_DOUBLE_EQ(tiledCentroids[0].x, FrameProcessor::tiled_momentum(fr->view(), {expected}, 256, 20, 2)[0].x);
+}
+
+TEST(GridStorage, allocators)
+{
+    // Arena grids are bump allocated and released together when the scope ends
+    Arena arena(1 << 16);
+    {
+        Arena::Scope outer(arena);
+        ArenaGrid<double> a(10, 10, ArenaAllocator<double>(arena));
+        {
+            Arena::Scope inner(arena);
+            ArenaGrid<uint16_t> b(100, 100, ArenaAllocator<uint16_t>(arena));
+            ArenaGrid<double> c(200, 100, ArenaAllocator<double>(arena));
+            EXPECT_EQ((uintptr_t)b.data() % 64, 0u);
+            EXPECT_EQ(c(199, 99), 0.0);
+            EXPECT_EQ(arena.chunks(), 2u);
+        }
+        EXPECT_EQ(arena.used(), 800u);
+        a(9, 9) = 1;
+        EXPECT_EQ(a.total(), 1.0);
+    }
+    // Once empty, the chunks are merged, so the same allocations fit without new chunks
+    EXPECT_EQ(arena.used(), 0u);
+    EXPECT_EQ(arena.chunks(), 1u);
+    const std::size_t capacity = arena.capacity();
+    {
+        Arena::Scope again(arena);
+        ArenaGrid<double> a(10, 10, ArenaAllocator<double>(arena));
+        ArenaGrid<uint16_t> b(100, 100, ArenaAllocator<uint16_t>(arena));
+        ArenaGrid<double> c(200, 100, ArenaAllocator<double>(arena));
+    }
+    EXPECT_EQ(arena.chunks(), 1u);
+    EXPECT_EQ(arena.capacity(), capacity);
+
+    // File backed grids write through to the file, and reopening the file gives the pixels back
+    pixel_coordinates center = astroUtilities::frameCenter(Twinkle.FRAME_W, Twinkle.FRAME_H);
+    std::unique_ptr<Frame> frame = std::make_unique<Frame>(Twinkle, expTime);
+    frame->addSource(center.x, center.y, star_fwhm, star_fwhm, 10.0);
+    frame->generateFrame(true);
+    {
+        MappedGrid<uint16_t> mapped(0, 0, MappedAllocator<uint16_t>(MappedStorage::file("grid_test.raw")));
+        frame->get(mapped);
+        MappedGrid<uint16_t> copy = mapped;
+        copy(0, 0) = 12345;
+    }
+    {
+        std::shared_ptr<MappedStorage> storage = MappedStorage::file("grid_test.raw");
+        EXPECT_EQ(storage->size(), (std::size_t)Twinkle.FRAME_W * Twinkle.FRAME_H * 2);
+        MappedGrid<uint16_t> reopened(Twinkle.FRAME_W, Twinkle.FRAME_H, MappedAllocator<uint16_t>(storage));
+        Grid<uint16_t> detector;
+        frame->get(detector);
+        EXPECT_TRUE(std::equal(detector.begin(), detector.end(), reopened.begin()));
+    }
+    std::remove("grid_test.raw");
+
+    // Shared memory grids see the same pixels through any mapping of the object
+    const std::string name = "/fgs_grid_test_" + std::to_string(getpid());
+    std::shared_ptr<MappedStorage> segment = MappedStorage::sharedMemory(name, true);
+    MappedGrid<float, TiledLayout<8>> writer(64, 64, MappedAllocator<float>(segment));
+    MappedGrid<float, TiledLayout<8>> reader(64, 64, MappedAllocator<float>(MappedStorage::sharedMemory(name)));
+    writer(33, 17) = 2.5f;
+    EXPECT_EQ(reader(33, 17), 2.5f);
+    EXPECT_NE(writer.data(), reader.data());
+}
+
+TEST(FrameProcessor, pixelTypes)
+{
+    // The same frame read out as 16 bit detector output or as float data gives the same sums and centroids
+    pixel_coordinates center = astroUtilities::frameCenter(Twinkle.FRAME_W, Twinkle.FRAME_H);
+    std::unique_ptr<Frame> frame = std::make_unique<Frame>(Twinkle, expTime);
+    frame->addSource(center.x + 3.4, center.y + 7.8, star_fwhm, star_fwhm, 10.0);
+    frame->generateFrame(true);
+    const Grid<uint32_t> *accumulated = frame->get();
+    Grid<uint16_t> detector;
+    Grid<float> calibrated;
+    frame->get(detector);
+    frame->get(calibrated);
+    ASSERT_EQ(detector.width(), accumulated->width());
+    ASSERT_EQ(calibrated.height(), accumulated->height());
+
+    EXPECT_EQ(BasicFrameProcessor<uint16_t>::total(&detector), FrameProcessor::total(accumulated));
+    EXPECT_EQ(BasicFrameProcessor<float>::total(&calibrated), (double)FrameProcessor::total(accumulated));
+    EXPECT_EQ(BasicFrameProcessor<uint16_t>::sumHorizontal(&detector, 100), FrameProcessor::sumHorizontal(accumulated, 100));
+    EXPECT_EQ(BasicFrameProcessor<uint16_t>::sumVertical(&detector, 100), FrameProcessor::sumVertical(accumulated, 100));
+
+    pixel_coordinates wide = FrameProcessor::fine_momentum(accumulated, center.x, center.y, 30, 2);
+    pixel_coordinates narrow = BasicFrameProcessor<uint16_t>::fine_momentum(&detector, center.x, center.y, 30, 2);
+    pixel_coordinates real = BasicFrameProcessor<float>::fine_momentum(&calibrated, center.x, center.y, 30, 2);
+    EXPECT_DOUBLE_EQ(narrow.x, wide.x);
+    EXPECT_DOUBLE_EQ(narrow.y, wide.y);
+    // Float thresholds are not rounded, so a few pixels at the threshold may differ
+    EXPECT_NEAR(real.x, wide.x, 0.02);
+    EXPECT_NEAR(real.y, wide.y, 0.02);
+    EXPECT_NEAR(wide.x, center.x + 3.4, 0.1);
+    EXPECT_NEAR(wide.y, center.y + 7.8, 0.1);
+
+    // Sums are widened past the pixel type
+    Grid<uint16_t> full(64, 64);
+    for (uint32_t i = 0; i < full.size(); i++)
+    {
+        full[i] = 65535;
+    }
+    EXPECT_EQ(BasicFrameProcessor<uint16_t>::total(&full), 64u * 64 * 65535);
+    Grid<float> fractional(3, 1);
+    fractional(0, 0) = 0.25f;
+    fractional(1, 0) = 0.75f;
+    fractional(2, 0) = 0.5f;
+    EXPECT_DOUBLE_EQ(BasicFrameProcessor<float>::momentum(&fractional, 0.5f).x, (0.75 + 2 * 0.5) / 1.25);
+}
+
+TEST(Frame, largeFormat)
+{
+    // A strip wider than 16 bit coordinates
+    static Telescope Wide = twinkleVariant("Wide", 70000, 64, 1);
+
+    std::vector<pixel_coordinates> stars = {{100.3, 20.6}, {4095.5, 40.2}, {65540.7, 31.1}, {69950.2, 25.4}};
+    std::unique_ptr<Frame> frame = std::make_unique<Frame>(Wide, expTime);
+    for (const pixel_coordinates &star : stars)
+    {
+        frame->addSource(star.x, star.y, star_fwhm, star_fwhm, 10.0);
+    }
+    frame->generateFrame(true);
+    const Grid<uint32_t> *fr = frame->get();
+    ASSERT_EQ(fr->width(), 70000u);
+    ASSERT_EQ(fr->size(), 70000u * 64);
+    EXPECT_GT((*fr)(65541, 31), (*fr)(65541 - 20, 31));
+    EXPECT_EQ((*fr)(65541, 31), (*fr)[31 * 70000 + 65541]);
+
+    // Tiles of 1024 pixels, guesses a couple of pixels off. One star sits on a tile corner.
+    std::vector<pixel_coordinates> guesses;
+    for (const pixel_coordinates &star : stars)
+    {
+        guesses.push_back({star.x + 1.7, star.y - 2.2});
+    }
+    std::vector<pixel_coordinates> centroids = FrameProcessor::tiled_momentum(fr->view(), guesses, 1024, 30, 2);
+    ASSERT_EQ(centroids.size(), stars.size());
+    for (std::size_t i = 0; i < stars.size(); i++)
+    {
+        EXPECT_NEAR(centroids[i].x, stars[i].x, 0.1);
+        EXPECT_NEAR(centroids[i].y, stars[i].y, 0.1);
+    }
+    pixel_coordinates whole = FrameProcessor::fine_momentum(fr, guesses[2].x, guesses[2].y, 30, 2);
+    EXPECT_NEAR(whole.x, centroids[2].x, 1E-9);
+    EXPECT_NEAR(whole.y, centroids[2].y, 1E-9);
+}
+
 /*
         const float altitude = 38.0;
         const float expectedADU = 167274;
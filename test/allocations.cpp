@@ -0,0 +1,41 @@
+// Replaces the global allocation functions of the test binary, to count heap allocations. Kept in its own translation
+// unit, so the replacements are never inlined next to the code they count.
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+std::atomic<uint64_t> allocations(0);
+}
+
+// Heap allocations made so far, aligned ones included
+uint64_t heapAllocations() { return allocations; }
+
+void *operator new(std::size_t size)
+{
+    allocations++;
+    if (void *p = malloc(size ? size : 1))
+    {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment)
+{
+    allocations++;
+    const std::size_t align = static_cast<std::size_t>(alignment);
+    // aligned_alloc needs a size multiple of the alignment, and a zero size may give a null pointer
+    if (void *p = aligned_alloc(align, ((size ? size : 1) + align - 1) / align * align))
+    {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, std::size_t) noexcept { free(p); }
+void operator delete(void *p, std::align_val_t) noexcept { free(p); }
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept { free(p); }